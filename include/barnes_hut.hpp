@@ -0,0 +1,345 @@
+#ifndef BARNES_HUT_HPP
+#define BARNES_HUT_HPP
+
+#include "gravity_kernel.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Barnes-Hut approximation of the all-pairs interaction of a GravityTile, O(N log N) instead of O(N^2).
+//
+//Bodies are sorted along a Morton (Z-order) curve, so every cell of the octree owns a contiguous range of bodies.
+//Nodes are stored depth first in a flat array, each node keeping the index of the node following its subtree (skip).
+//The traversal is therefore a forward walk in the array : open a cell -> next node, accept it -> skip.
+//A cell whose bodies are all within a radius b of its center of mass, seen at distance d from the body, is replaced
+//by its center of mass when 2 * b < theta * d (this bound is safer than the edge of the cell when the center of mass
+//is close to a corner).
+//theta = 0 gives back the exact sum (up to the summation order).
+
+struct OctreeNode {
+    float cx, cy, cz; //Center of mass
+    float mu;         //G * total mass
+    float radius;     //Every body of the cell is within radius of the center of mass
+    uint32_t first;   //Bodies [first, first + count) in Morton order
+    uint32_t count;
+    uint32_t skip;    //Next node after the subtree (leaf : index + 1)
+};
+
+class BarnesHutTree {
+    public:
+        static constexpr uint32_t LEAF_SIZE = 8;
+        static constexpr int MAX_LEVEL = 21; //21 bits per axis in a 64 bits Morton key
+
+        BarnesHutTree(float theta = 0.5f) : _theta(theta){}
+
+        //Most bodies of a leaf : cells with more bodies are split (FastMultipole sums its leaves directly, it takes
+        //bigger ones).
+        void set_leaf_size(uint32_t leaf_size){
+            _leaf_size = std::max(1u, leaf_size);
+        }
+        uint32_t get_leaf_size() const {
+            return _leaf_size;
+        }
+
+        void set_theta(float theta){
+            _theta = theta;
+        }
+        float get_theta() const {
+            return _theta;
+        }
+        const std::vector<OctreeNode>& get_nodes() const {
+            return _nodes;
+        }
+        //Bodies in Morton order, node ranges index those arrays. get_order()[p] is the index of body p in the tile.
+        const aligned_vector<float>& get_x() const {return _x;}
+        const aligned_vector<float>& get_y() const {return _y;}
+        const aligned_vector<float>& get_z() const {return _z;}
+        const aligned_vector<float>& get_mu() const {return _mu;}
+        const std::vector<uint32_t>& get_order() const {return _order;}
+
+        //Build the tree from the bodies of the tile, then add the approximated accelerations to tile.ax/ay/az.
+        void accumulate(GravityTile& tile){
+            build(tile);
+            evaluate(tile);
+        }
+
+        void build(const GravityTile& tile){
+            _n = tile.n;
+            _nodes.clear();
+            if (_n == 0){return;}
+            compute_bounds(tile);
+            sort_bodies(tile);
+
+            //The 8 subtrees of the root are independent, they are built in parallel into their own node arrays
+            //and appended after the root.
+            OctreeNode root = make_node(0, (uint32_t)_n);
+            _nodes.push_back(root);
+            if (_n <= _leaf_size){
+                set_leaf_mass(_nodes[0]);
+                _nodes[0].skip = 1;
+                return;
+            }
+            uint32_t bounds[9];
+            split(0, (uint32_t)_n, 0, bounds);
+            std::vector<OctreeNode> subtrees[8];
+            run_parallel(8, _n > 4096 ? 1 : 8, [&](std::size_t begin, std::size_t end){
+                for (std::size_t c = begin; c < end; c++){
+                    if (bounds[c + 1] > bounds[c]){
+                        build_node(subtrees[c], bounds[c], bounds[c + 1], 1);
+                    }
+                }
+            });
+            uint32_t children[8];
+            int child_count = 0;
+            for (auto& subtree : subtrees){
+                if (subtree.empty()){continue;}
+                uint32_t offset = (uint32_t)_nodes.size();
+                for (auto& node : subtree){
+                    node.skip += offset;
+                    _nodes.push_back(node);
+                }
+                children[child_count++] = offset;
+            }
+            set_internal_mass(_nodes, 0, children, child_count);
+            _nodes[0].skip = (uint32_t)_nodes.size();
+        }
+
+        void evaluate(GravityTile& tile){
+            if (_n == 0){return;}
+            //Targets are processed in Morton order : consecutive bodies walk almost the same nodes.
+            run_parallel(_n, _n > 1024 ? 256 : _n, [&](std::size_t begin, std::size_t end){
+                for (std::size_t p = begin; p < end; p++){
+                    float ax = 0.0f, ay = 0.0f, az = 0.0f;
+                    walk((uint32_t)p, ax, ay, az);
+                    uint32_t i = _order[p];
+                    tile.ax[i] += ax;
+                    tile.ay[i] += ay;
+                    tile.az[i] += az;
+                }
+            });
+        }
+
+    private:
+        float _theta;
+        uint32_t _leaf_size = LEAF_SIZE;
+        std::size_t _n = 0;
+
+        float _min[3] = {0.0f, 0.0f, 0.0f};
+        float _size = 0.0f;
+
+        std::vector<std::pair<uint64_t, uint32_t>> _keys;
+        std::vector<uint32_t> _order; //Morton rank -> index in the tile
+        aligned_vector<float> _x, _y, _z, _mu; //Bodies in Morton order
+        std::vector<OctreeNode> _nodes;
+
+        //Splits [0, count) in ranges of at most grain elements, run by the shared thread pool.
+        template <typename F>
+        void run_parallel(std::size_t count, std::size_t grain, F&& work){
+            std::size_t tasks = (count + grain - 1) / grain;
+            ThreadPool::instance().run(tasks, [&](std::size_t t){
+                work(t * grain, std::min(count, (t + 1) * grain));
+            });
+        }
+
+        void compute_bounds(const GravityTile& tile){
+            float lo[3] = {tile.x[0], tile.y[0], tile.z[0]};
+            float hi[3] = {tile.x[0], tile.y[0], tile.z[0]};
+            for (std::size_t i = 1; i < _n; i++){
+                lo[0] = std::min(lo[0], tile.x[i]); hi[0] = std::max(hi[0], tile.x[i]);
+                lo[1] = std::min(lo[1], tile.y[i]); hi[1] = std::max(hi[1], tile.y[i]);
+                lo[2] = std::min(lo[2], tile.z[i]); hi[2] = std::max(hi[2], tile.z[i]);
+            }
+            _size = std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]});
+            _size = _size > 0.0f ? _size * 1.0001f : 1.0f; //Keep the bodies on the upper faces inside the cube
+            for (int k = 0; k < 3; k++){_min[k] = lo[k];}
+        }
+
+        static uint64_t spread_bits(uint64_t v){
+            //Insert two zeros between each of the 21 lower bits.
+            v &= 0x1fffff;
+            v = (v | v << 32) & 0x1f00000000ffffULL;
+            v = (v | v << 16) & 0x1f0000ff0000ffULL;
+            v = (v | v << 8)  & 0x100f00f00f00f00fULL;
+            v = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+            v = (v | v << 2)  & 0x1249249249249249ULL;
+            return v;
+        }
+
+        void sort_bodies(const GravityTile& tile){
+            _keys.resize(_n);
+            _order.resize(_n);
+            for (auto* array : {&_x, &_y, &_z, &_mu}){array->resize(_n);}
+            const float scale = (float)(1u << MAX_LEVEL) / _size;
+            const uint64_t max_cell = (1u << MAX_LEVEL) - 1;
+
+            //Keys are computed and sorted by chunks in parallel, then the sorted chunks are merged.
+            std::size_t chunks = _n > 4096 ? 64 : 1;
+            std::size_t chunk = (_n + chunks - 1) / chunks;
+            run_parallel(chunks, 1, [&](std::size_t begin, std::size_t end){
+                for (std::size_t c = begin; c < end; c++){
+                    std::size_t first = c * chunk, last = std::min(_n, first + chunk);
+                    for (std::size_t i = first; i < last; i++){
+                        uint64_t cx = std::min<uint64_t>((uint64_t)((tile.x[i] - _min[0]) * scale), max_cell);
+                        uint64_t cy = std::min<uint64_t>((uint64_t)((tile.y[i] - _min[1]) * scale), max_cell);
+                        uint64_t cz = std::min<uint64_t>((uint64_t)((tile.z[i] - _min[2]) * scale), max_cell);
+                        _keys[i] = {spread_bits(cx) << 2 | spread_bits(cy) << 1 | spread_bits(cz), (uint32_t)i};
+                    }
+                    std::sort(_keys.begin() + first, _keys.begin() + last);
+                }
+            });
+            for (std::size_t width = chunk; width < _n; width *= 2){
+                for (std::size_t first = 0; first + width < _n; first += 2 * width){
+                    std::inplace_merge(_keys.begin() + first, _keys.begin() + first + width,
+                                       _keys.begin() + std::min(_n, first + 2 * width));
+                }
+            }
+
+            for (std::size_t p = 0; p < _n; p++){
+                uint32_t i = _keys[p].second;
+                _order[p] = i;
+                _x[p] = tile.x[i];
+                _y[p] = tile.y[i];
+                _z[p] = tile.z[i];
+                _mu[p] = tile.mu[i];
+            }
+        }
+
+        //Boundaries of the 8 children of the cell owning [first, last) at the given level.
+        void split(uint32_t first, uint32_t last, int level, uint32_t bounds[9]) const {
+            int shift = 3 * (MAX_LEVEL - 1 - level);
+            bounds[0] = first;
+            for (uint64_t c = 0; c < 8; c++){
+                auto it = std::partition_point(_keys.begin() + bounds[c], _keys.begin() + last,
+                                               [&](const std::pair<uint64_t, uint32_t>& key){return ((key.first >> shift) & 7) <= c;});
+                bounds[c + 1] = (uint32_t)(it - _keys.begin());
+            }
+        }
+
+        static OctreeNode make_node(uint32_t first, uint32_t last){
+            OctreeNode node;
+            node.cx = node.cy = node.cz = 0.0f;
+            node.mu = 0.0f;
+            node.radius = 0.0f;
+            node.first = first;
+            node.count = last - first;
+            node.skip = 0;
+            return node;
+        }
+
+        static void set_mass(OctreeNode& node, double mu, double mx, double my, double mz){
+            node.mu = (float)mu;
+            if (mu > 0.0){
+                node.cx = (float)(mx / mu);
+                node.cy = (float)(my / mu);
+                node.cz = (float)(mz / mu);
+            }
+        }
+
+        void set_leaf_mass(OctreeNode& node) const {
+            double mu = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+            for (uint32_t p = node.first; p < node.first + node.count; p++){
+                mu += _mu[p];
+                mx += (double)_mu[p] * _x[p];
+                my += (double)_mu[p] * _y[p];
+                mz += (double)_mu[p] * _z[p];
+            }
+            set_mass(node, mu, mx, my, mz);
+            float radius = 0.0f;
+            for (uint32_t p = node.first; p < node.first + node.count; p++){
+                float dx = _x[p] - node.cx, dy = _y[p] - node.cy, dz = _z[p] - node.cz;
+                radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+            }
+            node.radius = std::sqrt(radius);
+        }
+
+        static void set_internal_mass(std::vector<OctreeNode>& nodes, uint32_t index, const uint32_t* children, int child_count){
+            double mu = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+            for (int c = 0; c < child_count; c++){
+                const OctreeNode& child = nodes[children[c]];
+                mu += child.mu;
+                mx += (double)child.mu * child.cx;
+                my += (double)child.mu * child.cy;
+                mz += (double)child.mu * child.cz;
+            }
+            OctreeNode& node = nodes[index];
+            set_mass(node, mu, mx, my, mz);
+            float radius = 0.0f;
+            for (int c = 0; c < child_count; c++){
+                const OctreeNode& child = nodes[children[c]];
+                float dx = child.cx - node.cx, dy = child.cy - node.cy, dz = child.cz - node.cz;
+                radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz) + child.radius);
+            }
+            node.radius = radius;
+        }
+
+        //Depth first construction, skip indices are local to the nodes array.
+        void build_node(std::vector<OctreeNode>& nodes, uint32_t first, uint32_t last, int level) const {
+            uint32_t index = (uint32_t)nodes.size();
+            nodes.push_back(make_node(first, last));
+            if (last - first <= _leaf_size || level >= MAX_LEVEL){
+                set_leaf_mass(nodes[index]);
+                nodes[index].skip = index + 1;
+                return;
+            }
+            uint32_t bounds[9];
+            split(first, last, level, bounds);
+            uint32_t children[8];
+            int child_count = 0;
+            for (int c = 0; c < 8; c++){
+                if (bounds[c + 1] == bounds[c]){continue;}
+                children[child_count++] = (uint32_t)nodes.size();
+                build_node(nodes, bounds[c], bounds[c + 1], level + 1);
+            }
+            set_internal_mass(nodes, index, children, child_count);
+            nodes[index].skip = (uint32_t)nodes.size();
+        }
+
+        static bool is_leaf(const OctreeNode& node, uint32_t index){
+            return node.skip == index + 1;
+        }
+
+        void walk(uint32_t p, float& ax, float& ay, float& az) const {
+            const float px = _x[p], py = _y[p], pz = _z[p];
+            const float theta2 = _theta * _theta;
+            uint32_t k = 0;
+            const uint32_t end = (uint32_t)_nodes.size();
+            while (k < end){
+                const OctreeNode& node = _nodes[k];
+                //A cell containing the body is always opened (its range in Morton order contains p).
+                bool contains = p - node.first < node.count;
+                if (!contains){
+                    float dx = node.cx - px, dy = node.cy - py, dz = node.cz - pz;
+                    float r2 = dx * dx + dy * dy + dz * dz;
+                    if (4.0f * node.radius * node.radius < theta2 * r2){
+                        add_contribution(dx, dy, dz, node.mu, ax, ay, az);
+                        k = node.skip;
+                        continue;
+                    }
+                }
+                if (is_leaf(node, k)){
+                    for (uint32_t q = node.first; q < node.first + node.count; q++){
+                        if (q == p){continue;}
+                        add_contribution(_x[q] - px, _y[q] - py, _z[q] - pz, _mu[q], ax, ay, az);
+                    }
+                    k = node.skip;
+                }
+                else {
+                    k++;
+                }
+            }
+        }
+
+        static void add_contribution(float dx, float dy, float dz, float mu, float& ax, float& ay, float& az){
+            float inv_r = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+            float w = mu * inv_r * inv_r;
+            ax += w * (dx * inv_r);
+            ay += w * (dy * inv_r);
+            az += w * (dz * inv_r);
+        }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef BLOCK_TIMESTEP_HPP
+#define BLOCK_TIMESTEP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+
+//Hierarchical block timesteps : every body advances with its own step h = base * 2^e, e in [-FINE_LEVELS, COARSE_LEVELS].
+//
+//Time is counted in ticks of base / 2^FINE_LEVELS, so every step is a power of two of ticks, and a body only starts
+//a step of 2^k ticks on a multiple of 2^k : the bodies sharing a step are synchronised (a block) and the coarser
+//blocks end on the ticks where the finer ones also end.
+//At the end of its step (sync) a body gets a new acceleration and a velocity Verlet update
+//v += h * (a_old + a_new) / 2, then its next step is chosen from its acceleration and jerk, h = eta * |a| / |da/dt|,
+//the jerk being the change of acceleration over the step. A step can at most double at each sync. The acceleration of
+//a satellite is taken relative to its center (set_reference()) : the pull of the sun, shared by both, does not set the
+//time scale of the orbit.
+//Between two syncs the position of a body is the prediction x0 + v t + a t^2 / 2, which is also the Verlet position at
+//the end of its step : bodies that are not synchronised are still accurate sources for the active ones.
+template <typename Store>
+class BasicBlockTimesteps {
+    public:
+        using real = typename Store::position_type;
+
+        static constexpr int FINE_LEVELS = 6;   //Smallest step : base / 64
+        static constexpr int COARSE_LEVELS = 6; //Largest step : base * 64
+
+        explicit BasicBlockTimesteps(float base = 1.0f, float eta = 0.02f) : _base(base), _eta(eta){}
+
+        void set_base_step(float base){
+            _base = base;
+        }
+        void set_accuracy(float eta){
+            //Fraction of the acceleration time scale |a| / |da/dt| taken as step, smaller is more accurate.
+            _eta = eta;
+        }
+        float get_accuracy() const {
+            return _eta;
+        }
+
+        //Starts the scheme with the bodies of the list, all synchronised at the current positions and velocities.
+        //Every body is due at the first tick, with the finest step.
+        void start(const Store& store, const std::vector<std::size_t>& bodies){
+            _bodies.assign(bodies.begin(), bodies.end());
+            std::size_t n = store.size();
+            for (auto* array : {&_x0, &_y0, &_z0}){array->assign(n, 0);}
+            _reference.resize(n);
+            for (std::size_t i = 0; i < n; i++){_reference[i] = (uint32_t)i;}
+            _exponent.assign(n, -FINE_LEVELS);
+            _max_exponent.assign(n, COARSE_LEVELS);
+            _last.assign(n, 0);
+            _next.assign(n, 0);
+            _started.assign(n, 0);
+            _tick = 0;
+            _evaluations = 0;
+            for (std::size_t i : _bodies){
+                _x0[i] = store.x[i]; _y0[i] = store.y[i]; _z0[i] = store.z[i];
+            }
+            find_due();
+        }
+
+        uint64_t get_tick() const {
+            return _tick;
+        }
+        uint64_t ticks_per_base() const {
+            return uint64_t(1) << FINE_LEVELS;
+        }
+        //Bodies whose step ends at the current tick.
+        const std::vector<uint32_t>& get_due() const {
+            return _due;
+        }
+        int get_exponent(std::size_t i) const {
+            return _exponent[i];
+        }
+        //Body whose acceleration is subtracted from the one of body i in the step criterion, i itself for none.
+        //Must be called after start().
+        void set_reference(std::size_t i, std::size_t reference){
+            _reference[i] = (uint32_t)reference;
+        }
+        //Upper bound of the next step of a body, applied at its next sync (e.g. a planet not coarser than its moons).
+        void set_max_exponent(std::size_t i, int exponent){
+            _max_exponent[i] = std::max(-FINE_LEVELS, std::min(COARSE_LEVELS, exponent));
+        }
+        //Number of accelerations computed since start(), one per body and per sync.
+        uint64_t get_force_evaluations() const {
+            return _evaluations;
+        }
+
+        //Positions of every body at the current tick.
+        void predict(Store& store) const {
+            const real tick_length = (real)_base / ticks_per_base();
+            for (std::size_t i : _bodies){
+                real t = (real)(_tick - _last[i]) * tick_length;
+                real half_t2 = (real)0.5f * t * t;
+                store.x[i] = _x0[i] + store.vx[i] * t + half_t2 * store.ax[i];
+                store.y[i] = _y0[i] + store.vy[i] * t + half_t2 * store.ay[i];
+                store.z[i] = _z0[i] + store.vz[i] * t + half_t2 * store.az[i];
+            }
+        }
+
+        //Velocities of every body at the current tick, predicted like the positions (v + a t) : the state to start
+        //again from (collisions).
+        void predict_velocities(Store& store) const {
+            predict_velocities(store, store.vx.data(), store.vy.data(), store.vz.data());
+        }
+        //Same into vx, vy, vz (rows of the store, e.g. a copy of its velocities), the store unchanged (checkpoints).
+        void predict_velocities(const Store& store, real* vx, real* vy, real* vz) const {
+            const real tick_length = (real)_base / ticks_per_base();
+            for (std::size_t i : _bodies){
+                real t = (real)(_tick - _last[i]) * tick_length;
+                vx[i] = store.vx[i] + t * store.ax[i];
+                vy[i] = store.vy[i] + t * store.ay[i];
+                vz[i] = store.vz[i] + t * store.az[i];
+            }
+        }
+
+        //Keeps the acceleration of the due bodies (from their previous sync) before they are recomputed.
+        void save_accelerations(const Store& store){
+            _a_old.resize(3 * _due.size());
+            for (std::size_t k = 0; k < _due.size(); k++){
+                uint32_t i = _due[k];
+                _a_old[3 * k] = store.ax[i]; _a_old[3 * k + 1] = store.ay[i]; _a_old[3 * k + 2] = store.az[i];
+            }
+        }
+
+        //Ends the step of the due bodies, whose new accelerations are in the store, and starts their next one.
+        void synchronize(Store& store){
+            const real tick_length = (real)_base / ticks_per_base();
+            for (std::size_t k = 0; k < _due.size(); k++){
+                uint32_t i = _due[k];
+                real ax_old = _a_old[3 * k], ay_old = _a_old[3 * k + 1], az_old = _a_old[3 * k + 2];
+                real h = (real)(_tick - _last[i]) * tick_length;
+                store.vx[i] += (real)0.5f * h * (ax_old + store.ax[i]);
+                store.vy[i] += (real)0.5f * h * (ay_old + store.ay[i]);
+                store.vz[i] += (real)0.5f * h * (az_old + store.az[i]);
+                _x0[i] = store.x[i]; _y0[i] = store.y[i]; _z0[i] = store.z[i];
+
+                int exponent = -FINE_LEVELS;
+                if (_started[i]){
+                    real jx = store.ax[i] - ax_old, jy = store.ay[i] - ay_old, jz = store.az[i] - az_old;
+                    real change = std::sqrt(jx * jx + jy * jy + jz * jz);
+                    uint32_t r = _reference[i];
+                    real rx = store.ax[i], ry = store.ay[i], rz = store.az[i];
+                    if (r != i){rx -= store.ax[r]; ry -= store.ay[r]; rz -= store.az[r];}
+                    real a = std::sqrt(rx * rx + ry * ry + rz * rz);
+                    //h_new = eta |a| / |jerk| with |jerk| = change / h
+                    exponent = COARSE_LEVELS;
+                    if (change > 0.0f){
+                        double wanted = _eta * a * (double)h / change;
+                        exponent = (int)std::floor(std::log2(wanted / _base));
+                    }
+                    exponent = std::min({exponent, _exponent[i] + 1, _max_exponent[i], COARSE_LEVELS});
+                    exponent = std::max(exponent, -FINE_LEVELS);
+                }
+                //A step of 2^k ticks only starts on a multiple of 2^k.
+                while (exponent > -FINE_LEVELS && _tick % ticks(exponent) != 0){exponent--;}
+                _exponent[i] = exponent;
+                _started[i] = 1;
+                _last[i] = _tick;
+                _next[i] = _tick + ticks(exponent);
+            }
+            _evaluations += _due.size();
+        }
+
+        //Moves to the next tick where a body is due, without going past end. Returns false when end is reached.
+        bool advance(uint64_t end){
+            uint64_t next = end;
+            for (std::size_t i : _bodies){next = std::min(next, _next[i]);}
+            _tick = next;
+            find_due();
+            return _tick < end;
+        }
+
+    private:
+        float _base;
+        float _eta;
+        uint64_t _tick = 0;
+        uint64_t _evaluations = 0;
+        std::vector<std::size_t> _bodies;
+        std::vector<uint32_t> _due;
+        aligned_vector<real> _x0, _y0, _z0; //Position at the last sync
+        std::vector<real> _a_old;
+        std::vector<uint32_t> _reference;
+        std::vector<int> _exponent, _max_exponent;
+        std::vector<uint64_t> _last, _next; //Ticks of the last and next sync
+        std::vector<uint8_t> _started;
+
+        static uint64_t ticks(int exponent){
+            return uint64_t(1) << (exponent + FINE_LEVELS);
+        }
+        void find_due(){
+            _due.clear();
+            for (std::size_t i : _bodies){
+                if (_next[i] == _tick){_due.push_back((uint32_t)i);}
+            }
+        }
+};
+
+using BlockTimesteps = BasicBlockTimesteps<BodyStore>;
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef BODY_STORE_HPP
+#define BODY_STORE_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+//Allocator giving 64 bytes aligned storage (one cache line, wide enough for AVX-512 loads).
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n){
+        if (n == 0) return nullptr;
+        //Size must be a multiple of the alignment for aligned allocation.
+        std::size_t bytes = ((n * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+        void* ptr = ::operator new(bytes, std::align_val_t(Alignment));
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+//Precision policies of the body store, chosen at compile time.
+//SinglePrecision : every position in float. Absolute positions of ~1e12 m (outer planets) are only known to ~1e5 m,
+//and the Verlet update 2x - x_prev loses the small displacements of a step.
+//MixedPrecision : positions in double. The force kernels keep working in float (and keep their SIMD width) on the
+//offsets of the bodies relative to the origin of their system (center body), which are small and accurate.
+//Velocities and accelerations follow the positions : the pull of the center, computed in double, is not rounded to
+//float once summed with the small mutual terms (a 6e-8 noise on the sun pull bounds the energy error of any scheme).
+struct SinglePrecision {
+    using position_type = float;
+};
+struct MixedPrecision {
+    using position_type = double;
+};
+
+//Structure of arrays holding the physical state of every body of an OrbitalSystem tree.
+//A body is only an index in those arrays, CelestialObject keeps this index as a handle.
+//Arrays are only resized by add_body(), a step of the simulation never allocates.
+template <typename Precision>
+struct BasicBodyStore {
+    using position_type = typename Precision::position_type;
+    using vec_type = glm::vec<3, position_type>;
+
+    //Current position
+    aligned_vector<position_type> x, y, z;
+    //Previous position (Verlet)
+    aligned_vector<position_type> x_prev, y_prev, z_prev;
+    //Velocity : initial velocity with Verlet (only used by its setup), velocity at the last step of the body with
+    //block timesteps
+    aligned_vector<position_type> vx, vy, vz;
+    //Total acceleration of the current step
+    aligned_vector<position_type> ax, ay, az;
+    aligned_vector<float> m;
+
+    std::size_t size() const {
+        return m.size();
+    }
+
+    void reserve(std::size_t n){
+        for (auto* array : {&x, &y, &z, &x_prev, &y_prev, &z_prev, &vx, &vy, &vz, &ax, &ay, &az}){array->reserve(n);}
+        m.reserve(n);
+    }
+
+    std::size_t add_body(const vec_type& r, const vec_type& r_prev, const vec_type& v, float mass){
+        x.push_back(r.x);           y.push_back(r.y);           z.push_back(r.z);
+        x_prev.push_back(r_prev.x); y_prev.push_back(r_prev.y); z_prev.push_back(r_prev.z);
+        vx.push_back(v.x);          vy.push_back(v.y);          vz.push_back(v.z);
+        ax.push_back(0.0f);         ay.push_back(0.0f);         az.push_back(0.0f);
+        m.push_back(mass);
+        return m.size() - 1;
+    }
+
+    vec_type get_pos(std::size_t i) const {
+        return {x[i], y[i], z[i]};
+    }
+    void set_pos(std::size_t i, const vec_type& pos){
+        x[i] = pos.x; y[i] = pos.y; z[i] = pos.z;
+    }
+    vec_type get_prev_pos(std::size_t i) const {
+        return {x_prev[i], y_prev[i], z_prev[i]};
+    }
+    vec_type get_velocity(std::size_t i) const {
+        return {vx[i], vy[i], vz[i]};
+    }
+    void set_velocity(std::size_t i, const vec_type& v){
+        vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+    }
+    vec_type get_acceleration(std::size_t i) const {
+        return {ax[i], ay[i], az[i]};
+    }
+
+    void reset_acceleration(std::size_t i){
+        ax[i] = 0; ay[i] = 0; az[i] = 0;
+    }
+    void add_acceleration(std::size_t i, const vec_type& acceleration){
+        ax[i] += acceleration.x; ay[i] += acceleration.y; az[i] += acceleration.z;
+    }
+};
+
+//Precision of the simulation, define ORBITAL_SINGLE_PRECISION to get back the all float store.
+#ifdef ORBITAL_SINGLE_PRECISION
+using OrbitalPrecision = SinglePrecision;
+#else
+using OrbitalPrecision = MixedPrecision;
+#endif
+using BodyStore = BasicBodyStore<OrbitalPrecision>;
+
+#endif
@@ -0,0 +1,859 @@
+#ifndef CELESTIAL_BODY_HPP
+#define CELESTIAL_BODY_HPP
+
+#include "body_store.hpp"
+#include "gravity_kernel.hpp"
+#include "parallel_gravity.hpp"
+#include "barnes_hut.hpp"
+#include "fast_multipole.hpp"
+#include "block_timestep.hpp"
+#include "symplectic_integrator.hpp"
+#include "position_snapshot.hpp"
+#include "collision.hpp"
+#include "test_particles.hpp"
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+const float G = 6.674e-11f;
+const float AU = 1.496e11f;
+const float SCALE = 1.5f;
+const float dt = 6*3600.0f;
+
+//Physics of the orbital systems, without any rendering : nothing here needs a GL context (see celestial_object.hpp
+//for the rendered bodies, orbital_sim for a headless run).
+
+class OrbitalSystem;
+
+//Solver used for the mutual interactions of a system (planets between them, satellites between them).
+//Exact is the all-pairs kernel and stays the reference, BarnesHut is O(N log N) for large populations,
+//FastMultipole is O(N) for the densest ones (rings, belts), its accuracy is set by the expansion order.
+enum class ForceBackend {Exact, BarnesHut, FastMultipole};
+
+class CelestialBody{
+
+    public:
+        CelestialBody (const std::vector<float>& r0, const std::vector<float>& v0, float radius, float mass,
+                       OrbitalSystem* orbitalSystem = nullptr) :
+        _radius(radius), _m(mass), _r0(glm::make_vec3(r0.data())), _v0(glm::make_vec3(v0.data())),
+        _orbitalCenter(nullptr), _orbitalSystem(orbitalSystem){}
+        virtual ~CelestialBody(){}
+        void attach(BodyStore* store){
+            //Register the body into the store of its OrbitalSystem. If the body was already living in another store
+            //(subsystem added to a bigger system) its current state is moved.
+            if (_store == store){return;}
+            BodyStore::vec_type r(_r0), r_prev(_r0), v(_v0);
+            if (_store){
+                r = _store->get_pos(_id);
+                r_prev = _store->get_prev_pos(_id);
+                v = _store->get_velocity(_id);
+            }
+            _id = store->add_body(r, r_prev, v, _m);
+            _store = store;
+        }
+        void integrate(){
+            //Verlet integration, in the precision of the positions.
+            using real = BodyStore::position_type;
+            BodyStore& s = *_store;
+            real rx = 2 * s.x[_id] - s.x_prev[_id] + (real)dt * dt * s.ax[_id];
+            real ry = 2 * s.y[_id] - s.y_prev[_id] + (real)dt * dt * s.ay[_id];
+            real rz = 2 * s.z[_id] - s.z_prev[_id] + (real)dt * dt * s.az[_id];
+            s.x_prev[_id] = s.x[_id];
+            s.y_prev[_id] = s.y[_id];
+            s.z_prev[_id] = s.z[_id];
+            s.x[_id] = rx;
+            s.y[_id] = ry;
+            s.z[_id] = rz;
+        }
+        BodyStore::vec_type compute_acceleration_from(const CelestialBody* orbiter) const {
+            //In the precision of the positions.
+            using real = BodyStore::position_type;
+            const BodyStore& s = *_store;
+            std::size_t j = orbiter->_id;
+            real dx = s.x[j] - s.x[_id];
+            real dy = s.y[j] - s.y[_id];
+            real dz = s.z[j] - s.z[_id];
+
+            real norm = sqrt(dx * dx + dy * dy + dz * dz);
+            double inv = (real)1 / (norm * norm * norm);
+            real acceleration_magnitude = G * s.m[j] * inv;
+
+            return {acceleration_magnitude * dx, acceleration_magnitude * dy, acceleration_magnitude * dz}; 
+        }
+        void add_acceleration(const BodyStore::vec_type& acceleration){
+            _store->add_acceleration(_id, acceleration);
+        }
+        void reset_acceleration(){
+            _store->reset_acceleration(_id);
+        }
+        void setup_verlet(){
+            using real = BodyStore::position_type;
+            BodyStore& s = *_store;
+            s.x_prev[_id] = s.x[_id] - (real)s.vx[_id] * dt + (real)0.5f * dt * dt * s.ax[_id];
+            s.y_prev[_id] = s.y[_id] - (real)s.vy[_id] * dt + (real)0.5f * dt * dt * s.ay[_id];
+            s.z_prev[_id] = s.z[_id] - (real)s.vz[_id] * dt + (real)0.5f * dt * dt * s.az[_id];
+        }
+        glm::vec3 get_pos() const {
+            //Rounded to float, for the rendering. get_position() keeps the precision of the store.
+            return glm::vec3(get_position());
+        }
+        BodyStore::vec_type get_position() const {
+            return _store ? _store->get_pos(_id) : BodyStore::vec_type(_r0);
+        }
+        void set_pos(const glm::vec3& pos){
+            if (_store){_store->set_pos(_id, BodyStore::vec_type(pos));}
+            else {_r0 = pos;}
+        }
+        float get_mass() const {
+            return _m;
+        }
+        void set_mass(float mass){
+            //OrbitalSystem::invalidate() must follow for a body of a running system.
+            _m = mass;
+            if (_store){_store->m[_id] = mass;}
+        }
+        std::size_t get_id() const {
+            return _id;
+        }
+        BodyStore* get_store() const {
+            return _store;
+        }
+        float get_radius() const {
+            return _radius;
+        }
+        void set_radius(float radius){
+            _radius = radius;
+        }
+        CelestialBody* get_orbitalCenter(){
+            return _orbitalCenter;
+        }
+        std::vector<CelestialBody*>& get_orbitersBody(){
+            return _orbitersBody;
+        }
+        void set_orbitalSystem(OrbitalSystem* orbitalSystem){
+            _orbitalSystem = orbitalSystem;
+        }
+        void set_orbitalCenter(CelestialBody* orbitalCenter){
+            _orbitalCenter = orbitalCenter;
+        }
+        OrbitalSystem* get_OrbitalSystem() const {
+            return _orbitalSystem;
+        }
+
+    private:
+        float _radius;
+        float _m; //Mass of the object
+
+        //Physical state lives in the BodyStore of the OrbitalSystem, the object only keeps its index.
+        BodyStore* _store = nullptr;
+        std::size_t _id = 0;
+        glm::vec3 _r0; //Initial conditions, used until the object is added to an OrbitalSystem.
+        glm::vec3 _v0;
+
+        std::vector<CelestialBody*> _orbitersBody; //Object orbiting around CelestialBody
+        CelestialBody* _orbitalCenter; //Around is the object the CelestialBody orbit around. Sun for Earth, Earth for moon. 
+        OrbitalSystem*   _orbitalSystem; 
+};
+
+//Pairwise term of the flat interaction list of an OrbitalSystem : target += G m_source (r_source - r_target) / r^3.
+struct Interaction {
+    uint32_t target;
+    uint32_t source;
+    float mu; //G * mass of the source
+};
+
+//Mutual interactions of a set of bodies (the planets, the satellites of a subsystem) : bodies [first, first + count) of
+//the flat body array, evaluated by the solver of the system owning them. The pairs before end_pair of the list are
+//evaluated before the group.
+struct InteractionGroup {
+    OrbitalSystem* system;
+    uint32_t first;
+    uint32_t count;
+    uint32_t end_pair;
+};
+
+class OrbitalSystem {
+    public:
+        OrbitalSystem() : _store(std::make_shared<BodyStore>()){}
+
+        ~OrbitalSystem(){}
+
+        void define_center(CelestialBody* center){
+            _center = center;
+            _center->attach(_store.get());
+            invalidate();
+        }
+        void add_orbiters(CelestialBody* orbiter){
+            _orbiters.push_back(orbiter);
+            orbiter->attach(_store.get());
+            orbiter->set_orbitalCenter(_center);
+            invalidate();
+        }
+        //The body leaves the tree (its row of the store stays, unused). It is not deleted.
+        void remove_orbiter(CelestialBody* orbiter){
+            _orbiters.erase(std::remove(_orbiters.begin(), _orbiters.end(), orbiter), _orbiters.end());
+            invalidate();
+        }
+        void add_subsystem(std::shared_ptr<OrbitalSystem> subsystem) {
+            _subsystems.push_back(subsystem);
+            subsystem->share_store(_store); //Bodies of the subsystem join the store of the system.
+            subsystem->_parent = this;
+            _center->get_orbitersBody().push_back(subsystem->_center);
+            invalidate();
+        }
+        //The tree is compiled into flat lists at the next step (see compile()). Called by every change of the tree, to
+        //be called after a change of the masses.
+        void invalidate(){
+            OrbitalSystem* root = get_root();
+            root->_compiled = false;
+            root->_integrated.clear();
+        }
+        void reserve_bodies(std::size_t n){
+            _store->reserve(n);
+        }
+        void initialize(){
+            if (_center && _center->get_orbitalCenter()){ //if _center = True and _center->get_orbitalCenter() != nullptr it means its not the sun -> Initialize
+                _center->reset_acceleration();
+                _center->add_acceleration(_center->compute_acceleration_from(_center->get_orbitalCenter()));
+                _center->setup_verlet();
+            }
+            for (auto& orbiter: _orbiters){
+                orbiter->reset_acceleration();
+                orbiter->add_acceleration(orbiter->compute_acceleration_from(_center));
+                orbiter->setup_verlet();
+            }
+            for(auto& subsystem: _subsystems){
+                subsystem->initialize();
+            }
+        }
+        //Calls f(body) for the center, the orbiters then the subsystems of the tree.
+        template <typename F>
+        void for_each_body(F&& f){
+            if (_center){f(_center);}
+            for (auto& orbiter: _orbiters){f(orbiter);}
+            for (auto& subsystem: _subsystems){subsystem->for_each_body(f);}
+        }
+        void capture(PositionSnapshot& snapshot) const {
+            snapshot.capture(*_store);
+        }
+        void compute_all_accelerations(){
+            //Interations are : Sun -> Planet (both orbiters and center of subsystem)(Reverse interaction not interesting as we don't want the sun to move)
+            //                  Planet (orbiters) -> Planet (orbiters)
+            //                  Planet (orbiters) -> Planet (center of subsystem)
+            //                  Planet (center of subsystem) -> Planet (center of subsystem)
+            //                  Sun -> Satellite 
+            //                  Planet (center of subsystem) -> Satellite
+            //They are compiled once in the flat interaction list (see compile()), a step is a linear pass on it.
+            compile();
+            run_interactions(nullptr);
+        }
+
+        void integrate(){
+            //Verlet integration of every moving body of the tree (a fixed center does not move : the sun in the solar
+            //system, the Earth is the center of the Earth Moon system but not fixed in the solar system).
+            using real = BodyStore::position_type;
+            compile();
+            BodyStore& s = *_store;
+            for (uint32_t i : _moving){
+                real rx = 2 * s.x[i] - s.x_prev[i] + (real)dt * dt * s.ax[i];
+                real ry = 2 * s.y[i] - s.y_prev[i] + (real)dt * dt * s.ay[i];
+                real rz = 2 * s.z[i] - s.z_prev[i] + (real)dt * dt * s.az[i];
+                s.x_prev[i] = s.x[i];
+                s.y_prev[i] = s.y[i];
+                s.z_prev[i] = s.z[i];
+                s.x[i] = rx;
+                s.y[i] = ry;
+                s.z[i] = rz;
+            }
+        }
+        void step(){
+            bool collide = _collision_response != CollisionResponse::None;
+            if (collide){
+                compile();
+                _detector.start(*_store, _colliders);
+            }
+            bool particles = !_particles.empty();
+            if (particles){
+                compile();
+                gather_sources();
+            }
+            if (_block_timesteps){block_step();}
+            else if (_integrator.get_scheme() != IntegratorScheme::Verlet){symplectic_step();}
+            else {
+                compute_all_accelerations();
+                integrate();
+            }
+            if (particles){_particles.step(_sources, dt, _simd_level);}
+            if (collide){resolve_collisions();}
+        }
+        void set_collision_response(CollisionResponse response, float restitution = 1.0f){
+            //Bodies of the whole tree touching during a step (see collision.hpp) are merged or bounced at its end.
+            //restitution is the ratio of the relative normal velocity after and before a bounce (1 : elastic).
+            //A merge removes the absorbed body from the tree : with a PhysicsThread, the tree must then only be
+            //walked by the thread stepping it (render from the snapshot ids, not from for_each_body()).
+            _collision_response = response;
+            _restitution = restitution;
+            invalidate();
+        }
+        CollisionResponse get_collision_response() const {
+            return _collision_response;
+        }
+        //Collisions resolved at the last step, and since the start.
+        const std::vector<Collision>& get_collisions() const {
+            return _collisions;
+        }
+        uint64_t get_collision_count() const {
+            return _collision_count;
+        }
+        //Massless particle at r with the velocity v, moved by the steps of the root system : it feels every massive body
+        //of the tree and pulls none (see test_particles.hpp). The particles always use the position Verlet with the
+        //bodies at the start of the step, whatever the integrator of the bodies, and take no part in the collisions.
+        //Returns the index of the particle in get_test_particles().
+        std::size_t add_test_particle(const BodyStore::vec_type& r, const BodyStore::vec_type& v){
+            OrbitalSystem* root = get_root();
+            root->compile();
+            root->gather_sources();
+            return root->_particles.add(r, v, root->_sources, dt);
+        }
+        void reserve_test_particles(std::size_t n){
+            get_root()->_particles.reserve(n);
+        }
+        const TestParticles& get_test_particles() const {
+            return get_root()->_particles;
+        }
+        TestParticles& get_test_particles(){
+            return get_root()->_particles;
+        }
+        void set_integrator(IntegratorScheme scheme){
+            //Verlet keeps the position Verlet of integrate(), the other schemes work on the velocities (see
+            //symplectic_integrator.hpp). To be chosen before the first step, like the block timesteps which replace it.
+            _integrator.set_scheme(scheme);
+            _integrator.reset();
+            _integrated.clear();
+        }
+        const SymplecticIntegrator& get_integrator() const {
+            return _integrator;
+        }
+        void set_block_timesteps(bool enabled){
+            //Individual power of two steps from dt / 64 to dt * 64 (see block_timestep.hpp) instead of dt for every
+            //body. step() still advances the system by dt. Mutual interactions then always use the all-pairs kernel.
+            //To be chosen before the first step : the Verlet state (previous positions) is not kept up to date.
+            _block_timesteps = enabled;
+            _blocks_started = false;
+        }
+        bool uses_block_timesteps() const {
+            return _block_timesteps;
+        }
+        void set_timestep_accuracy(float eta){
+            _blocks.set_accuracy(eta);
+        }
+        const BlockTimesteps& get_block_timesteps() const {
+            return _blocks;
+        }
+        //Velocities of every body at the current time into vx, vy, vz, rows of the store holding a copy of its
+        //velocities : while block timesteps run, the store keeps the velocity of the last sync of each body.
+        void predict_velocities(BodyStore::position_type* vx, BodyStore::position_type* vy,
+                                BodyStore::position_type* vz) const {
+            if (_block_timesteps && _blocks_started){_blocks.predict_velocities(*_store, vx, vy, vz);}
+        }
+        void set_simd_level(SimdLevel level){
+            //SimdLevel::Scalar gives the reference results, see gravity_kernel.hpp for the tolerance of the others.
+            _simd_level = level;
+            for (auto& subsystem : _subsystems){subsystem->set_simd_level(level);}
+        }
+        SimdLevel get_simd_level() const {
+            return _simd_level;
+        }
+        void set_thread_count(unsigned int threads){
+            //Threads of the pool shared by every system, the results do not depend on it (see parallel_gravity.hpp).
+            ThreadPool::instance().set_thread_count(threads);
+        }
+        unsigned int get_thread_count() const {
+            return ThreadPool::instance().get_thread_count();
+        }
+        void set_force_backend(ForceBackend backend){
+            //Only for this system, each subsystem keeps its own solver (e.g. FMM for a ring, exact for the planets).
+            _force_backend = backend;
+        }
+        ForceBackend get_force_backend() const {
+            return _force_backend;
+        }
+        void set_opening_angle(float theta){
+            //Opening angle of BarnesHut and FastMultipole, 0.5 is usually a good tradeoff.
+            _tree.set_theta(theta);
+            _fmm.set_theta(theta);
+        }
+        void set_expansion_order(int order){
+            //FastMultipole expansion order, from 1 to FastMultipole::MAX_ORDER.
+            _fmm.set_expansion_order(order);
+        }
+        double measure_force_error(){
+            //Maximum error of the mutual accelerations of the current backend against a double precision exact sum,
+            //relative to the sum of the magnitudes of the contributions (see gravity_benchmark).
+            //Same bodies as the mutual interactions of step() : orbiters and centers of the subsystems.
+            std::vector<uint32_t> planets;
+            for (auto& orbiter: _orbiters){planets.push_back((uint32_t)orbiter->get_id());}
+            for (auto& subsystem: _subsystems){planets.push_back((uint32_t)subsystem->_center->get_id());}
+            gather(planets.data(), planets.size());
+            std::vector<double> reference = reference_accelerations(_tile);
+            accumulate_tile();
+            return max_relative_error(_tile, reference);
+        }
+        void fix_center(bool fixed){
+            _center_is_fixed = fixed;
+            invalidate();
+        }
+        bool is_center_fixed() const {
+            return _center_is_fixed;
+        }
+        CelestialBody* get_center(){
+            return _center;
+        }
+        const std::vector<CelestialBody*>& get_orbiters() const {
+            return _orbiters;
+        }
+        const std::vector<std::shared_ptr<OrbitalSystem>>& get_subsystems() const {
+            return _subsystems;
+        }
+        //Flat interaction list of the tree (compiled at the first step after a change of the tree).
+        const std::vector<Interaction>& get_interactions(){
+            compile();
+            return _interactions;
+        }
+        const std::vector<InteractionGroup>& get_interaction_groups(){
+            compile();
+            return _groups;
+        }
+        //Bodies of the groups, [first, first + count) for each group.
+        const std::vector<uint32_t>& get_interaction_bodies(){
+            compile();
+            return _group_bodies;
+        }
+        //Bodies moved by the Verlet integration (all but the fixed centers).
+        const std::vector<uint32_t>& get_verlet_bodies(){
+            compile();
+            return _moving;
+        }
+        BodyStore& get_store(){
+            return *_store;
+        }
+
+    private :
+        CelestialBody* _center = nullptr;
+        std::vector<CelestialBody*> _orbiters;
+        std::vector<std::shared_ptr<OrbitalSystem>> _subsystems;
+        std::shared_ptr<BodyStore> _store; //Shared by every subsystem of the tree.
+        bool _center_is_fixed = false;
+        OrbitalSystem* _parent = nullptr;
+
+        //Flat form of the tree, built by compile() on the system stepped (root) : store ids only, no pointer to follow.
+        bool _compiled = false;
+        std::vector<uint32_t> _reset;        //Bodies whose acceleration is computed by the interactions
+        std::vector<Interaction> _interactions;
+        std::vector<InteractionGroup> _groups;
+        std::vector<uint32_t> _group_bodies; //Bodies of the groups, one after the other
+        std::vector<uint32_t> _moving;       //Bodies integrated by Verlet
+        std::vector<uint32_t> _colliders;    //Every body of the tree, with a collision response
+        std::vector<float> _collider_radius;
+        std::vector<CelestialBody*> _body_by_id;
+        std::vector<OrbitalSystem*> _owner_by_id; //System the body is an orbiter of, nullptr for a center
+        std::vector<uint8_t> _fixed_by_id;        //Fixed center (of the root or of a subsystem), never moved
+        std::vector<uint32_t> _source_ids;   //Bodies of the tree with a mass, pulling the test particles
+
+        SimdLevel _simd_level = detect_simd_level();
+        ForceBackend _force_backend = ForceBackend::Exact;
+        GravityTile _tile; //Scratch buffers of the all-pairs kernel, kept between steps.
+        ParallelGravity _parallel;
+        BarnesHutTree _tree;
+        FastMultipole _fmm;
+
+        bool _block_timesteps = false;
+        bool _blocks_started = false;
+        BlockTimesteps _blocks;
+        std::vector<uint8_t> _active; //Bodies due at the current tick, by store id
+        std::vector<uint32_t> _targets; //Index in the gathered tile of the active bodies
+
+        SymplecticIntegrator _integrator;
+        std::vector<IntegratedBody> _integrated; //Moving bodies of the tree with their primary
+
+        CollisionResponse _collision_response = CollisionResponse::None;
+        float _restitution = 1.0f;
+        CollisionDetector _detector;
+        std::vector<Collision> _collisions;
+        std::vector<uint8_t> _absorbed; //By store id, during resolve_collisions()
+        uint64_t _collision_count = 0;
+
+        TestParticles _particles;
+        ParticleSources _sources; //Bodies of _source_ids at the start of the step
+
+        OrbitalSystem* get_root(){
+            OrbitalSystem* root = this;
+            while (root->_parent){root = root->_parent;}
+            return root;
+        }
+        const OrbitalSystem* get_root() const {
+            return const_cast<OrbitalSystem*>(this)->get_root();
+        }
+        void gather_sources(){
+            const BodyStore& s = *_store;
+            _sources.resize(_source_ids.size());
+            for (std::size_t k = 0; k < _source_ids.size(); k++){
+                uint32_t i = _source_ids[k];
+                _sources.x[k] = s.x[i];
+                _sources.y[k] = s.y[i];
+                _sources.z[k] = s.z[i];
+                _sources.mu[k] = G * s.m[i];
+            }
+        }
+
+        void gather(const uint32_t* ids, std::size_t count){
+            //The kernels get float offsets relative to the center of the system (double with MixedPrecision).
+            BodyStore::vec_type origin = _center ? _center->get_position() : BodyStore::vec_type(0);
+            _tile.resize(count);
+            for (size_t k = 0; k < count; k++){
+                _tile.set_body(k, *_store, ids[k], G, origin);
+            }
+        }
+        void accumulate_tile(){
+            switch (_force_backend){
+                case ForceBackend::BarnesHut: _tree.accumulate(_tile); break;
+                case ForceBackend::FastMultipole: _fmm.accumulate(_tile, _simd_level); break;
+                default: _parallel.accumulate(_tile, _simd_level); break;
+            }
+        }
+
+        void block_step(){
+            //Ends the steps of the due bodies (new acceleration and velocity, next step), moves to the next tick where
+            //some bodies are due, until dt has elapsed. Positions of every body are then predicted at this time.
+            if (!_blocks_started){start_block_timesteps();}
+            uint64_t end = _blocks.get_tick() + _blocks.ticks_per_base();
+            do {
+                const std::vector<uint32_t>& due = _blocks.get_due();
+                if (due.empty()){continue;}
+                _blocks.predict(*_store);
+                _blocks.save_accelerations(*_store);
+                std::fill(_active.begin(), _active.end(), 0);
+                for (uint32_t i : due){_active[i] = 1;}
+                run_interactions(_active.data());
+                limit_center_steps();
+                _blocks.synchronize(*_store);
+            } while (_blocks.advance(end));
+            _blocks.predict(*_store);
+        }
+
+        void symplectic_step(){
+            if (_integrated.empty()){collect_moving_bodies(_integrated);}
+            _integrator.step(*_store, _integrated, dt, [this](){compute_all_accelerations();});
+        }
+
+        void start_block_timesteps(){
+            compile();
+            //Every body but a fixed center, starting from the current positions and the initial velocities.
+            std::vector<IntegratedBody> moving;
+            collect_moving_bodies(moving);
+            std::vector<std::size_t> bodies;
+            for (const IntegratedBody& body : moving){bodies.push_back(body.id);}
+            _blocks.set_base_step(dt);
+            _blocks.start(*_store, bodies);
+            for (auto& subsystem : _subsystems){
+                for (auto& satellite : subsystem->_orbiters){
+                    _blocks.set_reference(satellite->get_id(), subsystem->_center->get_id());
+                }
+            }
+            _active.assign(_store->size(), 0);
+            _blocks_started = true;
+        }
+        void collect_moving_bodies(std::vector<IntegratedBody>& bodies) const {
+            //Every body but a fixed center, after its primary : the sun for the planets, which does not feel them, the
+            //center of its subsystem for a satellite, which feels it unless fixed.
+            const uint32_t sun = (uint32_t)_center->get_id();
+            const double mu_sun = (double)G * _store->m[sun];
+            if (!_center_is_fixed && !_center->get_orbitalCenter()){
+                bodies.push_back({sun, IntegratedBody::NO_PRIMARY, 0.0, false});
+            }
+            for (auto& orbiter : _orbiters){bodies.push_back({(uint32_t)orbiter->get_id(), sun, mu_sun, false});}
+            for (auto& subsystem : _subsystems){
+                const uint32_t center = (uint32_t)subsystem->_center->get_id();
+                bool fixed = subsystem->_center_is_fixed;
+                if (!fixed){bodies.push_back({center, sun, mu_sun, false});}
+                for (auto& satellite : subsystem->_orbiters){
+                    double mass = (double)_store->m[center] + (fixed ? 0.0 : _store->m[satellite->get_id()]);
+                    bodies.push_back({(uint32_t)satellite->get_id(), center, (double)G * mass, !fixed});
+                }
+            }
+        }
+        void limit_center_steps(){
+            //The center of a subsystem is the main source of its satellites : its predicted position must stay
+            //accurate during their steps, so it is never coarser than them (a coarser Earth costs the Moon 10 to 40 times
+            //its position error for a few evaluations less).
+            for (const InteractionGroup& group : _groups){
+                if (group.system == this){continue;}
+                int finest = BlockTimesteps::COARSE_LEVELS;
+                for (uint32_t k = 0; k < group.count; k++){
+                    finest = std::min(finest, _blocks.get_exponent(_group_bodies[group.first + k]));
+                }
+                _blocks.set_max_exponent(group.system->_center->get_id(), finest);
+            }
+        }
+
+        void compile(){
+            //Walks the tree once after each change : the order of the terms of every body is the one of the tree walk,
+            //and so are the results.
+            if (_compiled){return;}
+            _reset.clear();
+            _interactions.clear();
+            _groups.clear();
+            _group_bodies.clear();
+            _moving.clear();
+            const BodyStore& s = *_store;
+            auto pair = [&](const CelestialBody* target, const CelestialBody* source){
+                _interactions.push_back({(uint32_t)target->get_id(), (uint32_t)source->get_id(), G * s.m[source->get_id()]});
+            };
+            auto group = [&](OrbitalSystem* system, const std::vector<CelestialBody*>& bodies){
+                if (bodies.empty()){return;}
+                _groups.push_back({system, (uint32_t)_group_bodies.size(), (uint32_t)bodies.size(),
+                                   (uint32_t)_interactions.size()});
+                for (CelestialBody* body : bodies){_group_bodies.push_back((uint32_t)body->get_id());}
+            };
+
+            if (_center && _center_is_fixed){_reset.push_back((uint32_t)_center->get_id());}
+            for (auto& orbiter : _orbiters){_reset.push_back((uint32_t)orbiter->get_id());}
+            for (auto& subsystem : _subsystems){
+                _reset.push_back((uint32_t)subsystem->_center->get_id());
+                for (auto& satellite : subsystem->_orbiters){_reset.push_back((uint32_t)satellite->get_id());}
+            }
+
+            //Sun on the planets, orbiters then centers of the subsystems, then the planets between them.
+            std::vector<CelestialBody*> planets(_orbiters);
+            for (auto& subsystem : _subsystems){planets.push_back(subsystem->_center);}
+            for (CelestialBody* planet : planets){pair(planet, _center);}
+            group(this, planets);
+            //Satellites : their center, the sun, and the pull of the satellites on a center which is not fixed, then
+            //the satellites between them.
+            for (auto& subsystem : _subsystems){
+                CelestialBody* center = subsystem->_center;
+                for (auto& satellite : subsystem->_orbiters){
+                    pair(satellite, center);
+                    pair(satellite, _center);
+                    if (!subsystem->_center_is_fixed){pair(center, satellite);}
+                }
+            }
+            for (auto& subsystem : _subsystems){group(subsystem.get(), subsystem->_orbiters);}
+
+            collect_verlet_bodies(_moving);
+            _source_ids.clear();
+            for_each_body([&](CelestialBody* body){
+                if (s.m[body->get_id()] > 0.0f){_source_ids.push_back((uint32_t)body->get_id());}
+            });
+            _colliders.clear();
+            _collider_radius.clear();
+            if (_collision_response != CollisionResponse::None){
+                std::vector<CelestialBody*> bodies;
+                std::vector<OrbitalSystem*> owners;
+                std::vector<uint8_t> fixed;
+                collect_colliders(bodies, owners, fixed);
+                _body_by_id.assign(s.size(), nullptr);
+                _owner_by_id.assign(s.size(), nullptr);
+                _fixed_by_id.assign(s.size(), 0);
+                for (std::size_t k = 0; k < bodies.size(); k++){
+                    uint32_t i = (uint32_t)bodies[k]->get_id();
+                    _colliders.push_back(i);
+                    _collider_radius.push_back(bodies[k]->get_radius());
+                    _body_by_id[i] = bodies[k];
+                    _owner_by_id[i] = owners[k];
+                    _fixed_by_id[i] = fixed[k];
+                }
+            }
+            _compiled = true;
+        }
+        void collect_colliders(std::vector<CelestialBody*>& bodies, std::vector<OrbitalSystem*>& owners,
+                               std::vector<uint8_t>& fixed){
+            if (_center){
+                bodies.push_back(_center);
+                owners.push_back(nullptr);
+                fixed.push_back(_center_is_fixed);
+            }
+            for (auto& orbiter : _orbiters){
+                bodies.push_back(orbiter);
+                owners.push_back(this);
+                fixed.push_back(0);
+            }
+            for (auto& subsystem : _subsystems){subsystem->collect_colliders(bodies, owners, fixed);}
+        }
+        void collect_verlet_bodies(std::vector<uint32_t>& bodies) const {
+            if (_center && !_center_is_fixed){bodies.push_back((uint32_t)_center->get_id());}
+            for (auto& orbiter : _orbiters){bodies.push_back((uint32_t)orbiter->get_id());}
+            for (auto& subsystem : _subsystems){subsystem->collect_verlet_bodies(bodies);}
+        }
+
+        //Accelerations of every body of the list, only of the bodies flagged in active (indexed by store id) if not
+        //null : the sources are always every body.
+        void run_interactions(const uint8_t* active){
+            using real = BodyStore::position_type;
+            BodyStore& s = *_store;
+            for (uint32_t i : _reset){
+                if (!active || active[i]){s.reset_acceleration(i);}
+            }
+            std::size_t p = 0;
+            auto run_pairs = [&](std::size_t end){
+                for (; p < end; p++){
+                    const Interaction& interaction = _interactions[p];
+                    uint32_t i = interaction.target, j = interaction.source;
+                    if (active && !active[i]){continue;}
+                    //Same operations as CelestialBody::compute_acceleration_from().
+                    real dx = s.x[j] - s.x[i];
+                    real dy = s.y[j] - s.y[i];
+                    real dz = s.z[j] - s.z[i];
+                    real norm = sqrt(dx * dx + dy * dy + dz * dz);
+                    double inv = (real)1 / (norm * norm * norm);
+                    real acceleration_magnitude = interaction.mu * inv;
+                    s.ax[i] += acceleration_magnitude * dx;
+                    s.ay[i] += acceleration_magnitude * dy;
+                    s.az[i] += acceleration_magnitude * dz;
+                }
+            };
+            for (const InteractionGroup& group : _groups){
+                run_pairs(group.end_pair);
+                group.system->accumulate_group(_group_bodies.data() + group.first, group.count, active);
+            }
+            run_pairs(_interactions.size());
+        }
+        void accumulate_group(const uint32_t* ids, std::size_t count, const uint8_t* active){
+            //Gather the bodies into the tile, run the kernel once per pair and scatter the accelerations back. With
+            //active, every body is a source and only the active ones get an acceleration.
+            if (!active){
+                gather(ids, count);
+                accumulate_tile();
+                for (size_t k = 0; k < count; k++){
+                    _store->add_acceleration(ids[k], {_tile.ax[k], _tile.ay[k], _tile.az[k]});
+                }
+                return;
+            }
+            _targets.clear();
+            for (size_t k = 0; k < count; k++){
+                if (active[ids[k]]){_targets.push_back((uint32_t)k);}
+            }
+            if (_targets.empty()){return;}
+            gather(ids, count);
+            accumulate_targets(_tile, _targets.data(), _targets.size(), _simd_level);
+            for (uint32_t k : _targets){
+                _store->add_acceleration(ids[k], {_tile.ax[k], _tile.ay[k], _tile.az[k]});
+            }
+        }
+
+        void resolve_collisions(){
+            //In order of contact : a body absorbed by a merge takes no part in the later collisions of the step.
+            _collisions.clear();
+            const std::vector<Collision>& found = _detector.detect(*_store, _colliders, _collider_radius);
+            if (found.empty()){return;}
+            //The velocities of the block timesteps are the ones of the last sync of each body.
+            if (_block_timesteps && _blocks_started){_blocks.predict_velocities(*_store);}
+            _absorbed.assign(_store->size(), 0);
+            bool merged = false;
+            for (Collision collision : found){
+                if (_absorbed[collision.first] || _absorbed[collision.second]){continue;}
+                //Two centers always bounce : each one keeps its system.
+                bool centers = !_owner_by_id[collision.first] && !_owner_by_id[collision.second];
+                if (_collision_response == CollisionResponse::Merge && !centers){
+                    merge_bodies(collision);
+                    merged = true;
+                }
+                else {bounce_bodies(collision);}
+                _collisions.push_back(collision);
+            }
+            _collision_count += _collisions.size();
+            //The integrators start again from the new positions and velocities (and masses).
+            _integrator.reset();
+            _blocks_started = false;
+            if (merged){invalidate();}
+        }
+        //Fixed center of any system of the tree (compiled with the colliders).
+        bool is_immovable(uint32_t i) const {
+            return i < _fixed_by_id.size() && _fixed_by_id[i];
+        }
+        BodyStore::vec_type velocity_of(uint32_t i) const {
+            //Verlet keeps no velocity : the one of the last step.
+            if (!_block_timesteps && _integrator.get_scheme() == IntegratorScheme::Verlet){
+                return (_store->get_pos(i) - _store->get_prev_pos(i)) / (BodyStore::position_type)dt;
+            }
+            return _store->get_velocity(i);
+        }
+        void set_motion(uint32_t i, const BodyStore::vec_type& position, const BodyStore::vec_type& velocity){
+            //For every integrator : the previous position of Verlet, the velocity of the others.
+            _store->set_pos(i, position);
+            _store->set_velocity(i, velocity);
+            BodyStore::vec_type previous = position - velocity * (BodyStore::position_type)dt;
+            _store->x_prev[i] = previous.x;
+            _store->y_prev[i] = previous.y;
+            _store->z_prev[i] = previous.z;
+        }
+        void merge_bodies(Collision& collision){
+            //The body which can't leave the tree (a center) survives, else the heavier one. The survivor takes the
+            //mass, the momentum, the center of mass and the volume of both.
+            using real = BodyStore::position_type;
+            uint32_t a = collision.first, b = collision.second;
+            const BodyStore& s = *_store;
+            if (_owner_by_id[a] && (!_owner_by_id[b] || s.m[b] > s.m[a])){std::swap(a, b);}
+            real ma = s.m[a], mb = s.m[b], total = ma + mb;
+            if (!is_immovable(a) && total > 0){
+                set_motion(a, (ma * s.get_pos(a) + mb * s.get_pos(b)) / total,
+                           (ma * velocity_of(a) + mb * velocity_of(b)) / total);
+            }
+            CelestialBody* survivor = _body_by_id[a];
+            CelestialBody* absorbed = _body_by_id[b];
+            float ra = survivor->get_radius(), rb = absorbed->get_radius();
+            survivor->set_mass((float)total);
+            survivor->set_radius(std::cbrt(ra * ra * ra + rb * rb * rb));
+            absorbed->set_mass(0.0f);
+            _owner_by_id[b]->remove_orbiter(absorbed);
+            _absorbed[b] = 1;
+            collision.first = a;
+            collision.second = b;
+            collision.merged = true;
+        }
+        void bounce_bodies(const Collision& collision){
+            //Impulse along the line of centers at the contact, then the rest of the step on straight lines with the
+            //new velocities. Bodies already overlapping are pushed apart first. A fixed center does not move.
+            using real = BodyStore::position_type;
+            uint32_t a = collision.first, b = collision.second;
+            const BodyStore& s = *_store;
+            BodyStore::vec_type pa = _detector.position_at(s, a, collision.time);
+            BodyStore::vec_type pb = _detector.position_at(s, b, collision.time);
+            BodyStore::vec_type va = velocity_of(a), vb = velocity_of(b);
+            real wa = is_immovable(a) || s.m[a] <= 0 ? 0 : 1 / (real)s.m[a];
+            real wb = is_immovable(b) || s.m[b] <= 0 ? 0 : 1 / (real)s.m[b];
+            if (wa + wb <= 0){wa = wb = 1;} //Massless bodies : equal shares
+            BodyStore::vec_type normal = pb - pa;
+            real distance = glm::length(normal);
+            normal = distance > 0 ? normal / distance : BodyStore::vec_type(1, 0, 0);
+
+            real approach = glm::dot(vb - va, normal);
+            if (approach < 0){
+                real impulse = -(1 + (real)_restitution) * approach / (wa + wb);
+                va -= impulse * wa * normal;
+                vb += impulse * wb * normal;
+            }
+            real overlap = (real)_body_by_id[a]->get_radius() + _body_by_id[b]->get_radius() - distance;
+            if (overlap > 0){
+                pa -= normal * (overlap * wa / (wa + wb));
+                pb += normal * (overlap * wb / (wa + wb));
+            }
+            real rest = (1 - (real)collision.time) * dt;
+            if (!is_immovable(a)){set_motion(a, pa + va * rest, va);}
+            if (!is_immovable(b)){set_motion(b, pb + vb * rest, vb);}
+        }
+
+        void share_store(std::shared_ptr<BodyStore> store){
+            if (_center){_center->attach(store.get());}
+            for (auto& orbiter : _orbiters){orbiter->attach(store.get());}
+            for (auto& subsystem : _subsystems){subsystem->share_store(store);}
+            _store = store;
+        }
+};
+
+
+#endif
\ No newline at end of file
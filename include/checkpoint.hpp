@@ -0,0 +1,468 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "mapped_file.hpp"
+
+//Binary checkpoint of the whole state of an OrbitalSystem tree : hierarchy, Verlet state (positions and previous
+//positions), velocities (at the captured time, also with block timesteps), masses, radii, test particles, integration
+//scheme and simulated time.
+//File layout, native byte order, every block starting on 64 bytes so that a mapped file is read in place :
+//  CheckpointHeader
+//  CheckpointSystem[system_count]   systems of the tree, a parent before its subsystems
+//  uint32_t[orbiter_count]          store ids of the orbiters of every system
+//  position_type[body_count] x 9    x, y, z, x_prev, y_prev, z_prev, vx, vy, vz (rows of the BodyStore)
+//  float[body_count] x 2            masses, radii
+//  position_type[particle_count] x 6  x, y, z, x_prev, y_prev, z_prev of the test particles (see test_particles.hpp)
+//A Checkpoint is an immutable image of that layout (in memory or mapped) : copies share it, a simulation restored from
+//it copies the arrays into its own store. Many branches can start from one captured state, and a writer thread can
+//save it while the simulation goes on.
+
+enum class CheckpointBlock : uint32_t {Systems, Orbiters, X, Y, Z, XPrev, YPrev, ZPrev, VX, VY, VZ, Mass, Radius,
+                                      ParticleX, ParticleY, ParticleZ, ParticleXPrev, ParticleYPrev, ParticleZPrev,
+                                      Count};
+
+struct alignas(64) CheckpointHeader {
+    char magic[8];            //"ORBCKPT"
+    uint32_t version;
+    uint32_t position_bytes;  //4 : SinglePrecision, 8 : MixedPrecision
+    uint64_t file_size;
+    uint64_t body_count;      //Rows of the store
+    uint64_t system_count;
+    uint64_t orbiter_count;
+    uint64_t particle_count;  //Test particles of the root system
+    double time;              //Simulated time, s
+    uint64_t steps;           //Steps done since the start
+    float dt;                 //Step of the run, the previous positions only hold for this step
+    uint32_t integrator;      //IntegratorScheme
+    uint32_t block_timesteps;
+    uint32_t reserved;
+    uint64_t offsets[(std::size_t)CheckpointBlock::Count]; //Bytes from the start of the file
+};
+
+struct CheckpointSystem {
+    uint32_t center;          //Store id
+    int32_t parent;           //Index of the parent system, -1 for the root
+    uint32_t first_orbiter;   //Index in the orbiter ids
+    uint32_t orbiter_count;
+    uint32_t center_fixed;
+    uint32_t force_backend;   //ForceBackend
+};
+
+static_assert(std::is_trivially_copyable<CheckpointHeader>::value, "CheckpointHeader is written as raw bytes");
+static_assert(std::is_trivially_copyable<CheckpointSystem>::value, "CheckpointSystem is written as raw bytes");
+
+//Tree rebuilt by Checkpoint::restore(), owning its bodies.
+struct RestoredSystem {
+    std::unique_ptr<OrbitalSystem> system;
+    std::vector<std::unique_ptr<CelestialBody>> bodies; //By store id of the checkpoint (null for a row without body)
+};
+
+class Checkpoint {
+    public:
+        static constexpr uint32_t VERSION = 2;
+        static constexpr std::size_t ALIGNMENT = 64;
+        using real = BodyStore::position_type;
+
+        Checkpoint() = default;
+
+        //State of the tree of system (a root system) after steps steps, at the simulated time. Only copies : to be
+        //called from the thread stepping the system, between two steps (PhysicsThread::request_checkpoint()).
+        static Checkpoint capture(OrbitalSystem& system, double time = 0.0, uint64_t steps = 0){
+            if (!system.get_center()){throw std::invalid_argument("ERROR::CHECKPOINT::SYSTEM_WITHOUT_CENTER");}
+            std::vector<CheckpointSystem> systems;
+            std::vector<uint32_t> orbiters;
+            collect(system, -1, systems, orbiters);
+            const BodyStore& store = system.get_store();
+            std::size_t n = store.size();
+
+            Checkpoint checkpoint;
+            const TestParticles& particles = system.get_test_particles();
+            CheckpointHeader header = make_header(n, systems.size(), orbiters.size(), particles.size());
+            header.time = time;
+            header.steps = steps;
+            header.integrator = (uint32_t)system.get_integrator().get_scheme();
+            header.block_timesteps = system.uses_block_timesteps() ? 1 : 0;
+            auto buffer = std::make_shared<aligned_vector<unsigned char>>(header.file_size, 0);
+            unsigned char* data = buffer->data();
+            std::memcpy(data, &header, sizeof(header));
+            copy_block(data, header, CheckpointBlock::Systems, systems.data(), systems.size());
+            copy_block(data, header, CheckpointBlock::Orbiters, orbiters.data(), orbiters.size());
+            const aligned_vector<real>* arrays[9] = {&store.x, &store.y, &store.z, &store.x_prev, &store.y_prev,
+                                                     &store.z_prev, &store.vx, &store.vy, &store.vz};
+            for (int k = 0; k < 9; k++){
+                copy_block(data, header, (CheckpointBlock)((uint32_t)CheckpointBlock::X + k), arrays[k]->data(), n);
+            }
+            //Block timesteps : the velocities of the image are predicted at the captured time, the ones of the
+            //bodies between two syncs are older in the store. The restored run starts all bodies synchronized.
+            auto velocity = [&](CheckpointBlock which){
+                return reinterpret_cast<real*>(data + header.offsets[(std::size_t)which]);
+            };
+            system.predict_velocities(velocity(CheckpointBlock::VX), velocity(CheckpointBlock::VY),
+                                      velocity(CheckpointBlock::VZ));
+            copy_block(data, header, CheckpointBlock::Mass, store.m.data(), n);
+            float* radius = reinterpret_cast<float*>(data + header.offsets[(std::size_t)CheckpointBlock::Radius]);
+            system.for_each_body([&](CelestialBody* body){radius[body->get_id()] = body->get_radius();});
+            const aligned_vector<real>* particle_arrays[6] = {&particles.x, &particles.y, &particles.z,
+                                                              &particles.x_prev, &particles.y_prev, &particles.z_prev};
+            for (int k = 0; k < 6; k++){
+                copy_block(data, header, (CheckpointBlock)((uint32_t)CheckpointBlock::ParticleX + k),
+                           particle_arrays[k]->data(), particles.size());
+            }
+
+            checkpoint._data = std::shared_ptr<const unsigned char>(buffer, data);
+            checkpoint._size = header.file_size;
+            return checkpoint;
+        }
+
+        //Maps the file read only : nothing is read before the arrays are used. Throws std::runtime_error if the file
+        //can't be mapped, std::invalid_argument if it is not a checkpoint of this version and precision.
+        static Checkpoint open(const std::string& path){
+            Checkpoint checkpoint;
+            checkpoint._data = map_file(path, checkpoint._size);
+            checkpoint.validate();
+            return checkpoint;
+        }
+
+        //Writes the image to path.tmp then renames it : an interrupted write never leaves a truncated checkpoint.
+        void save(const std::string& path) const {
+            if (empty()){throw std::invalid_argument("ERROR::CHECKPOINT::EMPTY");}
+            std::string temporary = path + ".tmp";
+            std::FILE* file = std::fopen(temporary.c_str(), "wb");
+            if (!file){throw std::runtime_error("ERROR::CHECKPOINT::FILE_NOT_OPENED " + temporary);}
+            bool written = std::fwrite(_data.get(), 1, _size, file) == _size;
+            written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+            if (written){std::remove(path.c_str());} //rename does not replace an existing file on Windows
+#endif
+            if (!written || std::rename(temporary.c_str(), path.c_str()) != 0){
+                std::remove(temporary.c_str());
+                throw std::runtime_error("ERROR::CHECKPOINT::WRITE_FAILED " + path);
+            }
+        }
+
+        bool empty() const {
+            return !_data;
+        }
+        const CheckpointHeader& get_header() const {
+            return *reinterpret_cast<const CheckpointHeader*>(_data.get());
+        }
+        std::size_t size() const {
+            return (std::size_t)get_header().body_count;
+        }
+        std::size_t get_particle_count() const {
+            return (std::size_t)get_header().particle_count;
+        }
+        double get_time() const {
+            return get_header().time;
+        }
+        uint64_t get_steps() const {
+            return get_header().steps;
+        }
+        const CheckpointSystem* get_systems() const {
+            return block<CheckpointSystem>(CheckpointBlock::Systems);
+        }
+        const uint32_t* get_orbiters() const {
+            return block<uint32_t>(CheckpointBlock::Orbiters);
+        }
+        //One of the position or velocity arrays (CheckpointBlock::X to CheckpointBlock::VZ), by store id, or of the
+        //test particle arrays (CheckpointBlock::ParticleX to CheckpointBlock::ParticleZPrev), by particle index.
+        const real* get_array(CheckpointBlock array) const {
+            return block<real>(array);
+        }
+        const float* get_masses() const {
+            return block<float>(CheckpointBlock::Mass);
+        }
+        const float* get_radii() const {
+            return block<float>(CheckpointBlock::Radius);
+        }
+
+        //Copies the state into system, a tree built the same way as the captured one (same bodies in the same
+        //order, e.g. the same scene setup) : no allocation but for the test particles, which replace those of system.
+        //The integration scheme of the checkpoint is restored with it, since the state of one scheme is not the state
+        //of another (previous positions for Verlet, velocities for the others). Throws std::invalid_argument if the
+        //trees differ.
+        void load(OrbitalSystem& system) const {
+            if (empty()){throw std::invalid_argument("ERROR::CHECKPOINT::EMPTY");}
+            if (!system.get_center()){throw std::invalid_argument("ERROR::CHECKPOINT::TREE_MISMATCH");}
+            const CheckpointHeader& header = get_header();
+            std::vector<CheckpointSystem> systems;
+            std::vector<uint32_t> orbiters;
+            collect(system, -1, systems, orbiters);
+            BodyStore& store = system.get_store();
+            bool same = store.size() == header.body_count && systems.size() == header.system_count
+                     && orbiters.size() == header.orbiter_count
+                     && std::memcmp(orbiters.data(), get_orbiters(), orbiters.size() * sizeof(uint32_t)) == 0;
+            for (std::size_t k = 0; same && k < systems.size(); k++){
+                const CheckpointSystem& saved = get_systems()[k];
+                same = systems[k].center == saved.center && systems[k].parent == saved.parent
+                    && systems[k].orbiter_count == saved.orbiter_count;
+            }
+            if (!same){throw std::invalid_argument("ERROR::CHECKPOINT::TREE_MISMATCH");}
+
+            std::size_t n = store.size();
+            aligned_vector<real>* arrays[9] = {&store.x, &store.y, &store.z, &store.x_prev, &store.y_prev,
+                                               &store.z_prev, &store.vx, &store.vy, &store.vz};
+            for (int k = 0; k < 9; k++){
+                const real* saved = get_array((CheckpointBlock)((uint32_t)CheckpointBlock::X + k));
+                std::memcpy(arrays[k]->data(), saved, n * sizeof(real));
+            }
+            std::memcpy(store.m.data(), get_masses(), n * sizeof(float));
+            load_particles(system.get_test_particles());
+            system.invalidate(); //The interaction list keeps G * m
+            restore_integration(system);
+        }
+
+        //Rebuilds the tree of the checkpoint with new CelestialBody : centers, orbiters, subsystems, fixed centers
+        //and force backends, then its state. The bodies get new store ids, bodies[id] is the body of the captured
+        //store id.
+        RestoredSystem restore() const {
+            if (empty()){throw std::invalid_argument("ERROR::CHECKPOINT::EMPTY");}
+            const CheckpointHeader& header = get_header();
+            const CheckpointSystem* systems = get_systems();
+            const uint32_t* orbiters = get_orbiters();
+            const float* masses = get_masses();
+            const float* radii = get_radii();
+            std::size_t n = size();
+
+            RestoredSystem restored;
+            restored.system = std::make_unique<OrbitalSystem>();
+            restored.system->reserve_bodies(n);
+            restored.bodies.resize(n);
+            auto make_body = [&](uint32_t id, OrbitalSystem* orbitalSystem){
+                if (id >= n || restored.bodies[id]){throw std::invalid_argument("ERROR::CHECKPOINT::INVALID_TREE");}
+                restored.bodies[id] = std::make_unique<CelestialBody>(std::vector<float>{0.0f, 0.0f, 0.0f},
+                                                                      std::vector<float>{0.0f, 0.0f, 0.0f},
+                                                                      radii[id], masses[id], orbitalSystem);
+                return restored.bodies[id].get();
+            };
+
+            std::vector<OrbitalSystem*> built(header.system_count, nullptr);
+            for (std::size_t k = 0; k < header.system_count; k++){
+                const CheckpointSystem& record = systems[k];
+                if (record.parent >= (int32_t)k || (k > 0) != (record.parent >= 0)
+                    || (uint64_t)record.first_orbiter + record.orbiter_count > header.orbiter_count){
+                    throw std::invalid_argument("ERROR::CHECKPOINT::INVALID_TREE");
+                }
+                std::shared_ptr<OrbitalSystem> subsystem;
+                OrbitalSystem* parent = record.parent >= 0 ? built[record.parent] : nullptr;
+                OrbitalSystem* system = restored.system.get();
+                if (parent){
+                    subsystem = std::make_shared<OrbitalSystem>();
+                    system = subsystem.get();
+                }
+                //The center of a subsystem is a body of its parent, orbiting the center of the parent.
+                CelestialBody* center = make_body(record.center, parent);
+                if (parent){center->set_orbitalCenter(parent->get_center());}
+                system->define_center(center);
+                system->fix_center(record.center_fixed != 0);
+                system->set_force_backend((ForceBackend)record.force_backend);
+                for (uint32_t o = 0; o < record.orbiter_count; o++){
+                    system->add_orbiters(make_body(orbiters[record.first_orbiter + o], system));
+                }
+                if (parent){parent->add_subsystem(subsystem);}
+                built[k] = system;
+            }
+
+            //State of the captured rows, scattered to the new store ids.
+            BodyStore& store = restored.system->get_store();
+            const real* saved[9];
+            aligned_vector<real>* arrays[9] = {&store.x, &store.y, &store.z, &store.x_prev, &store.y_prev,
+                                               &store.z_prev, &store.vx, &store.vy, &store.vz};
+            for (int k = 0; k < 9; k++){saved[k] = get_array((CheckpointBlock)((uint32_t)CheckpointBlock::X + k));}
+            for (std::size_t i = 0; i < n; i++){
+                if (!restored.bodies[i]){continue;}
+                std::size_t id = restored.bodies[i]->get_id();
+                for (int k = 0; k < 9; k++){(*arrays[k])[id] = saved[k][i];}
+            }
+            load_particles(restored.system->get_test_particles());
+            restore_integration(*restored.system);
+            return restored;
+        }
+
+    private:
+        std::shared_ptr<const unsigned char> _data; //Shared and never modified once built
+        std::size_t _size = 0;
+
+        template <typename T>
+        const T* block(CheckpointBlock which) const {
+            return reinterpret_cast<const T*>(_data.get() + get_header().offsets[(std::size_t)which]);
+        }
+
+        static std::size_t align(std::size_t bytes){
+            return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+        static std::size_t block_bytes(CheckpointBlock which, std::size_t bodies, std::size_t systems,
+                                       std::size_t orbiters, std::size_t particles){
+            switch (which){
+                case CheckpointBlock::Systems: return systems * sizeof(CheckpointSystem);
+                case CheckpointBlock::Orbiters: return orbiters * sizeof(uint32_t);
+                case CheckpointBlock::Mass:
+                case CheckpointBlock::Radius: return bodies * sizeof(float);
+                default: break;
+            }
+            return (which >= CheckpointBlock::ParticleX ? particles : bodies) * sizeof(real);
+        }
+        static CheckpointHeader make_header(std::size_t bodies, std::size_t systems, std::size_t orbiters,
+                                            std::size_t particles){
+            CheckpointHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, "ORBCKPT", 8);
+            header.version = VERSION;
+            header.position_bytes = sizeof(real);
+            header.body_count = bodies;
+            header.system_count = systems;
+            header.orbiter_count = orbiters;
+            header.particle_count = particles;
+            header.dt = dt;
+            std::size_t offset = align(sizeof(CheckpointHeader));
+            for (std::size_t k = 0; k < (std::size_t)CheckpointBlock::Count; k++){
+                header.offsets[k] = offset;
+                offset += align(block_bytes((CheckpointBlock)k, bodies, systems, orbiters, particles));
+            }
+            header.file_size = offset;
+            return header;
+        }
+        template <typename T>
+        static void copy_block(unsigned char* data, const CheckpointHeader& header, CheckpointBlock which,
+                               const T* source, std::size_t count){
+            if (count > 0){std::memcpy(data + header.offsets[(std::size_t)which], source, count * sizeof(T));}
+        }
+
+        //Systems of the tree in the order of the file, parent first.
+        static void collect(OrbitalSystem& system, int32_t parent, std::vector<CheckpointSystem>& systems,
+                            std::vector<uint32_t>& orbiters){
+            CheckpointSystem record;
+            record.center = (uint32_t)system.get_center()->get_id();
+            record.parent = parent;
+            record.first_orbiter = (uint32_t)orbiters.size();
+            for (CelestialBody* orbiter : system.get_orbiters()){orbiters.push_back((uint32_t)orbiter->get_id());}
+            record.orbiter_count = (uint32_t)orbiters.size() - record.first_orbiter;
+            record.center_fixed = system.is_center_fixed() ? 1 : 0;
+            record.force_backend = (uint32_t)system.get_force_backend();
+            int32_t index = (int32_t)systems.size();
+            systems.push_back(record);
+            for (auto& subsystem : system.get_subsystems()){collect(*subsystem, index, systems, orbiters);}
+        }
+
+        void load_particles(TestParticles& particles) const {
+            std::size_t n = get_particle_count();
+            aligned_vector<real>* arrays[6] = {&particles.x, &particles.y, &particles.z, &particles.x_prev,
+                                               &particles.y_prev, &particles.z_prev};
+            for (int k = 0; k < 6; k++){
+                const real* saved = get_array((CheckpointBlock)((uint32_t)CheckpointBlock::ParticleX + k));
+                arrays[k]->assign(saved, saved + n);
+            }
+        }
+
+        void restore_integration(OrbitalSystem& system) const {
+            //Accelerations are not saved : the next step computes them again from the positions (the integrators
+            //restart from the restored state).
+            const CheckpointHeader& header = get_header();
+            system.set_integrator((IntegratorScheme)header.integrator);
+            system.set_block_timesteps(header.block_timesteps != 0);
+        }
+
+        void validate() const {
+            const CheckpointHeader* header = reinterpret_cast<const CheckpointHeader*>(_data.get());
+            if (_size < sizeof(CheckpointHeader) || std::memcmp(header->magic, "ORBCKPT", 8) != 0){
+                throw std::invalid_argument("ERROR::CHECKPOINT::NOT_A_CHECKPOINT");
+            }
+            if (header->version != VERSION){throw std::invalid_argument("ERROR::CHECKPOINT::UNSUPPORTED_VERSION");}
+            if (header->position_bytes != sizeof(real)){throw std::invalid_argument("ERROR::CHECKPOINT::PRECISION_MISMATCH");}
+            if (header->dt != dt){throw std::invalid_argument("ERROR::CHECKPOINT::TIMESTEP_MISMATCH");}
+            CheckpointHeader expected = make_header(header->body_count, header->system_count, header->orbiter_count,
+                                                    header->particle_count);
+            if (header->file_size != expected.file_size || _size < header->file_size
+                || std::memcmp(header->offsets, expected.offsets, sizeof(expected.offsets)) != 0
+                || header->system_count == 0){
+                throw std::invalid_argument("ERROR::CHECKPOINT::TRUNCATED");
+            }
+        }
+};
+
+//Saves checkpoints on a background thread, in the order they were given : the simulation only pays for the capture.
+class CheckpointWriter {
+    public:
+        CheckpointWriter() = default;
+        ~CheckpointWriter(){
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+            if (_thread.joinable()){_thread.join();}
+        }
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        void write(Checkpoint checkpoint, const std::string& path){
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queue.emplace_back(std::move(checkpoint), path);
+                if (!_thread.joinable()){_thread = std::thread([this](){run();});}
+            }
+            _wake.notify_all();
+        }
+        //Blocks until every given checkpoint is on disk.
+        void wait(){
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle.wait(lock, [this](){return _queue.empty() && !_busy;});
+        }
+        //Checkpoints successfully saved.
+        std::size_t get_written() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _written;
+        }
+
+    private:
+        mutable std::mutex _mutex;
+        std::condition_variable _wake, _idle;
+        std::deque<std::pair<Checkpoint, std::string>> _queue;
+        bool _busy = false;
+        bool _stopping = false;
+        std::size_t _written = 0;
+        std::thread _thread;
+
+        void run(){
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true){
+                _wake.wait(lock, [this](){return _stopping || !_queue.empty();});
+                if (_queue.empty()){return;} //Stopping once everything is written
+                auto job = std::move(_queue.front());
+                _queue.pop_front();
+                _busy = true;
+                lock.unlock();
+                bool saved = true;
+                try {
+                    job.first.save(job.second);
+                }
+                catch (const std::exception& e){
+                    std::cout << e.what() << std::endl;
+                    saved = false;
+                }
+                lock.lock();
+                _busy = false;
+                if (saved){_written++;}
+                _idle.notify_all();
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef COLLISION_HPP
+#define COLLISION_HPP
+
+#include "body_store.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//What happens to two bodies which touch. None lets them pass through each other (the 1 / r^3 of the gravity then
+//blows up at small distances), Merge makes one body of them (mass, momentum and volume kept), Bounce reflects their
+//relative velocity along the line of centers with a coefficient of restitution.
+enum class CollisionResponse {None, Merge, Bounce};
+
+//Two bodies touching during the last step, by store id. time is the fraction of the step at the contact (0 : they
+//already overlapped at the start of the step). With Merge, second was absorbed by first.
+struct Collision {
+    uint32_t first;
+    uint32_t second;
+    float time;
+    bool merged = false;
+};
+
+//Collisions of spheres moving on straight lines during a step, between the positions saved by start() and the
+//positions of the store.
+//
+//A step of 6 h moves an asteroid by ~4e8 m, 10^4 times its radius : bodies tested at the end of the step only would
+//pass through each other. Each body is therefore a swept sphere, and the broad phase works on the boxes of the swept
+//spheres (start and end positions, grown by the radius).
+//Broad phase : spatial hash. The cells are cubes of twice the median size of the boxes, a box smaller than a cell
+//touches at most 2 cells per axis and is entered in each of them as a (cell key, body) entry. The entries are sorted,
+//the bodies sharing a cell are compared by their boxes, and a pair overlapping in several cells is only kept in the cell
+//of the lower corner of the overlap. The few boxes larger than a cell (sun, fast inner planets) are compared to every
+//body. The cost is the sort of the entries plus the bodies per cell : near-linear, a belt of 100k bodies has less than
+//one body per cell (a sweep and prune along one axis compares every body to a whole strip of the belt).
+//The cells are split in chunks of CELL_CHUNK entries, run on the thread pool into their own lists, which are
+//concatenated in chunk order : the result does not depend on the thread count.
+//Narrow phase : exact test of the two swept spheres, first time t in [0, 1] where |d0 + (d1 - d0) t| = r1 + r2
+//with d the offset between the bodies (relative motion on a straight line).
+class CollisionDetector {
+    public:
+        static constexpr std::size_t CELL_CHUNK = 4096;
+        static constexpr int KEY_BITS = 21; //Per axis in a 64 bits cell key
+
+        //Positions at the start of the step of the bodies ids (store ids).
+        void start(const BodyStore& store, const std::vector<uint32_t>& ids){
+            std::size_t n = ids.size();
+            _x0.resize(n);
+            _y0.resize(n);
+            _z0.resize(n);
+            _slot.assign(store.size(), UINT32_MAX);
+            for (std::size_t k = 0; k < n; k++){
+                uint32_t i = ids[k];
+                _x0[k] = store.x[i]; _y0[k] = store.y[i]; _z0[k] = store.z[i];
+                _slot[i] = (uint32_t)k;
+            }
+        }
+
+        //Pairs of the bodies (same list as start(), radius[k] for ids[k]) touching between start() and now, sorted
+        //by time of contact then by ids. Nothing without a start() with this list.
+        const std::vector<Collision>& detect(const BodyStore& store, const std::vector<uint32_t>& ids,
+                                             const std::vector<float>& radius, ThreadPool& pool = ThreadPool::instance()){
+            _collisions.clear();
+            std::size_t n = ids.size();
+            if (_x0.size() != n || _slot.size() != store.size()){return _collisions;}
+            build_boxes(store, ids, radius);
+            build_cells();
+
+            std::size_t chunks = _chunk_start.size() - 1;
+            if (_found.size() < chunks + _large.size()){_found.resize(chunks + _large.size());}
+            pool.run(chunks + _large.size(), [&](std::size_t task){
+                std::vector<Collision>& found = _found[task];
+                found.clear();
+                auto test = [&](uint32_t a, uint32_t b){
+                    float time;
+                    if (swept_contact(store, ids, radius, a, b, time)){
+                        uint32_t i = ids[a], j = ids[b];
+                        found.push_back({std::min(i, j), std::max(i, j), time});
+                    }
+                };
+                if (task >= chunks){
+                    //A large box against every other body (against the next large ones only).
+                    std::size_t l = task - chunks;
+                    uint32_t a = _large[l];
+                    for (uint32_t b = 0; b < n; b++){
+                        if (b == a || (_is_large[b] && _large_rank[b] <= l)){continue;}
+                        if (overlap(_boxes[a], _boxes[b])){test(a, b);}
+                    }
+                    return;
+                }
+                for (std::size_t p = _chunk_start[task]; p < _chunk_start[task + 1];){
+                    std::size_t end = p + 1;
+                    while (end < _entries.size() && _entries[end].key == _entries[p].key){end++;}
+                    for (std::size_t u = p; u < end; u++){
+                        for (std::size_t v = u + 1; v < end; v++){
+                            uint32_t a = _entries[u].body, b = _entries[v].body;
+                            if (overlap(_boxes[a], _boxes[b]) && overlap_cell(a, b) == _entries[p].key){test(a, b);}
+                        }
+                    }
+                    p = end;
+                }
+            });
+            for (std::size_t task = 0; task < chunks + _large.size(); task++){
+                _collisions.insert(_collisions.end(), _found[task].begin(), _found[task].end());
+            }
+            std::sort(_collisions.begin(), _collisions.end(), [](const Collision& a, const Collision& b){
+                if (a.time != b.time){return a.time < b.time;}
+                return a.first != b.first ? a.first < b.first : a.second < b.second;
+            });
+            return _collisions;
+        }
+
+        //Position of the body id (of the list) at the fraction time of the step, on the straight line of detect().
+        BodyStore::vec_type position_at(const BodyStore& store, uint32_t id, float time) const {
+            uint32_t k = _slot[id];
+            BodyStore::vec_type p0(_x0[k], _y0[k], _z0[k]);
+            return p0 + (store.get_pos(id) - p0) * (BodyStore::position_type)time;
+        }
+
+    private:
+        using real = BodyStore::position_type;
+
+        struct Box {
+            real lo[3];
+            real hi[3];
+        };
+        struct Entry {
+            uint64_t key;  //Cell
+            uint32_t body; //Index in the list
+        };
+
+        aligned_vector<real> _x0, _y0, _z0; //Start of the step, by index in the list
+        std::vector<uint32_t> _slot;        //Index in the list by store id
+        std::vector<Box> _boxes;
+        real _origin[3] = {0, 0, 0};
+        real _cell = 1;
+        std::vector<Entry> _entries;        //Sorted by cell
+        std::vector<std::size_t> _chunk_start; //First entry of each chunk (on a cell boundary), then the end
+        std::vector<uint32_t> _large;       //Bodies whose box is larger than a cell
+        std::vector<uint8_t> _is_large;
+        std::vector<uint32_t> _large_rank;  //Index in _large
+        std::vector<std::vector<Collision>> _found; //By task
+        std::vector<Collision> _collisions;
+
+        void build_boxes(const BodyStore& store, const std::vector<uint32_t>& ids, const std::vector<float>& radius){
+            std::size_t n = ids.size();
+            _boxes.resize(n);
+            for (int a = 0; a < 3; a++){_origin[a] = INFINITY;}
+            real hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+            std::vector<real> sizes(n);
+            for (std::size_t k = 0; k < n; k++){
+                uint32_t i = ids[k];
+                real start[3] = {_x0[k], _y0[k], _z0[k]};
+                real end[3] = {store.x[i], store.y[i], store.z[i]};
+                Box& box = _boxes[k];
+                sizes[k] = 0;
+                for (int a = 0; a < 3; a++){
+                    box.lo[a] = std::min(start[a], end[a]) - radius[k];
+                    box.hi[a] = std::max(start[a], end[a]) + radius[k];
+                    sizes[k] = std::max(sizes[k], box.hi[a] - box.lo[a]);
+                    _origin[a] = std::min(_origin[a], box.lo[a]);
+                    hi[a] = std::max(hi[a], box.hi[a]);
+                }
+            }
+            //Twice the median box, not so small that the cells of the system overflow the keys.
+            _cell = 1;
+            if (n > 0){
+                std::nth_element(sizes.begin(), sizes.begin() + n / 2, sizes.end());
+                _cell = 2 * sizes[n / 2];
+                for (int a = 0; a < 3; a++){_cell = std::max(_cell, (hi[a] - _origin[a]) / (real)((1 << KEY_BITS) - 2));}
+                if (!(_cell > 0)){_cell = 1;}
+            }
+        }
+        uint64_t cell_of(int axis, real coordinate) const {
+            return (uint64_t)((coordinate - _origin[axis]) / _cell);
+        }
+        static uint64_t key_of(uint64_t cx, uint64_t cy, uint64_t cz){
+            return (cx << (2 * KEY_BITS)) | (cy << KEY_BITS) | cz;
+        }
+        //Cell of the lower corner of the overlap of two boxes.
+        uint64_t overlap_cell(uint32_t a, uint32_t b) const {
+            uint64_t c[3];
+            for (int k = 0; k < 3; k++){c[k] = cell_of(k, std::max(_boxes[a].lo[k], _boxes[b].lo[k]));}
+            return key_of(c[0], c[1], c[2]);
+        }
+        void build_cells(){
+            std::size_t n = _boxes.size();
+            _entries.clear();
+            _large.clear();
+            _is_large.assign(n, 0);
+            _large_rank.assign(n, 0);
+            for (uint32_t k = 0; k < n; k++){
+                const Box& box = _boxes[k];
+                uint64_t lo[3], hi[3];
+                for (int a = 0; a < 3; a++){
+                    lo[a] = cell_of(a, box.lo[a]);
+                    hi[a] = cell_of(a, box.hi[a]);
+                }
+                if (hi[0] - lo[0] > 1 || hi[1] - lo[1] > 1 || hi[2] - lo[2] > 1){
+                    _is_large[k] = 1;
+                    _large_rank[k] = (uint32_t)_large.size();
+                    _large.push_back(k);
+                    continue;
+                }
+                for (uint64_t cx = lo[0]; cx <= hi[0]; cx++){
+                    for (uint64_t cy = lo[1]; cy <= hi[1]; cy++){
+                        for (uint64_t cz = lo[2]; cz <= hi[2]; cz++){_entries.push_back({key_of(cx, cy, cz), k});}
+                    }
+                }
+            }
+            std::sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b){
+                return a.key != b.key ? a.key < b.key : a.body < b.body;
+            });
+            //Chunks of about CELL_CHUNK entries, never cutting a cell.
+            _chunk_start.assign(1, 0);
+            std::size_t p = 0;
+            while (p < _entries.size()){
+                p = std::min(_entries.size(), p + CELL_CHUNK);
+                while (p < _entries.size() && _entries[p].key == _entries[p - 1].key){p++;}
+                _chunk_start.push_back(p);
+            }
+            if (_chunk_start.size() == 1){_chunk_start.push_back(0);}
+        }
+        static bool overlap(const Box& a, const Box& b){
+            for (int k = 0; k < 3; k++){
+                if (a.lo[k] > b.hi[k] || b.lo[k] > a.hi[k]){return false;}
+            }
+            return true;
+        }
+        bool swept_contact(const BodyStore& store, const std::vector<uint32_t>& ids, const std::vector<float>& radius,
+                           uint32_t a, uint32_t b, float& time) const {
+            uint32_t i = ids[a], j = ids[b];
+            //Offset of b from a at the start (d0) and its change over the step (e).
+            real d0[3] = {_x0[b] - _x0[a], _y0[b] - _y0[a], _z0[b] - _z0[a]};
+            real e[3] = {(store.x[j] - store.x[i]) - d0[0], (store.y[j] - store.y[i]) - d0[1],
+                         (store.z[j] - store.z[i]) - d0[2]};
+            double contact = (double)radius[a] + radius[b];
+            double qa = 0.0, qb = 0.0, qc = -contact * contact;
+            for (int k = 0; k < 3; k++){
+                qa += (double)e[k] * e[k];
+                qb += 2.0 * (double)d0[k] * e[k];
+                qc += (double)d0[k] * d0[k];
+            }
+            if (qc <= 0.0){
+                time = 0.0f;
+                return true;
+            }
+            //Still apart at the start : first root of qa t^2 + qb t + qc, if the bodies get closer.
+            if (qa <= 0.0 || qb >= 0.0){return false;}
+            double discriminant = qb * qb - 4.0 * qa * qc;
+            if (discriminant < 0.0){return false;}
+            double t = (-qb - std::sqrt(discriminant)) / (2.0 * qa);
+            if (t > 1.0){return false;}
+            time = (float)std::max(0.0, t);
+            return true;
+        }
+};
+
+#endif
@@ -3,11 +3,12 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#include "shader.h"
+#include "shader_registry.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -24,7 +25,7 @@ class Cube{
         _cube_vertices(std::move(other._cube_vertices)), _VAO(other._VAO), _VBO(other._VBO), 
         _hasTexture(other._hasTexture), _hasDualTexture(other._hasDualTexture), 
         _textureDiffuse(other._textureDiffuse), _textureSpecular(other._textureSpecular),
-        _shader(std::move(other._shader)), _color(other._color), _material(other._material),
+        _shader(std::move(other._shader)), _uniforms(other._uniforms), _color(other._color), _material(other._material),
         _renderMode(other._renderMode), _scale(other._scale), _center(other._center), _rotation(other._rotation),
         _rotationAxis(other._rotationAxis), _model(other._model), _modeldirty(other._modeldirty){
             other._VAO = 0;
@@ -50,6 +51,7 @@ class Cube{
             _textureDiffuse = other._textureDiffuse;
             _textureSpecular = other._textureSpecular;
             _shader = std::move(other._shader);
+            _uniforms = other._uniforms;
             _color = other._color;
             _material = other._material;
             _renderMode = other._renderMode;
@@ -87,41 +89,26 @@ class Cube{
         }
     };
 
-    void render(const glm::mat4& view, const glm::mat4& projection, 
-                const glm::vec3& lightPos, const glm::vec3& cameraPos,
-                const glm::vec3& cameraFront){
-        _shader.use();
-        _shader.setMat4("model", get_model());
-        _shader.setMat4("view",view);
-        _shader.setMat4("projection", projection);
+    //The view, projection and light come from the Camera and Light blocks (see uniform_buffer.hpp), updated once per
+    //frame : only the model and the material are set per cube.
+    void render(){
+        _shader->use();
+        _shader->set(_uniforms.model, get_model());
         if (_renderMode == RenderMode::Color){
-            _shader.setVec3("objectColor", _color);
+            _shader->set(_uniforms.objectColor, _color);
         }
         else if (_renderMode == RenderMode::Material){
-            _shader.setVec3("material.ambient", _material.ambient);
-            _shader.setVec3("material.diffuse", _material.diffuse);
-            _shader.setVec3("material.specular", _material.specular);
-            _shader.setFloat("material.shininess",_material.shininess);
-
-            _shader.setVec3("viewPos", cameraPos);
-            _shader.setVec3("light.position", lightPos);
-            _shader.setVec3("light.ambient", glm::vec3(0.2f));
-            _shader.setVec3("light.diffuse", glm::vec3(0.5f));
-            _shader.setVec3("light.specular", glm::vec3(1.0f));
+            _shader->set(_uniforms.materialAmbient, _material.ambient);
+            _shader->set(_uniforms.materialDiffuse, _material.diffuse);
+            _shader->set(_uniforms.materialSpecular, _material.specular);
+            _shader->set(_uniforms.materialShininess, _material.shininess);
         }
         else if (_renderMode == RenderMode::Texture){
-            _shader.setVec3("viewPos", cameraPos);
-            _shader.setVec3("light.position", lightPos);
-            _shader.setVec3("light.direction",cameraFront); // cameraFront for flashlight, lightPos otherwise
-            _shader.setVec3("light.ambient", glm::vec3(0.1f));
-            _shader.setVec3("light.diffuse", glm::vec3(1.0f));
-            _shader.setVec3("light.specular", glm::vec3(1.0f));
-            _shader.setFloat("material.shininess", 64.0f);
-
+            _shader->set(_uniforms.materialShininess, 64.0f);
 
             if(_hasDualTexture){
-                _shader.setInt("material.diffuse", 0);
-                _shader.setInt("material.specular",1);
+                _shader->set(_uniforms.diffuseUnit, 0);
+                _shader->set(_uniforms.specularUnit, 1);
 
                 glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, _textureDiffuse);
@@ -129,8 +116,8 @@ class Cube{
                 glBindTexture(GL_TEXTURE_2D, _textureSpecular);
             }
             else{
-                _shader.setInt("material.diffuse",0);
-                _shader.setInt("material.specular",0);
+                _shader->set(_uniforms.diffuseUnit, 0);
+                _shader->set(_uniforms.specularUnit, 0);
 
                 glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, _textureDiffuse);
@@ -140,13 +127,6 @@ class Cube{
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
 
-    void set_light_attenuation(float constant, float linear, float quadratic){
-        _shader.use();
-        _shader.setFloat("light.constant",constant);
-        _shader.setFloat("light.linear", linear);
-        _shader.setFloat("light.quadratic", quadratic);
-    }
-
     static Cube withColor(glm::vec3 center, glm::vec3 color,
                           const std::string& vertexShader = "../shaders/cube_shader/basic_cube/cube.vs",
                           const std::string& fragmentShader = "../shaders/cube_shader/basic_cube/cube.fs"){
@@ -171,8 +151,9 @@ class Cube{
     unsigned int get_VAO() const {
         return _VAO;
     }
+    //Program shared by the cubes of the same shaders (see ShaderRegistry) : a uniform set here is set for all of them.
     Shader& get_shader() { //Passage par réfèrence car on ne peut plus copier le shader pour des raisons de sécurité. 
-        return _shader;
+        return *_shader;
     }
     unsigned int get_textureDiffuse() const {
         return _textureDiffuse;
@@ -222,7 +203,16 @@ class Cube{
         bool _hasDualTexture = false;
         unsigned int _textureDiffuse = 0;
         unsigned int _textureSpecular = 0;
-        Shader _shader;
+        std::shared_ptr<Shader> _shader;
+        //Handles in _shader, resolved once by the constructors. material.diffuse / specular are colors of the
+        //material shaders, texture units of the texture ones : the handle of the other type stays invalid.
+        struct Uniforms {
+            Uniform<glm::mat4> model;
+            Uniform<glm::vec3> objectColor;
+            Uniform<glm::vec3> materialAmbient, materialDiffuse, materialSpecular;
+            Uniform<float> materialShininess;
+            Uniform<int> diffuseUnit, specularUnit;
+        } _uniforms;
         glm::vec3 _color;
         Material _material;
         RenderMode _renderMode;
@@ -238,44 +228,58 @@ class Cube{
         Cube(glm::vec3 center, glm::vec3 color,
              const std::string& vertexShader, const std::string& fragmentShader) : _center(center), _hasTexture(false), _color(color),
              _renderMode(RenderMode::Color), _hasDualTexture(false),
-             _shader(vertexShader.c_str(),fragmentShader.c_str()){
+             _shader(ShaderRegistry::instance().get(vertexShader, fragmentShader)){
 
             initVerticesNoTexture();
             setupBuffer();
+            resolve_uniforms();
         }
 
         Cube(glm::vec3 center, const Material& materialProperties,
              const std::string& vertexShader, const std::string& fragmentShader) : _center(center), _hasTexture(false),
              _renderMode(RenderMode::Material), _material(materialProperties), _hasDualTexture(false),
-             _shader(vertexShader.c_str(),fragmentShader.c_str()){
+             _shader(ShaderRegistry::instance().get(vertexShader, fragmentShader)){
             
             initVerticesNoTexture();
             setupBuffer();
+            resolve_uniforms();
         }
 
         Cube(glm::vec3 center, const std::string& pathTexture,
              const std::string& vertexShader,
              const std::string& fragmentShader) : _center(center), _hasTexture(true),
              _renderMode(RenderMode::Texture), _hasDualTexture(false),
-             _shader(vertexShader.c_str(),fragmentShader.c_str()){
+             _shader(ShaderRegistry::instance().get(vertexShader, fragmentShader)){
 
             initVerticesWithTexture();
             loadTexture(pathTexture, _textureDiffuse);
             setupBuffer();
+            resolve_uniforms();
         }
 
         Cube(glm::vec3 center, const std::string& pathDiffuseTexture, const std::string& pathSpecularTexture,
              const std::string& shaderVertex,
              const std::string& shaderFragment) : _center(center), _hasTexture(true),
              _renderMode(RenderMode::Texture), _hasDualTexture(true),
-             _shader(shaderVertex.c_str(),shaderFragment.c_str()){
+             _shader(ShaderRegistry::instance().get(shaderVertex, shaderFragment)){
                 
                 initVerticesWithTexture();
                 loadTexture(pathDiffuseTexture, _textureDiffuse);
                 loadTexture(pathSpecularTexture, _textureSpecular);
                 setupBuffer();
+                resolve_uniforms();
                 }
 
+        void resolve_uniforms(){
+            _uniforms.model = _shader->uniform<glm::mat4>("model");
+            _uniforms.objectColor = _shader->uniform<glm::vec3>("objectColor");
+            _uniforms.materialAmbient = _shader->uniform<glm::vec3>("material.ambient");
+            _uniforms.materialDiffuse = _shader->uniform<glm::vec3>("material.diffuse");
+            _uniforms.materialSpecular = _shader->uniform<glm::vec3>("material.specular");
+            _uniforms.materialShininess = _shader->uniform<float>("material.shininess");
+            _uniforms.diffuseUnit = _shader->uniform<int>("material.diffuse");
+            _uniforms.specularUnit = _shader->uniform<int>("material.specular");
+        }
         void updateModel(){
             _model = glm::mat4(1.0f);
             _model = glm::translate(_model, _center);
@@ -0,0 +1,334 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include "celestial_body.hpp"
+#include "gravity_lanes.hpp"
+#include "position_snapshot.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+//Pull of a source body on a target body for a run of ensemble members : the arrays are the members of one body,
+//a_i += mu_j d / |d|^3 with d = r_j - r_i, and a_j -= mu_i d / |d|^3 when the arrays of j are given (mutual pair).
+//Lane arithmetic of gravity_lanes.hpp : every instruction set gives the scalar result.
+namespace ensemble_kernel_detail {
+    using namespace gravity_lanes;
+
+    template <typename real>
+    inline void members_scalar(const real* xi, const real* yi, const real* zi, const real* xj, const real* yj,
+                               const real* zj, real* axi, real* ayi, real* azi, real* axj, real* ayj, real* azj,
+                               float mu_j, float mu_i, std::size_t count){
+        for (std::size_t m = 0; m < count; m++){
+            real dx = xj[m] - xi[m];
+            real dy = yj[m] - yi[m];
+            real dz = zj[m] - zi[m];
+            double inv = inverse_cube(dx, dy, dz);
+            real magnitude_i = mu_j * inv;
+            axi[m] += magnitude_i * dx;
+            ayi[m] += magnitude_i * dy;
+            azi[m] += magnitude_i * dz;
+            if (axj){
+                real magnitude_j = mu_i * inv;
+                axj[m] -= magnitude_j * dx;
+                ayj[m] -= magnitude_j * dy;
+                azj[m] -= magnitude_j * dz;
+            }
+        }
+    }
+
+#ifdef GRAVITY_KERNEL_X86
+    //Double precision positions only.
+    __attribute__((target("sse2")))
+    inline void members_sse(const double* xi, const double* yi, const double* zi, const double* xj, const double* yj,
+                            const double* zj, double* axi, double* ayi, double* azi, double* axj, double* ayj,
+                            double* azj, float mu_j, float mu_i, std::size_t count){
+        const __m128d wj = _mm_set1_pd(mu_j), wi = _mm_set1_pd(mu_i);
+        for (std::size_t m = 0; m < count; m += 2){
+            __m128d dx = _mm_sub_pd(_mm_load_pd(xj + m), _mm_load_pd(xi + m));
+            __m128d dy = _mm_sub_pd(_mm_load_pd(yj + m), _mm_load_pd(yi + m));
+            __m128d dz = _mm_sub_pd(_mm_load_pd(zj + m), _mm_load_pd(zi + m));
+            __m128d inv = inverse_cube(dx, dy, dz);
+            __m128d a = _mm_mul_pd(wj, inv);
+            _mm_store_pd(axi + m, add_product(_mm_load_pd(axi + m), a, dx));
+            _mm_store_pd(ayi + m, add_product(_mm_load_pd(ayi + m), a, dy));
+            _mm_store_pd(azi + m, add_product(_mm_load_pd(azi + m), a, dz));
+            if (axj){
+                __m128d b = _mm_mul_pd(wi, inv);
+                _mm_store_pd(axj + m, sub_product(_mm_load_pd(axj + m), b, dx));
+                _mm_store_pd(ayj + m, sub_product(_mm_load_pd(ayj + m), b, dy));
+                _mm_store_pd(azj + m, sub_product(_mm_load_pd(azj + m), b, dz));
+            }
+        }
+    }
+
+    __attribute__((target("avx2")))
+    inline void members_avx2(const double* xi, const double* yi, const double* zi, const double* xj, const double* yj,
+                             const double* zj, double* axi, double* ayi, double* azi, double* axj, double* ayj,
+                             double* azj, float mu_j, float mu_i, std::size_t count){
+        const __m256d wj = _mm256_set1_pd(mu_j), wi = _mm256_set1_pd(mu_i);
+        for (std::size_t m = 0; m < count; m += 4){
+            __m256d dx = _mm256_sub_pd(_mm256_load_pd(xj + m), _mm256_load_pd(xi + m));
+            __m256d dy = _mm256_sub_pd(_mm256_load_pd(yj + m), _mm256_load_pd(yi + m));
+            __m256d dz = _mm256_sub_pd(_mm256_load_pd(zj + m), _mm256_load_pd(zi + m));
+            __m256d inv = inverse_cube(dx, dy, dz);
+            __m256d a = _mm256_mul_pd(wj, inv);
+            _mm256_store_pd(axi + m, add_product(_mm256_load_pd(axi + m), a, dx));
+            _mm256_store_pd(ayi + m, add_product(_mm256_load_pd(ayi + m), a, dy));
+            _mm256_store_pd(azi + m, add_product(_mm256_load_pd(azi + m), a, dz));
+            if (axj){
+                __m256d b = _mm256_mul_pd(wi, inv);
+                _mm256_store_pd(axj + m, sub_product(_mm256_load_pd(axj + m), b, dx));
+                _mm256_store_pd(ayj + m, sub_product(_mm256_load_pd(ayj + m), b, dy));
+                _mm256_store_pd(azj + m, sub_product(_mm256_load_pd(azj + m), b, dz));
+            }
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline void members_avx512(const double* xi, const double* yi, const double* zi, const double* xj, const double* yj,
+                               const double* zj, double* axi, double* ayi, double* azi, double* axj, double* ayj,
+                               double* azj, float mu_j, float mu_i, std::size_t count){
+        const __m512d wj = _mm512_set1_pd(mu_j), wi = _mm512_set1_pd(mu_i);
+        for (std::size_t m = 0; m < count; m += 8){
+            __m512d dx = _mm512_sub_pd(_mm512_load_pd(xj + m), _mm512_load_pd(xi + m));
+            __m512d dy = _mm512_sub_pd(_mm512_load_pd(yj + m), _mm512_load_pd(yi + m));
+            __m512d dz = _mm512_sub_pd(_mm512_load_pd(zj + m), _mm512_load_pd(zi + m));
+            __m512d inv = inverse_cube(dx, dy, dz);
+            __m512d a = _mm512_mul_pd(wj, inv);
+            _mm512_store_pd(axi + m, add_product(_mm512_load_pd(axi + m), a, dx));
+            _mm512_store_pd(ayi + m, add_product(_mm512_load_pd(ayi + m), a, dy));
+            _mm512_store_pd(azi + m, add_product(_mm512_load_pd(azi + m), a, dz));
+            if (axj){
+                __m512d b = _mm512_mul_pd(wi, inv);
+                _mm512_store_pd(axj + m, sub_product(_mm512_load_pd(axj + m), b, dx));
+                _mm512_store_pd(ayj + m, sub_product(_mm512_load_pd(ayj + m), b, dy));
+                _mm512_store_pd(azj + m, sub_product(_mm512_load_pd(azj + m), b, dz));
+            }
+        }
+    }
+#endif
+
+}
+
+//count must be a multiple of Ensemble::LANES and the arrays aligned on 64 bytes.
+template <typename real>
+inline void accumulate_members(const real* xi, const real* yi, const real* zi, const real* xj, const real* yj,
+                               const real* zj, real* axi, real* ayi, real* azi, real* axj, real* ayj, real* azj,
+                               float mu_j, float mu_i, std::size_t count, SimdLevel level){
+    using namespace ensemble_kernel_detail;
+#ifdef GRAVITY_KERNEL_X86
+    if constexpr (std::is_same<real, double>::value){
+        switch (level){
+            case SimdLevel::AVX512: members_avx512(xi, yi, zi, xj, yj, zj, axi, ayi, azi, axj, ayj, azj, mu_j, mu_i, count); return;
+            case SimdLevel::AVX2:   members_avx2(xi, yi, zi, xj, yj, zj, axi, ayi, azi, axj, ayj, azj, mu_j, mu_i, count); return;
+            case SimdLevel::SSE:    members_sse(xi, yi, zi, xj, yj, zj, axi, ayi, azi, axj, ayj, azj, mu_j, mu_i, count); return;
+            default: break;
+        }
+    }
+#endif
+    members_scalar(xi, yi, zi, xj, yj, zj, axi, ayi, azi, axj, ayj, azj, mu_j, mu_i, count);
+}
+
+//Distance of a member to the reference member (0) over the moving bodies, m.
+struct MemberDivergence {
+    double rms = 0.0;
+    double max = 0.0;
+    uint32_t max_body = 0; //Store id of the body furthest from its reference position
+};
+
+//M copies of an OrbitalSystem stepped together, for studies of perturbed initial conditions.
+//
+//The copies share the interaction structure of the system (its flat interaction list, see OrbitalSystem::compile())
+//and live in one BodyStore where the members of a body are contiguous : row = id * stride + member, with the members
+//padded to a multiple of LANES. Every term of the list is then one loop over the members, run by the SIMD kernels
+//above across members (4 doubles per AVX2 register), and a step of M members costs one walk of the list instead of M.
+//The mutual interactions of the groups use the exact pairs in the precision of the positions (the float tiles of the
+//solvers don't vectorize across members), so member 0 follows the system up to the float rounding of those terms.
+//Integration is the position Verlet of OrbitalSystem::integrate().
+//The members are split in chunks of MEMBER_CHUNK, one task of the thread pool each : the result does not depend on the
+//thread count, nor on the instruction set.
+class Ensemble {
+    public:
+        static constexpr std::size_t LANES = 8;          //One AVX-512 register of doubles
+        static constexpr std::size_t MEMBER_CHUNK = 64;
+
+        //Copies of system, which must be initialized (Verlet state) and is not changed. Member 0 is the system itself,
+        //the others get gaussian offsets of position_sigma (m, per axis) and velocity_sigma (m/s, per axis) on every
+        //moving body.
+        Ensemble(OrbitalSystem& system, std::size_t members, double position_sigma, double velocity_sigma,
+                 uint32_t seed = 42){
+            if (members == 0){throw std::invalid_argument("ERROR::ENSEMBLE::NO_MEMBER");}
+            const BodyStore& s = system.get_store();
+            _members = members;
+            _stride = (members + LANES - 1) / LANES * LANES;
+            _bodies = s.size();
+            _interactions = system.get_interactions();
+            _groups = system.get_interaction_groups();
+            _group_bodies = system.get_interaction_bodies();
+            _moving = system.get_verlet_bodies();
+            _mu.resize(_bodies);
+            for (std::size_t i = 0; i < _bodies; i++){_mu[i] = G * s.m[i];}
+
+            _store.reserve(_bodies * _stride);
+            for (std::size_t i = 0; i < _bodies; i++){
+                for (std::size_t m = 0; m < _stride; m++){
+                    _store.add_body(s.get_pos(i), s.get_prev_pos(i), s.get_velocity(i), s.m[i]);
+                }
+            }
+            std::mt19937_64 gen(seed);
+            std::normal_distribution<double> normal(0.0, 1.0);
+            for (std::size_t m = 1; m < members; m++){
+                for (uint32_t i : _moving){
+                    std::size_t row = i * _stride + m;
+                    //Same offset on both Verlet positions, the previous one moved back by the velocity offset.
+                    double dx = position_sigma * normal(gen), dy = position_sigma * normal(gen);
+                    double dz = position_sigma * normal(gen);
+                    double dvx = velocity_sigma * normal(gen), dvy = velocity_sigma * normal(gen);
+                    double dvz = velocity_sigma * normal(gen);
+                    _store.x[row] += dx; _store.y[row] += dy; _store.z[row] += dz;
+                    _store.x_prev[row] += dx - dvx * dt;
+                    _store.y_prev[row] += dy - dvy * dt;
+                    _store.z_prev[row] += dz - dvz * dt;
+                    _store.vx[row] += dvx; _store.vy[row] += dvy; _store.vz[row] += dvz;
+                }
+            }
+        }
+
+        void step(ThreadPool& pool = ThreadPool::instance()){
+            std::size_t chunks = (_stride + MEMBER_CHUNK - 1) / MEMBER_CHUNK;
+            pool.run(chunks, [&](std::size_t chunk){
+                std::size_t begin = chunk * MEMBER_CHUNK, end = std::min(_stride, begin + MEMBER_CHUNK);
+                compute_accelerations(begin, end - begin);
+                integrate(begin, end - begin);
+            });
+            _steps++;
+        }
+
+        std::size_t get_member_count() const {
+            return _members;
+        }
+        uint64_t get_steps() const {
+            return _steps;
+        }
+        void set_simd_level(SimdLevel level){
+            _simd_level = level;
+        }
+        SimdLevel get_simd_level() const {
+            return _simd_level;
+        }
+        BodyStore::vec_type get_pos(std::size_t member, std::size_t id) const {
+            return _store.get_pos(id * _stride + member);
+        }
+        //Positions of one member by store id of the system, to render it like the system.
+        void capture(std::size_t member, PositionSnapshot& snapshot) const {
+            snapshot.positions.resize(_bodies);
+            for (std::size_t i = 0; i < _bodies; i++){snapshot.positions[i] = glm::vec3(get_pos(member, i));}
+            snapshot.time = _steps * (double)dt;
+            snapshot.steps = _steps;
+        }
+
+        MemberDivergence get_divergence(std::size_t member) const {
+            MemberDivergence divergence;
+            double sum = 0.0;
+            for (uint32_t i : _moving){
+                double distance = glm::length(glm::dvec3(get_pos(member, i) - get_pos(0, i)));
+                sum += distance * distance;
+                if (distance > divergence.max){
+                    divergence.max = distance;
+                    divergence.max_body = i;
+                }
+            }
+            divergence.rms = _moving.empty() ? 0.0 : std::sqrt(sum / _moving.size());
+            return divergence;
+        }
+        //Of every member but the reference.
+        std::vector<MemberDivergence> get_divergences() const {
+            std::vector<MemberDivergence> divergences;
+            for (std::size_t m = 1; m < _members; m++){divergences.push_back(get_divergence(m));}
+            return divergences;
+        }
+        //RMS distance of the members of a body to their mean position, m.
+        double get_spread(std::size_t id) const {
+            glm::dvec3 mean(0.0);
+            for (std::size_t m = 0; m < _members; m++){mean += glm::dvec3(get_pos(m, id));}
+            mean /= (double)_members;
+            double sum = 0.0;
+            for (std::size_t m = 0; m < _members; m++){
+                glm::dvec3 offset = glm::dvec3(get_pos(m, id)) - mean;
+                sum += glm::dot(offset, offset);
+            }
+            return std::sqrt(sum / _members);
+        }
+
+    private:
+        using real = BodyStore::position_type;
+
+        std::size_t _members = 0;
+        std::size_t _stride = 0; //Members padded to LANES, the padding members copy member 0
+        std::size_t _bodies = 0;
+        uint64_t _steps = 0;
+        BodyStore _store;
+        std::vector<float> _mu; //G * mass by store id
+        std::vector<Interaction> _interactions;
+        std::vector<InteractionGroup> _groups;
+        std::vector<uint32_t> _group_bodies;
+        std::vector<uint32_t> _moving;
+        SimdLevel _simd_level = detect_simd_level();
+
+        void compute_accelerations(std::size_t begin, std::size_t count){
+            BodyStore& s = _store;
+            for (std::size_t i = 0; i < _bodies; i++){
+                std::size_t row = i * _stride + begin;
+                std::fill(&s.ax[row], &s.ax[row] + count, (real)0);
+                std::fill(&s.ay[row], &s.ay[row] + count, (real)0);
+                std::fill(&s.az[row], &s.az[row] + count, (real)0);
+            }
+            auto pull = [&](uint32_t i, uint32_t j, float mu_j, float mu_i, bool mutual){
+                std::size_t ri = i * _stride + begin, rj = j * _stride + begin;
+                accumulate_members(&s.x[ri], &s.y[ri], &s.z[ri], &s.x[rj], &s.y[rj], &s.z[rj],
+                                   &s.ax[ri], &s.ay[ri], &s.az[ri],
+                                   mutual ? &s.ax[rj] : nullptr, mutual ? &s.ay[rj] : nullptr,
+                                   mutual ? &s.az[rj] : nullptr, mu_j, mu_i, count, _simd_level);
+            };
+            //Order of the interaction list : the pairs before a group, then the group.
+            std::size_t p = 0;
+            auto run_pairs = [&](std::size_t end){
+                for (; p < end; p++){pull(_interactions[p].target, _interactions[p].source, _interactions[p].mu, 0.0f, false);}
+            };
+            for (const InteractionGroup& group : _groups){
+                run_pairs(group.end_pair);
+                const uint32_t* ids = _group_bodies.data() + group.first;
+                for (uint32_t a = 0; a < group.count; a++){
+                    for (uint32_t b = a + 1; b < group.count; b++){pull(ids[a], ids[b], _mu[ids[b]], _mu[ids[a]], true);}
+                }
+            }
+            run_pairs(_interactions.size());
+        }
+
+        void integrate(std::size_t begin, std::size_t count){
+            BodyStore& s = _store;
+            for (uint32_t i : _moving){
+                std::size_t row = i * _stride + begin;
+                for (std::size_t k = row; k < row + count; k++){
+                    real rx = 2 * s.x[k] - s.x_prev[k] + (real)dt * dt * s.ax[k];
+                    real ry = 2 * s.y[k] - s.y_prev[k] + (real)dt * dt * s.ay[k];
+                    real rz = 2 * s.z[k] - s.z_prev[k] + (real)dt * dt * s.az[k];
+                    s.x_prev[k] = s.x[k];
+                    s.y_prev[k] = s.y[k];
+                    s.z_prev[k] = s.z[k];
+                    s.x[k] = rx;
+                    s.y[k] = ry;
+                    s.z[k] = rz;
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef FAST_MULTIPOLE_HPP
+#define FAST_MULTIPOLE_HPP
+
+#include "barnes_hut.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Fast Multipole Method with Cartesian expansions of configurable order p.
+//
+//The octree is the one of BarnesHutTree (Morton order, depth first nodes with skip index : the children of node k are
+//k + 1, then each child skip until the skip of k). With d = y - z (z center of mass of a cell) and
+//a_k(R) = (1 / k!) d^k(1 / |R|) / dR^k for a multi-index k :
+//  multipole    M_n = sum_j mu_j d_j^n                                   |n| <= p
+//  local        L_k = sum_n (-1)^|n| M_n C(n + k, k) a_{n+k}(z_B - z_A)  |n| + |k| <= p
+//  acceleration a_i = sum_k L_k k_i u^(k - e_i)                          u = x - z_B
+//The a_k are computed with the recurrence of the Taylor coefficients of 1/|R| :
+//  |k| |R|^2 a_k + (2|k| - 1) sum_i R_i a_{k-e_i} + (|k| - 1) sum_i a_{k-2e_i} = 0
+//
+//Cells interact through a dual tree walk : two cells are well separated when (b_A + b_B) < theta * |z_A - z_B|
+//(b bound of the distance of the bodies to the center of mass), they then exchange a local expansion both ways.
+//Otherwise the bigger one is opened. Two leaves (up to LEAF_SIZE bodies), or two cells with few body pairs, are summed
+//directly in float by the all-pairs kernel of gravity_kernel.hpp. Expansions are done in double precision.
+//The error decreases roughly as theta^p, see gravity_benchmark for the accuracy against the exact solver.
+//
+//The walk is O(N) : on a uniform cube the work per body stops growing with N. It only gets there once the cells of
+//the near field are small compared to the distribution, and on the thin belt of gravity_benchmark (0.1 AU thick) the
+//cells go from flat to cubic over the benchmarked sizes, each body getting more neighbours. Measured there (p = 6,
+//AVX-512, 1 thread) : 1.1, 1.4, 2.7, 3.1 us per body at N = 256, 1024, 4096, 16384 (time ~ N^1.1 between the last
+//two, the exact sum ~ N^2), 8 us at 262144. The FMM is faster than the exact sum from N ~ 9000 at p = 6, ~ 6000 at
+//p = 4, ~ 4000 at p = 2 ; gravity_benchmark prints these for the machine it runs on.
+
+class FastMultipole {
+    public:
+        static constexpr int MAX_ORDER = 8;
+
+        static constexpr uint32_t LEAF_SIZE = 32;
+
+        FastMultipole(int order = 4, float theta = 0.5f) : _tree(theta){
+            _tree.set_leaf_size(LEAF_SIZE);
+            set_expansion_order(order);
+        }
+
+        void set_expansion_order(int order){
+            _p = std::max(1, std::min(MAX_ORDER, order));
+            build_tables();
+        }
+        int get_expansion_order() const {
+            return _p;
+        }
+        void set_theta(float theta){
+            _tree.set_theta(theta);
+        }
+        float get_theta() const {
+            return _tree.get_theta();
+        }
+
+        //Add the accelerations of the mutual interactions of the tile to tile.ax/ay/az. level : instruction set of the
+        //direct sums (the all-pairs kernel of gravity_kernel.hpp).
+        void accumulate(GravityTile& tile, SimdLevel level = detect_simd_level()){
+            _tree.build(tile);
+            const std::vector<OctreeNode>& nodes = _tree.get_nodes();
+            std::size_t n = tile.n;
+            if (n == 0){return;}
+
+            _multipoles.assign(nodes.size() * _count, 0.0);
+            _locals.assign(nodes.size() * _count, 0.0);
+            _ax.assign(n, 0.0);
+            _ay.assign(n, 0.0);
+            _az.assign(n, 0.0);
+            _near.resize(n);
+            std::fill(_near.ax.begin(), _near.ax.begin() + n, 0.0f);
+            std::fill(_near.ay.begin(), _near.ay.begin() + n, 0.0f);
+            std::fill(_near.az.begin(), _near.az.begin() + n, 0.0f);
+            _level = level;
+
+            upward_pass(nodes);
+            dual_tree_walk(nodes);
+            downward_pass(nodes);
+
+            const std::vector<uint32_t>& order = _tree.get_order();
+            for (std::size_t p = 0; p < n; p++){
+                uint32_t i = order[p];
+                tile.ax[i] += (float)_ax[p] + _near.ax[p];
+                tile.ay[i] += (float)_ay[p] + _near.ay[p];
+                tile.az[i] += (float)_az[p] + _near.az[p];
+            }
+        }
+
+    private:
+        struct Term {
+            int a, b;       //Indices of the two multi-indices combined
+            int c;          //Index of their sum (or difference)
+            double coef;    //Binomial coefficient (and sign)
+            double reverse; //(-1)^|c|, for the expansion in the other direction
+        };
+        //a_k from a_{k-e_i} (first) and a_{k-2e_i} (second), -1 when the component of k is too small.
+        struct Recurrence {
+            int first[3];
+            int second[3];
+            double c1, c2;  //-(2|k| - 1) / |k| and -(|k| - 1) / |k|
+        };
+
+        BarnesHutTree _tree;
+        int _p = 4;
+        std::size_t _direct_limit = 0; //Pairs of cells with fewer body pairs are summed directly
+        int _count = 0; //Number of multi-indices with |k| <= p
+        std::vector<int> _index;   //(i, j, k) -> index, (p + 1)^3 entries
+        std::vector<int> _ix, _iy, _iz, _degree;
+        std::vector<Term> _m2l, _shift; //M2L and M2M/L2L terms
+        std::vector<int> _m2l_offsets;  //The M2L terms of L_k are [_m2l_offsets[k], _m2l_offsets[k + 1])
+        std::vector<Recurrence> _recurrence;
+        std::vector<double> _multipoles, _locals;
+        std::vector<double> _ax, _ay, _az;  //Far field, in Morton order
+        GravityTile _near;                  //Accelerations of the direct sums, in Morton order
+        SimdLevel _level = SimdLevel::Scalar;
+        std::vector<std::pair<uint32_t, uint32_t>> _stack;
+
+        int index(int i, int j, int k) const {
+            return _index[(i * (MAX_ORDER + 1) + j) * (MAX_ORDER + 1) + k];
+        }
+
+        static double binomial(int n, int k){
+            double result = 1.0;
+            for (int i = 1; i <= k; i++){result = result * (n - k + i) / i;}
+            return result;
+        }
+
+        void build_tables(){
+            _index.assign((MAX_ORDER + 1) * (MAX_ORDER + 1) * (MAX_ORDER + 1), -1);
+            _ix.clear(); _iy.clear(); _iz.clear(); _degree.clear();
+            //Multi-indices sorted by degree, the recurrence only needs lower degrees.
+            for (int d = 0; d <= _p; d++){
+                for (int i = d; i >= 0; i--){
+                    for (int j = d - i; j >= 0; j--){
+                        int k = d - i - j;
+                        _index[(i * (MAX_ORDER + 1) + j) * (MAX_ORDER + 1) + k] = (int)_ix.size();
+                        _ix.push_back(i); _iy.push_back(j); _iz.push_back(k); _degree.push_back(d);
+                    }
+                }
+            }
+            _count = (int)_ix.size();
+
+            _m2l.clear();
+            _shift.clear();
+            _m2l_offsets.assign(1, 0);
+            for (int k = 0; k < _count; k++){
+                for (int n = 0; n < _count; n++){
+                    if (_degree[n] + _degree[k] <= _p){
+                        double coef = binomial(_ix[n] + _ix[k], _ix[k]) * binomial(_iy[n] + _iy[k], _iy[k])
+                                    * binomial(_iz[n] + _iz[k], _iz[k]);
+                        if (_degree[n] % 2){coef = -coef;}
+                        int c = index(_ix[n] + _ix[k], _iy[n] + _iy[k], _iz[n] + _iz[k]);
+                        _m2l.push_back({k, n, c, coef, _degree[c] % 2 ? -1.0 : 1.0});
+                    }
+                    //Shift terms : m <= n componentwise, difference n - m.
+                    if (_ix[k] <= _ix[n] && _iy[k] <= _iy[n] && _iz[k] <= _iz[n]){
+                        double coef = binomial(_ix[n], _ix[k]) * binomial(_iy[n], _iy[k]) * binomial(_iz[n], _iz[k]);
+                        _shift.push_back({n, k, index(_ix[n] - _ix[k], _iy[n] - _iy[k], _iz[n] - _iz[k]), coef, 1.0});
+                    }
+                }
+                _m2l_offsets.push_back((int)_m2l.size());
+            }
+
+            //A M2L (both ways, in double) costs about 2.5 ns per term, a pair of the all-pairs kernel about 1.3 ns
+            //between small cells (AVX-512) : pairs of cells up to a few M2L are cheaper (and exact) when summed
+            //directly. 8 terms per pair was the fastest on the belt of gravity_benchmark and on a uniform cube.
+            _direct_limit = 8 * _m2l.size();
+
+            _recurrence.assign(_count, Recurrence());
+            for (int k = 1; k < _count; k++){
+                Recurrence& rec = _recurrence[k];
+                int e[3] = {_ix[k], _iy[k], _iz[k]};
+                for (int c = 0; c < 3; c++){
+                    e[c] -= 1;
+                    rec.first[c] = e[c] >= 0 ? index(e[0], e[1], e[2]) : -1;
+                    e[c] -= 1;
+                    rec.second[c] = e[c] >= 0 ? index(e[0], e[1], e[2]) : -1;
+                    e[c] += 2;
+                }
+                rec.c1 = -(2.0 * _degree[k] - 1.0) / _degree[k];
+                rec.c2 = -(_degree[k] - 1.0) / _degree[k];
+            }
+        }
+
+        //s^k for every multi-index k.
+        void powers(double sx, double sy, double sz, double* out) const {
+            double px[MAX_ORDER + 1], py[MAX_ORDER + 1], pz[MAX_ORDER + 1];
+            px[0] = py[0] = pz[0] = 1.0;
+            for (int d = 1; d <= _p; d++){
+                px[d] = px[d - 1] * sx;
+                py[d] = py[d - 1] * sy;
+                pz[d] = pz[d - 1] * sz;
+            }
+            for (int k = 0; k < _count; k++){out[k] = px[_ix[k]] * py[_iy[k]] * pz[_iz[k]];}
+        }
+
+        //Taylor coefficients a_k of 1/|R|.
+        void taylor_coefficients(double rx, double ry, double rz, double* a) const {
+            double r2 = rx * rx + ry * ry + rz * rz;
+            double inv_r2 = 1.0 / r2;
+            a[0] = std::sqrt(inv_r2);
+            double R[3] = {rx, ry, rz};
+            for (int k = 1; k < _count; k++){
+                const Recurrence& rec = _recurrence[k];
+                double sum1 = 0.0, sum2 = 0.0;
+                for (int c = 0; c < 3; c++){
+                    if (rec.first[c] >= 0){sum1 += R[c] * a[rec.first[c]];}
+                    if (rec.second[c] >= 0){sum2 += a[rec.second[c]];}
+                }
+                a[k] = (rec.c1 * sum1 + rec.c2 * sum2) * inv_r2;
+            }
+        }
+
+        static bool is_leaf(const OctreeNode& node, uint32_t k){
+            return node.skip == k + 1;
+        }
+
+        void upward_pass(const std::vector<OctreeNode>& nodes){
+            const aligned_vector<float>& x = _tree.get_x();
+            const aligned_vector<float>& y = _tree.get_y();
+            const aligned_vector<float>& z = _tree.get_z();
+            const aligned_vector<float>& mu = _tree.get_mu();
+            std::vector<double> s(_count);
+            //Children are stored after their parent : a reverse scan sees them first.
+            for (std::size_t k = nodes.size(); k-- > 0;){
+                const OctreeNode& node = nodes[k];
+                double* M = &_multipoles[k * _count];
+                if (is_leaf(node, (uint32_t)k)){
+                    for (uint32_t q = node.first; q < node.first + node.count; q++){
+                        powers((double)x[q] - node.cx, (double)y[q] - node.cy, (double)z[q] - node.cz, s.data());
+                        for (int c = 0; c < _count; c++){M[c] += mu[q] * s[c];}
+                    }
+                    continue;
+                }
+                for (uint32_t child = (uint32_t)k + 1; child < node.skip; child = nodes[child].skip){
+                    const double* Mc = &_multipoles[child * _count];
+                    powers((double)nodes[child].cx - node.cx, (double)nodes[child].cy - node.cy,
+                           (double)nodes[child].cz - node.cz, s.data());
+                    for (const Term& t : _shift){M[t.a] += t.coef * s[t.c] * Mc[t.b];}
+                }
+            }
+        }
+
+        void multipole_to_local(const std::vector<OctreeNode>& nodes, uint32_t A, uint32_t B, double* a){
+            //Mutual : L_B from M_A, and L_A from M_B with R reversed (a_k(-R) = (-1)^|k| a_k(R)).
+            taylor_coefficients((double)nodes[B].cx - nodes[A].cx, (double)nodes[B].cy - nodes[A].cy,
+                                (double)nodes[B].cz - nodes[A].cz, a);
+            const double* MA = &_multipoles[A * _count];
+            const double* MB = &_multipoles[B * _count];
+            double* LA = &_locals[A * _count];
+            double* LB = &_locals[B * _count];
+            for (int k = 0; k < _count; k++){
+                double to_b = 0.0, to_a = 0.0;
+                for (int i = _m2l_offsets[k]; i < _m2l_offsets[k + 1]; i++){
+                    const Term& t = _m2l[i];
+                    double g = t.coef * a[t.c];
+                    to_b += g * MA[t.b];
+                    to_a += t.reverse * g * MB[t.b];
+                }
+                LB[k] += to_b;
+                LA[k] += to_a;
+            }
+        }
+
+        //Pairs of two cells (or of a cell with itself), with the all-pairs kernel : the cells are disjoint ranges of
+        //the Morton order, every body of the first one is before every body of the second one.
+        void direct(uint32_t first_a, uint32_t count_a, uint32_t first_b, uint32_t count_b){
+            if (first_b < first_a){
+                std::swap(first_a, first_b);
+                std::swap(count_a, count_b);
+            }
+            accumulate_block_pairs(_tree.get_x().data(), _tree.get_y().data(), _tree.get_z().data(),
+                                   _tree.get_mu().data(), _near.ax.data(), _near.ay.data(), _near.az.data(),
+                                   first_a, first_a + count_a, first_b, first_b + count_b, _level);
+        }
+
+        void dual_tree_walk(const std::vector<OctreeNode>& nodes){
+            const float theta = _tree.get_theta();
+            std::vector<double> a(_count);
+            _stack.clear();
+            _stack.push_back({0, 0});
+            while (!_stack.empty()){
+                auto [A, B] = _stack.back();
+                _stack.pop_back();
+                const OctreeNode& nA = nodes[A];
+                const OctreeNode& nB = nodes[B];
+                bool leaf_a = is_leaf(nA, A), leaf_b = is_leaf(nB, B);
+                if (A == B){
+                    if (leaf_a){
+                        direct(nA.first, nA.count, nA.first, nA.count);
+                        continue;
+                    }
+                    for (uint32_t c1 = A + 1; c1 < nA.skip; c1 = nodes[c1].skip){
+                        for (uint32_t c2 = c1; c2 < nA.skip; c2 = nodes[c2].skip){_stack.push_back({c1, c2});}
+                    }
+                    continue;
+                }
+                float dx = nB.cx - nA.cx, dy = nB.cy - nA.cy, dz = nB.cz - nA.cz;
+                float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+                if ((std::size_t)nA.count * nB.count <= _direct_limit){
+                    direct(nA.first, nA.count, nB.first, nB.count);
+                }
+                else if (nA.radius + nB.radius < theta * r){
+                    multipole_to_local(nodes, A, B, a.data());
+                }
+                else if (leaf_a && leaf_b){
+                    direct(nA.first, nA.count, nB.first, nB.count);
+                }
+                else if (leaf_b || (!leaf_a && nA.radius >= nB.radius)){
+                    for (uint32_t c = A + 1; c < nA.skip; c = nodes[c].skip){_stack.push_back({c, B});}
+                }
+                else {
+                    for (uint32_t c = B + 1; c < nB.skip; c = nodes[c].skip){_stack.push_back({A, c});}
+                }
+            }
+        }
+
+        void downward_pass(const std::vector<OctreeNode>& nodes){
+            const aligned_vector<float>& x = _tree.get_x();
+            const aligned_vector<float>& y = _tree.get_y();
+            const aligned_vector<float>& z = _tree.get_z();
+            std::vector<double> s(_count);
+            //Parents are stored before their children.
+            for (uint32_t k = 0; k < nodes.size(); k++){
+                const OctreeNode& node = nodes[k];
+                const double* L = &_locals[k * _count];
+                if (!is_leaf(node, k)){
+                    for (uint32_t child = k + 1; child < node.skip; child = nodes[child].skip){
+                        double* Lc = &_locals[child * _count];
+                        powers((double)nodes[child].cx - node.cx, (double)nodes[child].cy - node.cy,
+                               (double)nodes[child].cz - node.cz, s.data());
+                        //L_c[m] += sum_{k >= m} C(k, m) t^(k - m) L[k]
+                        for (const Term& t : _shift){Lc[t.b] += t.coef * s[t.c] * L[t.a];}
+                    }
+                    continue;
+                }
+                for (uint32_t q = node.first; q < node.first + node.count; q++){
+                    powers((double)x[q] - node.cx, (double)y[q] - node.cy, (double)z[q] - node.cz, s.data());
+                    double gx = 0.0, gy = 0.0, gz = 0.0;
+                    for (int c = 0; c < _count; c++){
+                        if (_degree[c] == _p){continue;}
+                        //d(u^m)/du_i = m_i u^(m - e_i) : L_{m+e_i} (m_i + 1) u^m
+                        gx += L[index(_ix[c] + 1, _iy[c], _iz[c])] * (_ix[c] + 1) * s[c];
+                        gy += L[index(_ix[c], _iy[c] + 1, _iz[c])] * (_iy[c] + 1) * s[c];
+                        gz += L[index(_ix[c], _iy[c], _iz[c] + 1)] * (_iz[c] + 1) * s[c];
+                    }
+                    _ax[q] += gx;
+                    _ay[q] += gy;
+                    _az[q] += gz;
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,483 @@
+#ifndef GRAVITY_KERNEL_HPP
+#define GRAVITY_KERNEL_HPP
+
+#include "body_store.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRAVITY_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+//All-pairs gravity kernel. Every pair (i, j) with i < j is evaluated once and the result is used for both bodies
+//(third law of Newton) : a_i += mu_j * d / |d|^3 and a_j -= mu_i * d / |d|^3 with mu = G * m and d = r_j - r_i.
+//
+//Vectorized versions compute 1/|d| with rsqrt followed by one Newton-Raphson iteration, which gives ~22 correct bits.
+//The scalar version uses the formula of CelestialObject::compute_acceleration_from. Against an exact evaluation, the
+//error of every kernel stays within GRAVITY_KERNEL_TOLERANCE of the error of the per-direction scalar path, both
+//relative to the sum of the magnitudes of the pair contributions of a body (the float summation error itself grows
+//with the number of bodies, see gravity_benchmark).
+//The acceleration is computed as (mu * 1/|d|^2) * (d * 1/|d|) so that no intermediate value goes under FLT_MIN for
+//astronomical distances (1/|d|^3 is already denormal for Neptune).
+
+const float GRAVITY_KERNEL_TOLERANCE = 1e-5f;
+
+enum class SimdLevel {Scalar, SSE, AVX2, AVX512};
+
+inline const char* simd_level_name(SimdLevel level){
+    switch (level){
+        case SimdLevel::SSE:    return "sse";
+        case SimdLevel::AVX2:   return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default:                return "scalar";
+    }
+}
+
+//Best instruction set supported by the CPU running the program.
+inline SimdLevel detect_simd_level(){
+#ifdef GRAVITY_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE;
+#endif
+    return SimdLevel::Scalar;
+}
+
+//Contiguous copy of the bodies taking part to the all-pairs interaction. Buffers only grow, so once the tile has
+//reached the size of the system no more allocation is done.
+struct GravityTile {
+    aligned_vector<float> x, y, z, mu;
+    aligned_vector<float> ax, ay, az;
+    std::size_t n = 0;
+
+    void resize(std::size_t count){
+        n = count;
+        if (x.size() < count){
+            for (auto* array : {&x, &y, &z, &mu, &ax, &ay, &az}){array->resize(count);}
+        }
+    }
+    //Positions are stored relative to origin : with a double precision store only the (small) offsets are rounded.
+    template <typename Store>
+    void set_body(std::size_t k, const Store& store, std::size_t id, float G, const typename Store::vec_type& origin){
+        x[k] = (float)(store.x[id] - origin.x);
+        y[k] = (float)(store.y[id] - origin.y);
+        z[k] = (float)(store.z[id] - origin.z);
+        mu[k] = G * store.m[id];
+        ax[k] = 0.0f;
+        ay[k] = 0.0f;
+        az[k] = 0.0f;
+    }
+};
+
+namespace gravity_kernel_detail {
+
+    inline void pairs_scalar(const float* x, const float* y, const float* z, const float* mu,
+                             float* ax, float* ay, float* az, std::size_t begin, std::size_t end, std::size_t col_begin, std::size_t col_end){
+        for (std::size_t i = begin; i < end; i++){
+            float axi = 0.0f, ayi = 0.0f, azi = 0.0f;
+            for (std::size_t j = std::max(i + 1, col_begin); j < col_end; j++){
+                float dx = x[j] - x[i];
+                float dy = y[j] - y[i];
+                float dz = z[j] - z[i];
+
+                float norm = std::sqrt(dx * dx + dy * dy + dz * dz);
+                double inv = 1.0f / (norm * norm * norm);
+                float magnitude_i = mu[j] * inv;
+                float magnitude_j = mu[i] * inv;
+
+                axi += magnitude_i * dx;
+                ayi += magnitude_i * dy;
+                azi += magnitude_i * dz;
+                ax[j] -= magnitude_j * dx;
+                ay[j] -= magnitude_j * dy;
+                az[j] -= magnitude_j * dz;
+            }
+            ax[i] += axi;
+            ay[i] += ayi;
+            az[i] += azi;
+        }
+    }
+
+    //Tail of a row, used by the vectorized kernels for the last j < width.
+    inline void row_tail(const float* x, const float* y, const float* z, const float* mu,
+                         float* ax, float* ay, float* az, std::size_t i, std::size_t j, std::size_t n,
+                         float& axi, float& ayi, float& azi){
+        for (; j < n; j++){
+            float dx = x[j] - x[i];
+            float dy = y[j] - y[i];
+            float dz = z[j] - z[i];
+            float inv_r = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+            float inv_r2 = inv_r * inv_r;
+            float ux = dx * inv_r, uy = dy * inv_r, uz = dz * inv_r;
+            float wi = mu[j] * inv_r2;
+            float wj = mu[i] * inv_r2;
+            axi += wi * ux; ayi += wi * uy; azi += wi * uz;
+            ax[j] -= wj * ux; ay[j] -= wj * uy; az[j] -= wj * uz;
+        }
+    }
+
+    //Rows of the full matrix for the given targets : a_i = sum over every j != i, nothing is written to a_j.
+    //Used when only a few bodies need their acceleration (block timesteps).
+    inline void targets_scalar(const float* x, const float* y, const float* z, const float* mu,
+                               float* ax, float* ay, float* az, const uint32_t* targets, std::size_t count,
+                               std::size_t n){
+        for (std::size_t t = 0; t < count; t++){
+            std::size_t i = targets[t];
+            float axi = 0.0f, ayi = 0.0f, azi = 0.0f;
+            for (std::size_t j = 0; j < n; j++){
+                if (j == i) continue;
+                float dx = x[j] - x[i];
+                float dy = y[j] - y[i];
+                float dz = z[j] - z[i];
+                float inv_r = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+                float wi = mu[j] * inv_r * inv_r;
+                axi += wi * (dx * inv_r); ayi += wi * (dy * inv_r); azi += wi * (dz * inv_r);
+            }
+            ax[i] += axi;
+            ay[i] += ayi;
+            az[i] += azi;
+        }
+    }
+
+#ifdef GRAVITY_KERNEL_X86
+    __attribute__((target("sse2")))
+    inline float hsum(__m128 v){
+        __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        sums = _mm_add_ss(sums, shuf);
+        return _mm_cvtss_f32(sums);
+    }
+
+    __attribute__((target("sse2")))
+    inline void pairs_sse(const float* x, const float* y, const float* z, const float* mu,
+                          float* ax, float* ay, float* az, std::size_t begin, std::size_t end, std::size_t col_begin, std::size_t col_end){
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 three_half = _mm_set1_ps(1.5f);
+        for (std::size_t i = begin; i < end; i++){
+            __m128 xi = _mm_set1_ps(x[i]), yi = _mm_set1_ps(y[i]), zi = _mm_set1_ps(z[i]);
+            __m128 mui = _mm_set1_ps(mu[i]);
+            __m128 axi = _mm_setzero_ps(), ayi = _mm_setzero_ps(), azi = _mm_setzero_ps();
+            std::size_t j = std::max(i + 1, col_begin);
+            for (; j + 4 <= col_end; j += 4){
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), xi);
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), yi);
+                __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), zi);
+                __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 inv_r = _mm_rsqrt_ps(r2);
+                inv_r = _mm_mul_ps(inv_r, _mm_sub_ps(three_half, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv_r, inv_r))));
+                __m128 inv_r2 = _mm_mul_ps(inv_r, inv_r);
+                __m128 ux = _mm_mul_ps(dx, inv_r), uy = _mm_mul_ps(dy, inv_r), uz = _mm_mul_ps(dz, inv_r);
+                __m128 wi = _mm_mul_ps(_mm_loadu_ps(mu + j), inv_r2);
+                __m128 wj = _mm_mul_ps(mui, inv_r2);
+                axi = _mm_add_ps(axi, _mm_mul_ps(wi, ux));
+                ayi = _mm_add_ps(ayi, _mm_mul_ps(wi, uy));
+                azi = _mm_add_ps(azi, _mm_mul_ps(wi, uz));
+                _mm_storeu_ps(ax + j, _mm_sub_ps(_mm_loadu_ps(ax + j), _mm_mul_ps(wj, ux)));
+                _mm_storeu_ps(ay + j, _mm_sub_ps(_mm_loadu_ps(ay + j), _mm_mul_ps(wj, uy)));
+                _mm_storeu_ps(az + j, _mm_sub_ps(_mm_loadu_ps(az + j), _mm_mul_ps(wj, uz)));
+            }
+            float sx = hsum(axi), sy = hsum(ayi), sz = hsum(azi);
+            row_tail(x, y, z, mu, ax, ay, az, i, j, col_end, sx, sy, sz);
+            ax[i] += sx;
+            ay[i] += sy;
+            az[i] += sz;
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline float hsum(__m256 v){
+        __m128 low = _mm256_castps256_ps128(v);
+        __m128 high = _mm256_extractf128_ps(v, 1);
+        return hsum(_mm_add_ps(low, high));
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void pairs_avx2(const float* x, const float* y, const float* z, const float* mu,
+                           float* ax, float* ay, float* az, std::size_t begin, std::size_t end, std::size_t col_begin, std::size_t col_end){
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 three_half = _mm256_set1_ps(1.5f);
+        for (std::size_t i = begin; i < end; i++){
+            __m256 xi = _mm256_set1_ps(x[i]), yi = _mm256_set1_ps(y[i]), zi = _mm256_set1_ps(z[i]);
+            __m256 mui = _mm256_set1_ps(mu[i]);
+            __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+            std::size_t j = std::max(i + 1, col_begin);
+            for (; j + 8 <= col_end; j += 8){
+                __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+                __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+                __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), zi);
+                __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+                __m256 inv_r = _mm256_rsqrt_ps(r2);
+                inv_r = _mm256_mul_ps(inv_r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv_r, inv_r), three_half));
+                __m256 inv_r2 = _mm256_mul_ps(inv_r, inv_r);
+                __m256 ux = _mm256_mul_ps(dx, inv_r), uy = _mm256_mul_ps(dy, inv_r), uz = _mm256_mul_ps(dz, inv_r);
+                __m256 wi = _mm256_mul_ps(_mm256_loadu_ps(mu + j), inv_r2);
+                __m256 wj = _mm256_mul_ps(mui, inv_r2);
+                axi = _mm256_fmadd_ps(wi, ux, axi);
+                ayi = _mm256_fmadd_ps(wi, uy, ayi);
+                azi = _mm256_fmadd_ps(wi, uz, azi);
+                _mm256_storeu_ps(ax + j, _mm256_fnmadd_ps(wj, ux, _mm256_loadu_ps(ax + j)));
+                _mm256_storeu_ps(ay + j, _mm256_fnmadd_ps(wj, uy, _mm256_loadu_ps(ay + j)));
+                _mm256_storeu_ps(az + j, _mm256_fnmadd_ps(wj, uz, _mm256_loadu_ps(az + j)));
+            }
+            float sx = hsum(axi), sy = hsum(ayi), sz = hsum(azi);
+            row_tail(x, y, z, mu, ax, ay, az, i, j, col_end, sx, sy, sz);
+            ax[i] += sx;
+            ay[i] += sy;
+            az[i] += sz;
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline float hsum(__m512 v){
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, v);
+        float sum = 0.0f;
+        for (float lane : lanes){sum += lane;}
+        return sum;
+    }
+
+    __attribute__((target("avx512f")))
+    inline void pairs_avx512(const float* x, const float* y, const float* z, const float* mu,
+                             float* ax, float* ay, float* az, std::size_t begin, std::size_t end, std::size_t col_begin, std::size_t col_end){
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 three_half = _mm512_set1_ps(1.5f);
+        for (std::size_t i = begin; i < end; i++){
+            __m512 xi = _mm512_set1_ps(x[i]), yi = _mm512_set1_ps(y[i]), zi = _mm512_set1_ps(z[i]);
+            __m512 mui = _mm512_set1_ps(mu[i]);
+            __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+            for (std::size_t j = std::max(i + 1, col_begin); j < col_end; j += 16){
+                //Masked loads/stores handle the end of the row, no scalar tail.
+                std::size_t left = col_end - j;
+                __mmask16 mask = left >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << left) - 1u);
+                __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + j), xi);
+                __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y + j), yi);
+                __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, z + j), zi);
+                __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+                __m512 inv_r = _mm512_maskz_rsqrt14_ps(mask, r2);
+                inv_r = _mm512_mul_ps(inv_r, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv_r, inv_r), three_half));
+                __m512 inv_r2 = _mm512_mul_ps(inv_r, inv_r);
+                __m512 ux = _mm512_mul_ps(dx, inv_r), uy = _mm512_mul_ps(dy, inv_r), uz = _mm512_mul_ps(dz, inv_r);
+                __m512 wi = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, mu + j), inv_r2);
+                __m512 wj = _mm512_mul_ps(mui, inv_r2);
+                axi = _mm512_fmadd_ps(wi, ux, axi);
+                ayi = _mm512_fmadd_ps(wi, uy, ayi);
+                azi = _mm512_fmadd_ps(wi, uz, azi);
+                _mm512_mask_storeu_ps(ax + j, mask, _mm512_fnmadd_ps(wj, ux, _mm512_maskz_loadu_ps(mask, ax + j)));
+                _mm512_mask_storeu_ps(ay + j, mask, _mm512_fnmadd_ps(wj, uy, _mm512_maskz_loadu_ps(mask, ay + j)));
+                _mm512_mask_storeu_ps(az + j, mask, _mm512_fnmadd_ps(wj, uz, _mm512_maskz_loadu_ps(mask, az + j)));
+            }
+            ax[i] += hsum(axi);
+            ay[i] += hsum(ayi);
+            az[i] += hsum(azi);
+        }
+    }
+
+    //The pair (i, i) is masked out with r2 > 0 (rsqrt(0) is infinite).
+    __attribute__((target("sse2")))
+    inline void targets_sse(const float* x, const float* y, const float* z, const float* mu,
+                            float* ax, float* ay, float* az, const uint32_t* targets, std::size_t count,
+                            std::size_t n){
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 three_half = _mm_set1_ps(1.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (std::size_t t = 0; t < count; t++){
+            std::size_t i = targets[t];
+            __m128 xi = _mm_set1_ps(x[i]), yi = _mm_set1_ps(y[i]), zi = _mm_set1_ps(z[i]);
+            __m128 axi = _mm_setzero_ps(), ayi = _mm_setzero_ps(), azi = _mm_setzero_ps();
+            std::size_t j = 0;
+            for (; j + 4 <= n; j += 4){
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), xi);
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), yi);
+                __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), zi);
+                __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 inv_r = _mm_rsqrt_ps(r2);
+                inv_r = _mm_mul_ps(inv_r, _mm_sub_ps(three_half, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv_r, inv_r))));
+                inv_r = _mm_and_ps(inv_r, _mm_cmpgt_ps(r2, zero));
+                __m128 inv_r2 = _mm_mul_ps(inv_r, inv_r);
+                __m128 wi = _mm_mul_ps(_mm_loadu_ps(mu + j), inv_r2);
+                axi = _mm_add_ps(axi, _mm_mul_ps(wi, _mm_mul_ps(dx, inv_r)));
+                ayi = _mm_add_ps(ayi, _mm_mul_ps(wi, _mm_mul_ps(dy, inv_r)));
+                azi = _mm_add_ps(azi, _mm_mul_ps(wi, _mm_mul_ps(dz, inv_r)));
+            }
+            float sx = hsum(axi), sy = hsum(ayi), sz = hsum(azi);
+            for (; j < n; j++){
+                if (j == i) continue;
+                float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                float inv_r = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+                float wi = mu[j] * inv_r * inv_r;
+                sx += wi * (dx * inv_r); sy += wi * (dy * inv_r); sz += wi * (dz * inv_r);
+            }
+            ax[i] += sx;
+            ay[i] += sy;
+            az[i] += sz;
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void targets_avx2(const float* x, const float* y, const float* z, const float* mu,
+                             float* ax, float* ay, float* az, const uint32_t* targets, std::size_t count,
+                             std::size_t n){
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 three_half = _mm256_set1_ps(1.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for (std::size_t t = 0; t < count; t++){
+            std::size_t i = targets[t];
+            __m256 xi = _mm256_set1_ps(x[i]), yi = _mm256_set1_ps(y[i]), zi = _mm256_set1_ps(z[i]);
+            __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+            std::size_t j = 0;
+            for (; j + 8 <= n; j += 8){
+                __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+                __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+                __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), zi);
+                __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+                __m256 inv_r = _mm256_rsqrt_ps(r2);
+                inv_r = _mm256_mul_ps(inv_r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv_r, inv_r), three_half));
+                inv_r = _mm256_and_ps(inv_r, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+                __m256 inv_r2 = _mm256_mul_ps(inv_r, inv_r);
+                __m256 wi = _mm256_mul_ps(_mm256_loadu_ps(mu + j), inv_r2);
+                axi = _mm256_fmadd_ps(wi, _mm256_mul_ps(dx, inv_r), axi);
+                ayi = _mm256_fmadd_ps(wi, _mm256_mul_ps(dy, inv_r), ayi);
+                azi = _mm256_fmadd_ps(wi, _mm256_mul_ps(dz, inv_r), azi);
+            }
+            float sx = hsum(axi), sy = hsum(ayi), sz = hsum(azi);
+            for (; j < n; j++){
+                if (j == i) continue;
+                float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+                float inv_r = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+                float wi = mu[j] * inv_r * inv_r;
+                sx += wi * (dx * inv_r); sy += wi * (dy * inv_r); sz += wi * (dz * inv_r);
+            }
+            ax[i] += sx;
+            ay[i] += sy;
+            az[i] += sz;
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline void targets_avx512(const float* x, const float* y, const float* z, const float* mu,
+                               float* ax, float* ay, float* az, const uint32_t* targets, std::size_t count,
+                               std::size_t n){
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 three_half = _mm512_set1_ps(1.5f);
+        const __m512 zero = _mm512_setzero_ps();
+        for (std::size_t t = 0; t < count; t++){
+            std::size_t i = targets[t];
+            __m512 xi = _mm512_set1_ps(x[i]), yi = _mm512_set1_ps(y[i]), zi = _mm512_set1_ps(z[i]);
+            __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+            for (std::size_t j = 0; j < n; j += 16){
+                std::size_t left = n - j;
+                __mmask16 mask = left >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << left) - 1u);
+                __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + j), xi);
+                __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y + j), yi);
+                __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, z + j), zi);
+                __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+                mask = _mm512_mask_cmp_ps_mask(mask, r2, zero, _CMP_GT_OQ);
+                __m512 inv_r = _mm512_maskz_rsqrt14_ps(mask, r2);
+                inv_r = _mm512_mul_ps(inv_r, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv_r, inv_r), three_half));
+                __m512 inv_r2 = _mm512_mul_ps(inv_r, inv_r);
+                __m512 wi = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, mu + j), inv_r2);
+                axi = _mm512_fmadd_ps(wi, _mm512_mul_ps(dx, inv_r), axi);
+                ayi = _mm512_fmadd_ps(wi, _mm512_mul_ps(dy, inv_r), ayi);
+                azi = _mm512_fmadd_ps(wi, _mm512_mul_ps(dz, inv_r), azi);
+            }
+            ax[i] += hsum(axi);
+            ay[i] += hsum(ayi);
+            az[i] += hsum(azi);
+        }
+    }
+#endif
+
+}
+
+//Accumulates the pairs (i, j) with i in [begin, end), j in [col_begin, col_end) and j > i : a block of the upper half
+//of the interaction matrix. Rows are independent for a_i but a row writes a_j for every j of the block.
+inline void accumulate_block_pairs(const float* x, const float* y, const float* z, const float* mu,
+                                   float* ax, float* ay, float* az, std::size_t begin, std::size_t end,
+                                   std::size_t col_begin, std::size_t col_end, SimdLevel level){
+    using namespace gravity_kernel_detail;
+#ifdef GRAVITY_KERNEL_X86
+    switch (level){
+        case SimdLevel::AVX512: pairs_avx512(x, y, z, mu, ax, ay, az, begin, end, col_begin, col_end); return;
+        case SimdLevel::AVX2:   pairs_avx2(x, y, z, mu, ax, ay, az, begin, end, col_begin, col_end); return;
+        case SimdLevel::SSE:    pairs_sse(x, y, z, mu, ax, ay, az, begin, end, col_begin, col_end); return;
+        default: break;
+    }
+#endif
+    pairs_scalar(x, y, z, mu, ax, ay, az, begin, end, col_begin, col_end);
+}
+
+//Accumulates the rows [begin, end) of the all-pairs interaction between the n bodies of the arrays.
+//Rows are independent for a_i but a row writes a_j for every j > i.
+inline void accumulate_pairs(const float* x, const float* y, const float* z, const float* mu,
+                             float* ax, float* ay, float* az, std::size_t begin, std::size_t end, std::size_t n,
+                             SimdLevel level){
+    accumulate_block_pairs(x, y, z, mu, ax, ay, az, begin, end, 0, n, level);
+}
+
+//Accumulates the acceleration of the targets only, from every body of the tile (the targets are not required to be
+//sorted, a target must not be repeated).
+inline void accumulate_targets(GravityTile& tile, const uint32_t* targets, std::size_t count, SimdLevel level){
+    using namespace gravity_kernel_detail;
+    const float* x = tile.x.data(); const float* y = tile.y.data(); const float* z = tile.z.data();
+    const float* mu = tile.mu.data();
+    float* ax = tile.ax.data(); float* ay = tile.ay.data(); float* az = tile.az.data();
+#ifdef GRAVITY_KERNEL_X86
+    switch (level){
+        case SimdLevel::AVX512: targets_avx512(x, y, z, mu, ax, ay, az, targets, count, tile.n); return;
+        case SimdLevel::AVX2:   targets_avx2(x, y, z, mu, ax, ay, az, targets, count, tile.n); return;
+        case SimdLevel::SSE:    targets_sse(x, y, z, mu, ax, ay, az, targets, count, tile.n); return;
+        default: break;
+    }
+#endif
+    targets_scalar(x, y, z, mu, ax, ay, az, targets, count, tile.n);
+}
+
+inline void accumulate_pairs(GravityTile& tile, SimdLevel level){
+    accumulate_pairs(tile.x.data(), tile.y.data(), tile.z.data(), tile.mu.data(),
+                     tile.ax.data(), tile.ay.data(), tile.az.data(), 0, tile.n, tile.n, level);
+}
+
+//Double precision all-pairs evaluation of the tile positions, the reference of the approximate solvers.
+//The 4th component of a body is the sum of the magnitudes of its pair contributions, used to scale the errors.
+inline std::vector<double> reference_accelerations(const GravityTile& tile){
+    std::vector<double> a(4 * tile.n, 0.0);
+    for (std::size_t i = 0; i < tile.n; i++){
+        for (std::size_t j = 0; j < tile.n; j++){
+            if (i == j) continue;
+            double dx = (double)tile.x[j] - tile.x[i];
+            double dy = (double)tile.y[j] - tile.y[i];
+            double dz = (double)tile.z[j] - tile.z[i];
+            double norm = std::sqrt(dx * dx + dy * dy + dz * dz);
+            double acceleration_magnitude = tile.mu[j] / (norm * norm * norm);
+            a[4 * i] += acceleration_magnitude * dx;
+            a[4 * i + 1] += acceleration_magnitude * dy;
+            a[4 * i + 2] += acceleration_magnitude * dz;
+            a[4 * i + 3] += acceleration_magnitude * norm;
+        }
+    }
+    return a;
+}
+
+//Maximum error of tile.ax/ay/az against reference_accelerations().
+inline double max_relative_error(const GravityTile& tile, const std::vector<double>& reference){
+    double error = 0.0;
+    for (std::size_t i = 0; i < tile.n; i++){
+        double ex = tile.ax[i] - reference[4 * i];
+        double ey = tile.ay[i] - reference[4 * i + 1];
+        double ez = tile.az[i] - reference[4 * i + 2];
+        double norm = reference[4 * i + 3];
+        if (norm > 0.0){
+            error = std::max(error, std::sqrt(ex * ex + ey * ey + ez * ez) / norm);
+        }
+    }
+    return error;
+}
+
+#endif
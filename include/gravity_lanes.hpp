@@ -0,0 +1,82 @@
+#ifndef GRAVITY_LANES_HPP
+#define GRAVITY_LANES_HPP
+
+#include "gravity_kernel.hpp"
+
+#include <cmath>
+
+//Arithmetic of the pulls run across lanes (the test particles of test_particles.hpp, the ensemble members of
+//ensemble.hpp) : 1 / |d|^3 with a square root and a division like the interaction list of OrbitalSystem (no reciprocal
+//estimate), 0 for d = 0 (a particle on a source, coincident members), then the products added to the sums. No FMA :
+//the products are rounded like the scalar ones (AVX-512 sums take an explicit rounding, which the compiler never
+//fuses), so every instruction set gives the scalar result.
+namespace gravity_lanes {
+
+    //1 / |d|^3 of d = (dx, dy, dz), in double whatever the precision of the positions.
+    template <typename real>
+    inline double inverse_cube(real dx, real dy, real dz){
+        real norm = std::sqrt(dx * dx + dy * dy + dz * dz);
+        return norm > 0 ? (real)1 / (norm * norm * norm) : (real)0;
+    }
+
+#ifdef GRAVITY_KERNEL_X86
+    __attribute__((target("sse2")))
+    inline __m128d inverse_cube(__m128d dx, __m128d dy, __m128d dz){
+        __m128d norm = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz)));
+        __m128d inv = _mm_div_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_mul_pd(norm, norm), norm));
+        return _mm_and_pd(inv, _mm_cmpgt_pd(norm, _mm_setzero_pd()));
+    }
+    //sum + a * d, sum - a * d
+    __attribute__((target("sse2")))
+    inline __m128d add_product(__m128d sum, __m128d a, __m128d d){
+        return _mm_add_pd(sum, _mm_mul_pd(a, d));
+    }
+    __attribute__((target("sse2")))
+    inline __m128d sub_product(__m128d sum, __m128d a, __m128d d){
+        return _mm_sub_pd(sum, _mm_mul_pd(a, d));
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256d inverse_cube(__m256d dx, __m256d dy, __m256d dz){
+        __m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        __m256d norm = _mm256_sqrt_pd(r2);
+        __m256d inv = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_mul_pd(norm, norm), norm));
+        return _mm256_and_pd(inv, _mm256_cmp_pd(norm, _mm256_setzero_pd(), _CMP_GT_OQ));
+    }
+    __attribute__((target("avx2")))
+    inline __m256d add_product(__m256d sum, __m256d a, __m256d d){
+        return _mm256_add_pd(sum, _mm256_mul_pd(a, d));
+    }
+    __attribute__((target("avx2")))
+    inline __m256d sub_product(__m256d sum, __m256d a, __m256d d){
+        return _mm256_sub_pd(sum, _mm256_mul_pd(a, d));
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512d add_rounded(__m512d a, __m512d b){
+        return _mm512_add_round_pd(a, b, _MM_FROUND_CUR_DIRECTION);
+    }
+    __attribute__((target("avx512f")))
+    inline __m512d sub_rounded(__m512d a, __m512d b){
+        return _mm512_sub_round_pd(a, b, _MM_FROUND_CUR_DIRECTION);
+    }
+    __attribute__((target("avx512f")))
+    inline __m512d inverse_cube(__m512d dx, __m512d dy, __m512d dz){
+        __m512d r2 = add_rounded(add_rounded(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), _mm512_mul_pd(dz, dz));
+        __m512d norm = _mm512_sqrt_pd(r2);
+        __mmask8 nonzero = _mm512_cmp_pd_mask(norm, _mm512_setzero_pd(), _CMP_GT_OQ);
+        return _mm512_maskz_div_pd(nonzero, _mm512_set1_pd(1.0), _mm512_mul_pd(_mm512_mul_pd(norm, norm), norm));
+    }
+    __attribute__((target("avx512f")))
+    inline __m512d add_product(__m512d sum, __m512d a, __m512d d){
+        return add_rounded(sum, _mm512_mul_pd(a, d));
+    }
+    __attribute__((target("avx512f")))
+    inline __m512d sub_product(__m512d sum, __m512d a, __m512d d){
+        return sub_rounded(sum, _mm512_mul_pd(a, d));
+    }
+#endif
+
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef KEPLER_ORBIT_HPP
+#define KEPLER_ORBIT_HPP
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "body_store.hpp"
+
+//Classical elements of an elliptic orbit. Angles in radians, the reference plane is z = 0 and the reference direction x.
+struct OrbitalElements {
+    double semi_major_axis;
+    double eccentricity;
+    double inclination;
+    double ascending_node;      //Longitude of the ascending node, 0 for an orbit in the reference plane
+    double periapsis_argument;  //From the ascending node (from x when the orbit is in the reference plane)
+    double mean_anomaly;        //At the epoch
+    double mean_motion;         //rad/s
+    double epoch;               //s
+};
+
+//Closed form propagation of sun-centered two-body orbits (Planet in Kepler mode).
+//The initial state of an orbit is turned into elements once by add(). evaluate(t) then gives the position of every orbit
+//at any time t, as far as wanted, by solving Kepler's equation M = E - e sin(E) : the cost does not depend on t.
+//Orbits are kept as structure of arrays and evaluate() runs the same instructions for each of them : no library call
+//(sin/cos are series), no branch, a fixed number of Newton iterations, so the loops over the orbits are vectorized by the
+//compiler.
+//Only bound orbits (e < 1) are supported, add() throws for the others.
+class KeplerOrbits {
+    public:
+        static constexpr int NEWTON_ITERATIONS = 6; //Converged to the double precision for e <= 0.95
+
+        //Position of every orbit at the last evaluate()
+        aligned_vector<double> x, y, z;
+
+        //Whether a body at position r and velocity v relative to the central body is on an elliptic orbit.
+        static bool is_bound(const glm::dvec3& r, const glm::dvec3& v, double mu){
+            return 0.5 * glm::dot(v, v) - mu / glm::length(r) < 0.0;
+        }
+
+        std::size_t size() const {
+            return _a.size();
+        }
+
+        //Orbit of a body at position r and velocity v (relative to the central body) at time epoch, mu = G * M.
+        std::size_t add(const glm::dvec3& r, const glm::dvec3& v, double mu, double epoch = 0.0){
+            double radius = glm::length(r);
+            double a = 1.0 / (2.0 / radius - glm::dot(v, v) / mu);
+            glm::dvec3 h = glm::cross(r, v);
+            glm::dvec3 e_vec = glm::cross(v, h) / mu - r / radius;
+            double e = glm::length(e_vec);
+            if (!(a > 0.0) || !(e < 1.0)){
+                throw std::invalid_argument("Kepler propagation needs a bound orbit (eccentricity < 1)");
+            }
+            //Perifocal frame : P toward the periapsis, Q at 90 degrees in the direction of motion. On a circular orbit
+            //the periapsis is the initial position.
+            glm::dvec3 P = e > 1e-12 ? e_vec / e : r / radius;
+            glm::dvec3 Q = glm::normalize(glm::cross(h, P));
+            //e sin(E) = r.v / sqrt(mu a), e cos(E) = 1 - r / a
+            double E = std::atan2(glm::dot(r, v) / std::sqrt(mu * a), 1.0 - radius / a);
+            _a.push_back(a);
+            _e.push_back(e);
+            _b.push_back(a * std::sqrt(1.0 - e * e));
+            _n.push_back(std::sqrt(mu / (a * a * a)));
+            _m0.push_back(E - e * std::sin(E));
+            _epoch.push_back(epoch);
+            for (int c = 0; c < 3; c++){
+                _p[c].push_back(P[c]);
+                _q[c].push_back(Q[c]);
+            }
+            x.push_back(r.x);
+            y.push_back(r.y);
+            z.push_back(r.z);
+            return _a.size() - 1;
+        }
+
+        OrbitalElements get_elements(std::size_t i) const {
+            OrbitalElements elements;
+            elements.semi_major_axis = _a[i];
+            elements.eccentricity = _e[i];
+            elements.mean_anomaly = _m0[i];
+            elements.mean_motion = _n[i];
+            elements.epoch = _epoch[i];
+            glm::dvec3 P(_p[0][i], _p[1][i], _p[2][i]), Q(_q[0][i], _q[1][i], _q[2][i]);
+            glm::dvec3 W = glm::cross(P, Q); //Orbit normal
+            elements.inclination = std::acos(std::max(-1.0, std::min(1.0, W.z)));
+            elements.ascending_node = std::atan2(W.x, -W.y);
+            if (std::hypot(W.x, W.y) < 1e-12){
+                elements.ascending_node = 0.0;
+                elements.periapsis_argument = std::atan2(P.y, P.x) * (W.z < 0.0 ? -1.0 : 1.0);
+            }
+            else {
+                glm::dvec3 node(std::cos(elements.ascending_node), std::sin(elements.ascending_node), 0.0);
+                elements.periapsis_argument = std::atan2(glm::dot(glm::cross(node, P), W), glm::dot(node, P));
+            }
+            return elements;
+        }
+
+        glm::dvec3 get_position(std::size_t i) const {
+            return {x[i], y[i], z[i]};
+        }
+
+        //Positions of every orbit at time t.
+        //Each pass is a loop over the orbits without branch nor call, reading and writing few enough arrays for the
+        //compiler to vectorize it (the aliasing checks are limited).
+        void evaluate(double t){
+            std::size_t n = _a.size();
+            for (auto* array : {&_sin_m, &_cos_m, &_d, &_sin_e, &_cos_e}){array->resize(n);}
+            for (std::size_t i = 0; i < n; i++){
+                //Mean anomaly in [-pi, pi]
+                double M = _m0[i] + _n[i] * (t - _epoch[i]);
+                M -= TWO_PI * round_nearest(M * (1.0 / TWO_PI));
+                M = clamp(M, -M_PI, M_PI);
+                //sin and cos of M from its half angle, |M / 2| <= pi / 2 where the series are accurate.
+                double s_half, c_half;
+                sincos_series(0.5 * M, s_half, c_half);
+                _sin_m[i] = 2.0 * s_half * c_half;
+                _cos_m[i] = c_half * c_half - s_half * s_half;
+            }
+            //Newton on d = E - M, which is e sin(E) so in [-e, e] : sin(E) and cos(E) are rotations of the ones of M by
+            //d, a small angle. Starts from E = M + e sin(M) / (1 - e cos(M)).
+            for (std::size_t i = 0; i < n; i++){
+                _d[i] = clamp(_e[i] * _sin_m[i] / (1.0 - _e[i] * _cos_m[i]), -_e[i], _e[i]);
+            }
+            for (int iteration = 0; iteration < NEWTON_ITERATIONS; iteration++){
+                for (std::size_t i = 0; i < n; i++){
+                    double e = _e[i], sin_e, cos_e;
+                    rotate(_sin_m[i], _cos_m[i], _d[i], sin_e, cos_e);
+                    _d[i] = clamp(_d[i] - (_d[i] - e * sin_e) / (1.0 - e * cos_e), -e, e);
+                }
+            }
+            for (std::size_t i = 0; i < n; i++){
+                rotate(_sin_m[i], _cos_m[i], _d[i], _sin_e[i], _cos_e[i]);
+            }
+            //Position a (cos(E) - e) P + b sin(E) Q, one coordinate at a time.
+            aligned_vector<double>* coordinates[3] = {&x, &y, &z};
+            for (int c = 0; c < 3; c++){
+                aligned_vector<double>& out = *coordinates[c];
+                const aligned_vector<double>& P = _p[c];
+                const aligned_vector<double>& Q = _q[c];
+                for (std::size_t i = 0; i < n; i++){
+                    out[i] = _a[i] * (_cos_e[i] - _e[i]) * P[i] + _b[i] * _sin_e[i] * Q[i];
+                }
+            }
+        }
+
+    private:
+        static constexpr double TWO_PI = 2.0 * M_PI;
+
+        aligned_vector<double> _a, _e, _b, _n, _m0, _epoch; //Semi-major and minor axis, eccentricity, mean motion
+        aligned_vector<double> _p[3], _q[3];                //Perifocal frame
+        aligned_vector<double> _sin_m, _cos_m, _d, _sin_e, _cos_e; //Kepler solve of evaluate()
+
+        static double round_nearest(double value){
+            //Adding and removing 1.5 * 2^52 rounds to the nearest integer with plain arithmetic (|value| < 2^51).
+            const double shift = 6755399441055744.0;
+            return (value + shift) - shift;
+        }
+        //By value, std::min and std::max select references which are not vectorized.
+        static double clamp(double value, double low, double high){
+            return value < low ? low : (value > high ? high : value);
+        }
+        //sin(E) and cos(E) for E = M + d.
+        static void rotate(double sin_m, double cos_m, double d, double& sin_e, double& cos_e){
+            double s_d, c_d;
+            sincos_series(d, s_d, c_d);
+            sin_e = sin_m * c_d + cos_m * s_d;
+            cos_e = cos_m * c_d - sin_m * s_d;
+        }
+        //Taylor series of sin and cos in Horner form, accurate to the double precision for |x| <= pi / 2.
+        static void sincos_series(double x, double& s, double& c){
+            double x2 = x * x;
+            s = 1.0; c = 1.0;
+            for (int k = 21; k >= 3; k -= 2){s = 1.0 - x2 * (1.0 / (k * (k - 1))) * s;}
+            for (int k = 22; k >= 2; k -= 2){c = 1.0 - x2 * (1.0 / (k * (k - 1))) * c;}
+            s *= x;
+        }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Maps a whole file read only : pages are only read from the disk when touched, and dropped by the OS under memory
+//pressure. The mapping lives as long as the returned pointer (and its copies), size is set to the file size.
+//Throws std::runtime_error if the file can't be opened or is empty.
+inline std::shared_ptr<const unsigned char> map_file(const std::string& path, std::size_t& size){
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE){throw std::runtime_error("ERROR::MAPPED_FILE::FILE_NOT_OPENED " + path);}
+    LARGE_INTEGER length;
+    GetFileSizeEx(file, &length);
+    HANDLE mapping = length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!mapping){throw std::runtime_error("ERROR::MAPPED_FILE::FILE_NOT_MAPPED " + path);}
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view){throw std::runtime_error("ERROR::MAPPED_FILE::FILE_NOT_MAPPED " + path);}
+    size = (std::size_t)length.QuadPart;
+    return std::shared_ptr<const unsigned char>(static_cast<const unsigned char*>(view),
+                                                [](const unsigned char* p){UnmapViewOfFile(p);});
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0){throw std::runtime_error("ERROR::MAPPED_FILE::FILE_NOT_OPENED " + path);}
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0){
+        view = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file);
+    if (view == MAP_FAILED){throw std::runtime_error("ERROR::MAPPED_FILE::FILE_NOT_MAPPED " + path);}
+    std::size_t length = (std::size_t)info.st_size;
+    size = length;
+    return std::shared_ptr<const unsigned char>(static_cast<const unsigned char*>(view),
+                                                [length](const unsigned char* p){munmap((void*)p, length);});
+#endif
+}
+
+#endif
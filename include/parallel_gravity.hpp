@@ -0,0 +1,76 @@
+#ifndef PARALLEL_GRAVITY_HPP
+#define PARALLEL_GRAVITY_HPP
+
+#include "gravity_kernel.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+//Multithreaded all-pairs evaluation, bit-identical whatever the number of threads.
+//
+//The upper half of the interaction matrix is cut in tiles of TILE_SIZE x TILE_SIZE bodies. The row of tiles I
+//(rows [I * TILE_SIZE, (I + 1) * TILE_SIZE), every column J >= I) belongs to the lane I % LANE_COUNT. A lane runs its
+//tiles in a fixed order and accumulates into its own buffers, so threads never write to the same acceleration.
+//The buffers are then summed lane by lane, in lane order, for each body.
+//The split only depends on the number of bodies : the lanes are the unit of work given to the threads, a thread
+//count change moves whole lanes between threads and keeps every sum in the same order.
+//The buffers take LANE_COUNT * 12 bytes per body, with fewer bodies than one tile the result is the one of
+//accumulate_pairs().
+class ParallelGravity {
+    public:
+        static constexpr std::size_t TILE_SIZE = 256;
+        static constexpr std::size_t LANE_COUNT = 64;    //Twice the cores of a 32 cores machine, for the load balance
+        static constexpr std::size_t REDUCE_CHUNK = 4096; //Bodies per task of the final sum
+
+        void accumulate(GravityTile& tile, SimdLevel level, ThreadPool& pool = ThreadPool::instance()){
+            std::size_t n = tile.n;
+            if (n == 0){return;}
+            std::size_t blocks = (n + TILE_SIZE - 1) / TILE_SIZE;
+            std::size_t lanes = std::min(LANE_COUNT, blocks);
+            if (_ax.size() < lanes * n){
+                _ax.resize(lanes * n);
+                _ay.resize(lanes * n);
+                _az.resize(lanes * n);
+            }
+
+            pool.run(lanes, [&](std::size_t lane){
+                //Rows before the first tile of the lane are never written.
+                std::size_t first = lane * TILE_SIZE;
+                float* ax = &_ax[lane * n];
+                float* ay = &_ay[lane * n];
+                float* az = &_az[lane * n];
+                std::fill(ax + first, ax + n, 0.0f);
+                std::fill(ay + first, ay + n, 0.0f);
+                std::fill(az + first, az + n, 0.0f);
+                for (std::size_t I = lane; I < blocks; I += lanes){
+                    std::size_t row_begin = I * TILE_SIZE, row_end = std::min(n, row_begin + TILE_SIZE);
+                    for (std::size_t J = I; J < blocks; J++){
+                        std::size_t col_begin = J * TILE_SIZE, col_end = std::min(n, col_begin + TILE_SIZE);
+                        accumulate_block_pairs(tile.x.data(), tile.y.data(), tile.z.data(), tile.mu.data(),
+                                               ax, ay, az, row_begin, row_end, col_begin, col_end, level);
+                    }
+                }
+            });
+
+            pool.run((n + REDUCE_CHUNK - 1) / REDUCE_CHUNK, [&](std::size_t chunk){
+                std::size_t begin = chunk * REDUCE_CHUNK, end = std::min(n, begin + REDUCE_CHUNK);
+                for (std::size_t i = begin; i < end; i++){
+                    float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+                    for (std::size_t lane = 0; lane < lanes && lane * TILE_SIZE <= i; lane++){
+                        sx += _ax[lane * n + i];
+                        sy += _ay[lane * n + i];
+                        sz += _az[lane * n + i];
+                    }
+                    tile.ax[i] += sx;
+                    tile.ay[i] += sy;
+                    tile.az[i] += sz;
+                }
+            });
+        }
+
+    private:
+        aligned_vector<float> _ax, _ay, _az; //Lane buffers, lane l is [l * n, (l + 1) * n)
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef PHYSICS_THREAD_HPP
+#define PHYSICS_THREAD_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "celestial_body.hpp"
+#include "checkpoint.hpp"
+#include "trajectory_recorder.hpp"
+#include "position_snapshot.hpp"
+#include "triple_buffer.hpp"
+
+//Steps an OrbitalSystem on its own thread, in real time times a multiplier, and publishes its positions through a
+//triple buffer : the render thread takes the latest complete state without ever waiting for the physics, and the
+//physics never waits for a frame.
+//Once started, the system (and its store) belongs to this thread until stop() : the render thread must only draw from
+//latest() (render_system() with a snapshot).
+class PhysicsThread {
+    public:
+        static constexpr int MAX_BACKLOG_STEPS = 4096;   //Simulated time is dropped beyond, instead of piling up
+        static constexpr double PUBLISH_INTERVAL = 0.004; //s, at most between two snapshots during a long batch
+
+        PhysicsThread(OrbitalSystem& system, float time_multiplier) : _system(system), _time_multiplier(time_multiplier){}
+        ~PhysicsThread(){
+            stop();
+        }
+        PhysicsThread(const PhysicsThread&) = delete;
+        PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+        void start(){
+            if (_thread.joinable()){return;}
+            //First snapshot published before the thread starts : latest() is valid from the first frame.
+            publish();
+            _running.store(true);
+            _thread = std::thread([this](){run();});
+        }
+        void stop(){
+            _running.store(false);
+            if (_thread.joinable()){_thread.join();}
+            if (_checkpoint_requested.load()){take_checkpoint();} //Requested too late for the thread
+        }
+        bool is_running() const {
+            return _thread.joinable();
+        }
+
+        //Simulated seconds per real second, can be changed while running.
+        void set_time_multiplier(float multiplier){
+            _time_multiplier.store(multiplier);
+        }
+        float get_time_multiplier() const {
+            return _time_multiplier.load();
+        }
+
+        //Time and step count of a restored state (Checkpoint::get_time(), get_steps()), before start().
+        void set_clock(double time, uint64_t steps){
+            _time = time;
+            _steps = steps;
+        }
+
+        //Records the positions after each step (see trajectory_recorder.hpp), nullptr to stop. Before start().
+        void set_recorder(TrajectoryRecorder* recorder){
+            _recorder = recorder;
+        }
+
+        //Checkpoint of the system saved to path : captured between two steps by the physics thread (the simulation
+        //only stops for the copy of the store), written by a background thread. Immediate if the thread is stopped.
+        void request_checkpoint(const std::string& path){
+            {
+                std::lock_guard<std::mutex> lock(_checkpoint_mutex);
+                _checkpoint_path = path;
+            }
+            _checkpoint_requested.store(true);
+            if (!_thread.joinable()){take_checkpoint();}
+        }
+        //Blocks until the requested checkpoints are on disk.
+        void wait_checkpoints(){
+            _writer.wait();
+        }
+
+        //Latest published state, for the render thread only. Never blocks.
+        const PositionSnapshot& latest(){
+            _snapshots.update();
+            return _snapshots.read_buffer();
+        }
+
+    private:
+        OrbitalSystem& _system;
+        std::atomic<float> _time_multiplier;
+        std::atomic<bool> _running{false};
+        std::thread _thread;
+        TripleBuffer<PositionSnapshot> _snapshots;
+        std::atomic<bool> _checkpoint_requested{false};
+        std::mutex _checkpoint_mutex;
+        std::string _checkpoint_path;
+        CheckpointWriter _writer;
+        TrajectoryRecorder* _recorder = nullptr;
+
+        //Only touched by the physics thread once started
+        double _time = 0.0;
+        uint64_t _steps = 0;
+        double _rate = 0.0;
+
+        void run(){
+            using clock = std::chrono::steady_clock;
+            auto last = clock::now();
+            auto last_publish = last;
+            auto rate_start = last;
+            uint64_t rate_steps = 0;
+            double accumulator = 0.0;
+            while (_running.load(std::memory_order_relaxed)){
+                auto now = clock::now();
+                accumulator += std::chrono::duration<double>(now - last).count() * _time_multiplier.load();
+                last = now;
+                //If the physics can't keep up, the simulation slows down instead of lagging more and more.
+                accumulator = std::min(accumulator, (double)MAX_BACKLOG_STEPS * dt);
+                if (accumulator < dt){
+                    //Sleeps until the next step is due, a few ms at most to stay responsive to stop().
+                    double wait = (dt - accumulator) / std::max(_time_multiplier.load(), 1e-6f);
+                    std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.005)));
+                    continue;
+                }
+                while (accumulator >= dt && _running.load(std::memory_order_relaxed)){
+                    _system.step();
+                    accumulator -= dt;
+                    _time += dt;
+                    _steps++;
+                    rate_steps++;
+                    if (_recorder){_recorder->record(_system.get_store(), _time, _steps);}
+                    if (std::chrono::duration<double>(clock::now() - last_publish).count() >= PUBLISH_INTERVAL){break;}
+                }
+                now = clock::now();
+                double elapsed = std::chrono::duration<double>(now - rate_start).count();
+                if (elapsed >= 0.5){
+                    _rate = rate_steps / elapsed;
+                    rate_start = now;
+                    rate_steps = 0;
+                }
+                if (_checkpoint_requested.load(std::memory_order_relaxed)){take_checkpoint();}
+                publish();
+                last_publish = now;
+            }
+        }
+        void take_checkpoint(){
+            std::string path;
+            {
+                std::lock_guard<std::mutex> lock(_checkpoint_mutex);
+                path = _checkpoint_path;
+                _checkpoint_requested.store(false);
+            }
+            _writer.write(Checkpoint::capture(_system, _time, _steps), path);
+        }
+        void publish(){
+            PositionSnapshot& snapshot = _snapshots.write_buffer();
+            _system.capture(snapshot);
+            snapshot.time = _time;
+            snapshot.steps = _steps;
+            snapshot.steps_per_second = _rate;
+            _snapshots.publish();
+        }
+};
+
+#endif
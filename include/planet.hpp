@@ -2,6 +2,7 @@
 #define PLANET_HPP
 
 #include "sphere.hpp"
+#include "kepler_orbit.hpp"
 #include <vector>
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -19,14 +20,37 @@ class Planet{
                 const char * fragmentShader = "../shaders/sphere/sphere.fs") : 
         _r(r0), _v(v0), _radius(radius), _orbitFlag(compute_orbit), _T_revolution(T_revolution),
         _sphere(radius, color,glm::make_vec3(r0.data()), vertexShader, fragmentShader),
-        _orbitShader("../shaders/orbit/orbit.vs", "../shaders/orbit/orbit.fs") {
+        _orbitShader(ShaderRegistry::instance().get("../shaders/orbit/orbit.vs", "../shaders/orbit/orbit.fs")) {
             setup_init_condition();
         }
 
         std::vector<float> get_pos(){
+            if (_orbits != nullptr){
+                glm::dvec3 r = _orbits->get_position(_orbit_index);
+                return {(float)r.x, (float)r.y, (float)r.z};
+            }
             return _r;
         }
 
+        //Kepler mode : the position is no longer integrated by compute_step() but read from the closed form orbit,
+        //registered in orbits from the initial position and velocity, at the time of the last orbits.evaluate().
+        //_v is only the initial velocity : call it before any compute_step().
+        //Returns false, and stays in step mode, if the planet is not bound to the sun.
+        bool use_kepler(KeplerOrbits& orbits, double epoch = 0.0){
+            glm::dvec3 r(_r[0], _r[1], _r[2]), v(_v[0], _v[1], _v[2]);
+            double mu = (double)_G * _M;
+            if (!KeplerOrbits::is_bound(r, v, mu)){
+                std::cout << "ERROR::PLANET::ORBIT_NOT_BOUND" << std::endl;
+                return false;
+            }
+            _orbit_index = orbits.add(r, v, mu, epoch);
+            _orbits = &orbits;
+            return true;
+        }
+        bool is_kepler() const {
+            return _orbits != nullptr;
+        }
+
         Sphere& get_sphere(){
             return _sphere;
         }
@@ -45,22 +69,21 @@ class Planet{
             _r_prev = _r;
             _r = _r_new;
         }
-        void render_orbit(glm::mat4 view, glm::mat4 projection){
-            _orbitShader.use();
-            _orbitShader.setMat4("model", glm::mat4(1.0f));
-            _orbitShader.setMat4("view", view);
-            _orbitShader.setMat4("projection", projection);
+        void render_orbit(){
+            _orbitShader->use();
+            _orbitShader->setMat4("model", glm::mat4(1.0f));
             glBindVertexArray(_orbitVAO);
             glDrawArrays(GL_POINTS,0,_orbit.size() / 3);
         }
-        void render(glm::mat4 view, glm::mat4 projection, glm::vec3 Pos){
+        //Camera and light from their uniform blocks (see uniform_buffer.hpp), updated once per frame.
+        void render(glm::vec3 Pos){
             _sphere.set_position(Pos);
             //_sphere.set_rotation(_angle, glm::vec3(0.0f, 1.0f, 0.0f));
             //_angle += _omega * dt;
             //if (_angle >= 360.0f) _angle = 0.0f;
-            _sphere.render(view, projection);
+            _sphere.render();
             if (_orbitFlag){
-                render_orbit(view, projection);
+                render_orbit();
             }
         }
 
@@ -76,6 +99,9 @@ class Planet{
 
         bool _orbitFlag = false;
 
+        KeplerOrbits* _orbits = nullptr; //Kepler mode
+        std::size_t _orbit_index = 0;
+
         std::vector<float> _r_prev;
         std::vector<float> _r_new;
         std::vector<float> _a_new;
@@ -87,7 +113,7 @@ class Planet{
 
         unsigned int _orbitVAO;
         unsigned int _orbitVBO;
-        Shader _orbitShader;
+        std::shared_ptr<Shader> _orbitShader;
         std::vector<float> _orbit;
 
         void setup_init_condition(){
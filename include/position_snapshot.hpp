@@ -0,0 +1,32 @@
+#ifndef POSITION_SNAPSHOT_HPP
+#define POSITION_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "body_store.hpp"
+
+//Positions of every body of a BodyStore at one step, all the rendering needs : the render thread draws from a
+//snapshot while the physics thread keeps stepping the store (see physics_thread.hpp).
+struct PositionSnapshot {
+    std::vector<glm::vec3> positions; //By store id, in m, rounded to float for the rendering
+    double time = 0.0;                //Simulated time, s
+    uint64_t steps = 0;               //Steps done since the start
+    double steps_per_second = 0.0;    //Recent simulation rate
+
+    void capture(const BodyStore& store){
+        //Same size every time once the bodies are added : no allocation.
+        positions.resize(store.size());
+        for (std::size_t i = 0; i < store.size(); i++){
+            positions[i] = glm::vec3((float)store.x[i], (float)store.y[i], (float)store.z[i]);
+        }
+    }
+    glm::vec3 get_pos(std::size_t id) const {
+        return id < positions.size() ? positions[id] : glm::vec3(0.0f);
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RENDERED_SCENE_HPP
+#define RENDERED_SCENE_HPP
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "celestial_object.hpp"
+#include "scene_file.hpp"
+#include "sphere_instances.hpp"
+#include "stream_buffer.hpp"
+
+//Scene file (see scene_file.hpp) loaded for the rendering : the physics tree of the bodies, and the GL resources
+//drawing them. The bodies of a material are the instances of one SphereInstances (its program from the
+//ShaderRegistry, compiled with INSTANCED), all drawn by one call on the process-wide unit sphere mesh. The light of
+//the file is uploaded once to the Light block. The positions are streamed each frame through one StreamBuffer shared
+//by the materials. Loading costs a few programs plus 8 bytes per body on the GPU (and 3 x 12 in the ring) : 100k
+//asteroids are drawn as spheres in a few draw calls. Needs a GL context, throws std::runtime_error like
+//SceneFile::load().
+class RenderedScene {
+    public:
+        explicit RenderedScene(const std::string& path) : _file(SceneFile::load(path)),
+        _stream(GL_ARRAY_BUFFER, _file.bodies.size() * sizeof(glm::vec3) + _file.materials.size() * 16),
+        _light(LIGHT_BLOCK_BINDING, light_block(_file.light)){
+            _by_material.resize(_file.materials.size());
+            for (const SceneMaterial& material : _file.materials){
+                std::shared_ptr<Shader> shader = ShaderRegistry::instance().get(
+                    material.vertex_shader, material.fragment_shader, {"INSTANCED"});
+                if (std::find(_programs.begin(), _programs.end(), shader) == _programs.end()){
+                    _programs.push_back(shader);
+                }
+                _instances.push_back(std::make_unique<SphereInstances>(std::move(shader)));
+                _instances.back()->set_material(material.specular_strength, material.shininess);
+            }
+            std::vector<std::size_t> counts(_file.materials.size(), 0);
+            for (const SceneBody& body : _file.bodies){counts[body.material]++;}
+            for (std::size_t m = 0; m < counts.size(); m++){
+                _instances[m]->reserve(counts[m]);
+                _by_material[m].reserve(counts[m]);
+            }
+            _file.build(_system, _bodies, _subsystems, [this](const SceneBody& body){
+                auto object = std::make_unique<CelestialBody>(
+                    std::vector<float>{body.position.x, body.position.y, body.position.z},
+                    std::vector<float>{body.velocity.x, body.velocity.y, body.velocity.z}, body.radius, body.mass);
+                _instances[body.material]->add(body.display_radius, body.color);
+                _by_material[body.material].push_back({object.get(), body.display_scale});
+                return object;
+            });
+        }
+
+        //One instanced draw per material. The camera comes from the Camera block, the light of the file from the
+        //Light block. Positions from snapshot, like render_system() : the display positions are written straight into
+        //the range of each material in the ring, no copy in between. The scene enables no collisions : a body merged
+        //away by the caller would still be drawn.
+        void render(const PositionSnapshot& snapshot){
+            _stream.begin_frame();
+            for (std::size_t m = 0; m < _instances.size(); m++){
+                const std::vector<Instance>& instances = _by_material[m];
+                if (instances.empty()){continue;}
+                StreamBuffer::Range range = _stream.allocate(instances.size() * sizeof(glm::vec3));
+                glm::vec3* positions = (glm::vec3*)range.data;
+                if (positions == nullptr){continue;}
+                for (std::size_t k = 0; k < instances.size(); k++){
+                    CelestialBody* body = instances[k].body;
+                    CelestialBody* center = body->get_orbitalCenter();
+                    glm::vec3 pos = body->get_store() ? snapshot.get_pos(body->get_id()) : body->get_pos();
+                    glm::vec3 center_pos = center != nullptr ? snapshot.get_pos(center->get_id()) : glm::vec3(0.0f);
+                    positions[k] = display_position(*body, pos, center_pos, instances[k].display_scale);
+                }
+                _stream.commit(range);
+                _instances[m]->draw(_stream.get_buffer(), range.offset);
+            }
+            _stream.end_frame();
+        }
+
+        OrbitalSystem& get_system(){
+            return _system;
+        }
+        const SceneFile& get_file() const {
+            return _file;
+        }
+        std::size_t get_body_count() const {
+            return _bodies.size();
+        }
+        std::size_t get_program_count() const {
+            return _programs.size();
+        }
+        //Draw calls of a frame : the materials with bodies.
+        std::size_t get_draw_count() const {
+            std::size_t count = 0;
+            for (const auto& set : _instances){count += set->size() > 0 ? 1 : 0;}
+            return count;
+        }
+
+    private:
+        struct Instance {
+            CelestialBody* body;
+            float display_scale;
+        };
+
+        SceneFile _file;
+        std::vector<std::shared_ptr<Shader>> _programs; //Distinct ones
+        std::vector<std::unique_ptr<SphereInstances>> _instances; //By material
+        std::vector<std::vector<Instance>> _by_material; //In the order of the instances
+        StreamBuffer _stream; //Positions of the instances, one range per material and frame
+        UniformBuffer<LightBlock> _light;
+        OrbitalSystem _system;
+        std::vector<std::shared_ptr<OrbitalSystem>> _subsystems;
+        std::vector<std::unique_ptr<CelestialBody>> _bodies;
+
+        static LightBlock light_block(const SceneLight& light){
+            LightBlock block;
+            block.position = light.position;
+            block.ambient = light.ambient;
+            block.diffuse = light.diffuse;
+            block.specular = light.specular;
+            block.constant = light.constant;
+            block.linear = light.linear;
+            block.quadratic = light.quadratic;
+            return block;
+        }
+};
+
+#endif
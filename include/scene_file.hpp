@@ -0,0 +1,276 @@
+#ifndef SCENE_FILE_HPP
+#define SCENE_FILE_HPP
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "mapped_file.hpp"
+
+//Light of the lit materials (Light block of the shaders, see uniform_buffer.hpp).
+struct SceneLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 ambient = glm::vec3(0.2f);
+    glm::vec3 diffuse = glm::vec3(1.0f, 1.0f, 0.95f);
+    glm::vec3 specular = glm::vec3(1.0f);
+    float constant = 1.0f;
+    float linear = 0.5f;
+    float quadratic = 0.25f;
+};
+
+//Shader program of a body and its uniforms.
+struct SceneMaterial {
+    std::string name;
+    std::string vertex_shader;
+    std::string fragment_shader;
+    float specular_strength = 0.0f;
+    float shininess = 1.0f;
+};
+
+struct SceneBody {
+    std::string name;       //Empty for the bodies of a belt
+    int32_t parent = -1;    //Index of the body orbited, -1 for the center of the scene
+    glm::vec3 position;     //m
+    glm::vec3 velocity;     //m/s
+    float mass;             //kg
+    float radius;           //m
+    float display_radius;   //Rendering units
+    glm::vec3 color;
+    uint32_t material;      //Index in SceneFile::materials
+    float display_scale = SCALE; //Of the distance of a satellite to its center, for the rendering
+    bool fixed = false;     //Center which does not move
+};
+
+//Scene read from a text file, without any GL : the bodies, their hierarchy, the materials and the light. One directive
+//per line, # starts a comment :
+//  light x y z  ambient(r g b)  diffuse(r g b)  specular(r g b)  constant linear quadratic
+//  material name vertex_shader fragment_shader specular_strength shininess
+//  body name parent x y z vx vy vz mass radius display_radius r g b material [display_scale]
+//  belt count parent inner outer log_mass_min log_mass_max radius display_radius r g b material seed
+//  fixed name
+//SI units (m, m/s, kg) but the radii of a belt (AU), display radius in rendering units (see CelestialObject).
+//parent is - for the center of the scene, the bodies orbiting it may have satellites (they are then the center of a
+//subsystem), satellites may not. A material or a parent is declared before the bodies using it (- is the center for a
+//belt).
+//belt : count bodies on circular orbits around parent, at a distance uniform in [inner, outer], an angle uniform in the
+//plane z = 0, a mass of 10^uniform(log_mass_min, log_mass_max) (the asteroids of build_scene).
+//The file is mapped and parsed in one pass, numbers without any allocation : 100k bodies (10 MB) in ~0.1 s.
+class SceneFile {
+    public:
+        SceneLight light;
+        std::vector<SceneMaterial> materials;
+        std::vector<SceneBody> bodies;
+
+        //Throws std::runtime_error if the file can't be read or has an error (with its line).
+        static SceneFile load(const std::string& path){
+            std::size_t size = 0;
+            std::shared_ptr<const unsigned char> data = map_file(path, size);
+            return parse(reinterpret_cast<const char*>(data.get()), size, path);
+        }
+        static SceneFile parse(const char* text, std::size_t size, const std::string& source = "scene"){
+            SceneFile scene;
+            std::unordered_map<std::string_view, uint32_t> body_index;
+            std::size_t lines = (std::size_t)std::count(text, text + size, '\n') + 1;
+            scene.bodies.reserve(lines);
+            body_index.reserve(lines);
+            std::vector<std::string_view> tokens;
+            std::size_t line = 0;
+            auto fail = [&](const char* error){
+                throw std::runtime_error(std::string("ERROR::SCENE_FILE::") + error + " " + source + ":" +
+                                         std::to_string(line));
+            };
+            auto number = [&](std::size_t k){
+                float value = 0.0f;
+                std::string_view token = tokens[k];
+                auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+                if (result.ec != std::errc() || result.ptr != token.data() + token.size()){fail("INVALID_NUMBER");}
+                return value;
+            };
+            auto integer = [&](std::size_t k){
+                uint32_t value = 0;
+                std::string_view token = tokens[k];
+                auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+                if (result.ec != std::errc() || result.ptr != token.data() + token.size()){fail("INVALID_INTEGER");}
+                return value;
+            };
+            auto vec = [&](std::size_t k){return glm::vec3(number(k), number(k + 1), number(k + 2));};
+            auto material_of = [&](std::size_t k){
+                //A few materials : a linear search is faster than a hash.
+                for (std::size_t m = 0; m < scene.materials.size(); m++){
+                    if (scene.materials[m].name == tokens[k]){return (uint32_t)m;}
+                }
+                fail("UNKNOWN_MATERIAL");
+                return (uint32_t)0;
+            };
+            auto parent_of = [&](std::size_t k){
+                if (tokens[k] == "-"){
+                    if (scene._center >= 0){fail("SECOND_CENTER");}
+                    return (int32_t)-1;
+                }
+                auto found = body_index.find(tokens[k]);
+                if (found == body_index.end()){fail("UNKNOWN_PARENT");}
+                int32_t parent = (int32_t)found->second;
+                if (scene.bodies[parent].parent >= 0 && scene.bodies[scene.bodies[parent].parent].parent >= 0){
+                    fail("SATELLITE_OF_A_SATELLITE");
+                }
+                return parent;
+            };
+
+            const char* end = text + size;
+            for (const char* p = text; p < end;){
+                line++;
+                const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                if (!eol){eol = end;}
+                const char* comment = static_cast<const char*>(std::memchr(p, '#', eol - p));
+                split(p, comment ? comment : eol, tokens);
+                p = eol + 1;
+                if (tokens.empty()){continue;}
+
+                std::string_view directive = tokens[0];
+                if (directive == "body"){
+                    if (tokens.size() != 16 && tokens.size() != 17){fail("BODY_NEEDS_15_OR_16_VALUES");}
+                    SceneBody body;
+                    body.parent = parent_of(2);
+                    if (!body_index.emplace(tokens[1], (uint32_t)scene.bodies.size()).second){fail("DUPLICATE_BODY");}
+                    body.name = std::string(tokens[1]);
+                    body.position = vec(3);
+                    body.velocity = vec(6);
+                    body.mass = number(9);
+                    body.radius = number(10);
+                    body.display_radius = number(11);
+                    body.color = vec(12);
+                    body.material = material_of(15);
+                    if (tokens.size() == 17){body.display_scale = number(16);}
+                    if (body.parent < 0){scene._center = (int32_t)scene.bodies.size();}
+                    scene.bodies.push_back(std::move(body));
+                }
+                else if (directive == "belt"){
+                    if (tokens.size() != 14){fail("BELT_NEEDS_13_VALUES");}
+                    int32_t parent = tokens[2] == "-" ? scene._center : parent_of(2);
+                    if (parent < 0){fail("NO_CENTER");}
+                    scene.add_belt(integer(1), parent, number(3), number(4), number(5), number(6), number(7),
+                                   number(8), vec(9), material_of(12), integer(13));
+                }
+                else if (directive == "material"){
+                    if (tokens.size() != 6){fail("MATERIAL_NEEDS_5_VALUES");}
+                    for (const SceneMaterial& material : scene.materials){
+                        if (material.name == tokens[1]){fail("DUPLICATE_MATERIAL");}
+                    }
+                    scene.materials.push_back({std::string(tokens[1]), std::string(tokens[2]), std::string(tokens[3]),
+                                               number(4), number(5)});
+                }
+                else if (directive == "light"){
+                    if (tokens.size() != 16){fail("LIGHT_NEEDS_15_VALUES");}
+                    scene.light = {vec(1), vec(4), vec(7), vec(10), number(13), number(14), number(15)};
+                }
+                else if (directive == "fixed"){
+                    if (tokens.size() != 2){fail("FIXED_NEEDS_A_BODY");}
+                    auto found = body_index.find(tokens[1]);
+                    if (found == body_index.end()){fail("UNKNOWN_BODY");}
+                    scene.bodies[found->second].fixed = true;
+                }
+                else {fail("UNKNOWN_DIRECTIVE");}
+            }
+            if (scene._center < 0){
+                line = 0;
+                fail("NO_CENTER");
+            }
+            return scene;
+        }
+
+        std::size_t get_center() const {
+            return (std::size_t)_center;
+        }
+
+        //Physics tree of the scene into system (empty) : make(body) creates the CelestialBody (or a derived rendered
+        //body) of each description, appended to objects in the order of bodies. A body with satellites is the center
+        //of a subsystem, appended to subsystems. The store is sized once, the ids follow the order of the file (a
+        //center of subsystem then its satellites) and the system is initialized.
+        template <typename Make>
+        void build(OrbitalSystem& system, std::vector<std::unique_ptr<CelestialBody>>& objects,
+                   std::vector<std::shared_ptr<OrbitalSystem>>& subsystems, Make&& make) const {
+            std::size_t first = objects.size();
+            objects.reserve(first + bodies.size());
+            for (const SceneBody& body : bodies){objects.push_back(make(body));}
+            auto object = [&](std::size_t k){return objects[first + k].get();};
+
+            std::vector<std::vector<uint32_t>> satellites(bodies.size());
+            for (std::size_t k = 0; k < bodies.size(); k++){
+                int32_t parent = bodies[k].parent;
+                if (parent >= 0 && parent != _center){satellites[parent].push_back((uint32_t)k);}
+            }
+            system.reserve_bodies(bodies.size());
+            system.define_center(object(_center));
+            system.fix_center(bodies[_center].fixed);
+            for (std::size_t k = 0; k < bodies.size(); k++){
+                if (bodies[k].parent != _center){continue;}
+                if (satellites[k].empty()){
+                    system.add_orbiters(object(k));
+                    continue;
+                }
+                auto subsystem = std::make_shared<OrbitalSystem>();
+                object(k)->set_orbitalCenter(object(_center)); //Center of a subsystem : not an orbiter of the center
+                subsystem->reserve_bodies(1 + satellites[k].size());
+                subsystem->define_center(object(k));
+                subsystem->fix_center(bodies[k].fixed);
+                for (uint32_t satellite : satellites[k]){subsystem->add_orbiters(object(satellite));}
+                system.add_subsystem(subsystem);
+                subsystems.push_back(subsystem);
+            }
+            system.initialize();
+        }
+
+    private:
+        int32_t _center = -1;
+
+        static void split(const char* p, const char* end, std::vector<std::string_view>& tokens){
+            tokens.clear();
+            while (p < end){
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')){p++;}
+                const char* start = p;
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r'){p++;}
+                if (p > start){tokens.emplace_back(start, p - start);}
+            }
+        }
+        void add_belt(std::size_t count, int32_t parent, float inner, float outer, float log_mass_min,
+                      float log_mass_max, float radius, float display_radius, glm::vec3 color, uint32_t material,
+                      uint32_t seed){
+            //Copies : the reserve may move the center.
+            const float mass = bodies[parent].mass;
+            const glm::vec3 position = bodies[parent].position, velocity = bodies[parent].velocity;
+            std::mt19937 gen(seed);
+            std::uniform_real_distribution<float> distance(inner * AU, outer * AU);
+            std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+            std::uniform_real_distribution<float> log_mass(log_mass_min, log_mass_max);
+            bodies.reserve(bodies.size() + count);
+            for (std::size_t k = 0; k < count; k++){
+                float r = distance(gen);
+                float theta = angle(gen);
+                float v = std::sqrt(G * mass / r);
+                SceneBody body;
+                body.parent = parent;
+                body.position = position + glm::vec3(r * std::cos(theta), r * std::sin(theta), 0.0f);
+                body.velocity = velocity + glm::vec3(-v * std::sin(theta), v * std::cos(theta), 0.0f);
+                body.mass = std::pow(10.0f, log_mass(gen));
+                body.radius = radius;
+                body.display_radius = display_radius;
+                body.color = color;
+                body.material = material;
+                bodies.push_back(std::move(body));
+            }
+        }
+};
+
+#endif
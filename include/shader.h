@@ -3,7 +3,13 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -12,15 +18,38 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "uniform_buffer.hpp"
+
+//Typed handle on a uniform of one program, resolved once by Shader::uniform<T>() : setting it costs no lookup.
+//Invalid, and a no-op to set, when the program has no such uniform of type T.
+template <typename T>
+struct Uniform {
+    int32_t index = -1; //In the uniform table of the program
+
+    bool valid() const {
+        return index >= 0;
+    }
+};
+
 class Shader{
     public :
         unsigned int ID = 0;
 
+        //Active uniform of the program, reflected once after the link.
+        struct UniformInfo {
+            std::string name;   //Without the [0] of an array
+            GLenum type;
+            GLint location;
+            uint32_t offset;    //Of its last value in the shadow copy
+            uint32_t bytes;     //0 for the types without a setter : never cached
+            mutable bool known = false; //The shadow copy holds the value of the program
+        };
+
         Shader(const Shader&) = delete;
         Shader& operator=(const Shader&) = delete;
 
         Shader(Shader&& other) noexcept : 
-        ID(other.ID){
+        ID(other.ID), _uniforms(std::move(other._uniforms)), _shadow(std::move(other._shadow)){
             other.ID = 0;
         }
 
@@ -30,10 +59,14 @@ class Shader{
             }
             ID = other.ID;
             other.ID = 0;
+            _uniforms = std::move(other._uniforms);
+            _shadow = std::move(other._shadow);
             return *this;
         }
 
-        Shader(const char* vertexPath, const char* fragmentPath){
+        //defines : lines inserted after the #version line of both sources ("#define NAME VALUE\n" ...), the variants
+        //of one pair of files. See ShaderRegistry (shader_registry.hpp) to share a program between objects.
+        Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = ""){
 
             std::string vertexCode;
             std::string fragmentCode;
@@ -59,6 +92,10 @@ class Shader{
             catch(std::ifstream::failure e){
                 std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
             }
+            if(!defines.empty()){
+                insert_defines(vertexCode, defines);
+                insert_defines(fragmentCode, defines);
+            }
             const char* vShaderCode = vertexCode.c_str();
             const char* fShaderCode = fragmentCode.c_str();
 
@@ -96,6 +133,10 @@ class Shader{
                 glGetProgramInfoLog(ID, 512, NULL, infolog);
                 std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infolog << std::endl;
             }
+            else{
+                reflect_uniforms();
+                bind_uniform_blocks();
+            }
             
             glDeleteShader(vertex);
             glDeleteShader(fragment);
@@ -110,20 +151,164 @@ class Shader{
         void use(){
             glUseProgram(ID);
         };
+        //Setters by name : a search in the uniform table, no GL query. Like the typed ones, they only upload a value
+        //which differs from the last one set (the program must be in use, as for glUniform). The elements of an
+        //array after the first one, or a type differing from the uniform's, go to GL directly, uncached. A name out
+        //of the table (a member of a uniform block, an unused uniform) is a no-op.
         void setBool(const std::string &name, bool value) const{
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+            set_by_name(name, (int)value);
         };
         void setInt(const std::string &name, int value) const{
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+            set_by_name(name, value);
         };
         void setFloat(const std::string &name, float value) const{
-            glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+            set_by_name(name, value);
         };
         void setVec3(const std::string &name, glm::vec3 pos) const{
-            glUniform3fv(glGetUniformLocation(ID, name.c_str()),1, glm::value_ptr(pos));
+            set_by_name(name, pos);
         }
         void setMat4(const std::string &name, glm::mat4 mat){
-            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+            set_by_name(name, mat);
+        }
+
+        //T : int (int, bool and sampler uniforms), float, glm::vec2, glm::vec3, glm::vec4, glm::mat3 or glm::mat4.
+        template <typename T>
+        Uniform<T> uniform(const std::string& name) const {
+            int32_t k = find_uniform(name);
+            if(k < 0 || !accepts<T>(_uniforms[k].type)) return Uniform<T>();
+            return Uniform<T>{k};
+        }
+        template <typename T>
+        void set(Uniform<T> uniform, const T& value) const{
+            if(uniform.valid()) set_cached(_uniforms[uniform.index], value);
+        }
+
+        const std::vector<UniformInfo>& get_uniforms() const {
+            return _uniforms;
+        }
+
+    private :
+        std::vector<UniformInfo> _uniforms; //Sorted by name
+        mutable std::vector<unsigned char> _shadow; //Last values set, the uploads of the same value are skipped
+
+        void reflect_uniforms(){
+            GLint count = 0, max_length = 0;
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+            std::vector<char> name(max_length + 1);
+            uint32_t offset = 0;
+            for(GLint k = 0; k < count; k++){
+                GLsizei length = 0;
+                GLint size = 0;
+                GLenum type = 0;
+                glGetActiveUniform(ID, (GLuint)k, (GLsizei)name.size(), &length, &size, &type, name.data());
+                std::string uniform(name.data(), length);
+                if(uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0){
+                    uniform.resize(uniform.size() - 3);
+                }
+                GLint location = glGetUniformLocation(ID, uniform.c_str());
+                if(location < 0) continue; //Member of a uniform block
+                uint32_t bytes = type_bytes(type);
+                _uniforms.push_back({std::move(uniform), type, location, offset, bytes});
+                offset += bytes;
+            }
+            std::sort(_uniforms.begin(), _uniforms.end(),
+                      [](const UniformInfo& a, const UniformInfo& b){return a.name < b.name;});
+            _shadow.assign(offset, 0);
+        }
+        //The std140 blocks shared by the shaders (Camera, Light) read the buffers bound at their binding points.
+        void bind_uniform_blocks(){
+            GLint count = 0, max_length = 0;
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+            std::vector<char> name(max_length + 1);
+            for(GLint k = 0; k < count; k++){
+                glGetActiveUniformBlockName(ID, (GLuint)k, (GLsizei)name.size(), NULL, name.data());
+                GLuint binding = uniform_block_binding(name.data());
+                if(binding != GL_INVALID_INDEX) glUniformBlockBinding(ID, (GLuint)k, binding);
+            }
+        }
+        int32_t find_uniform(const std::string& name) const{
+            std::string_view key(name);
+            if(key.size() > 3 && key.substr(key.size() - 3) == "[0]") key.remove_suffix(3);
+            auto less = [](const UniformInfo& a, std::string_view b){return std::string_view(a.name) < b;};
+            auto it = std::lower_bound(_uniforms.begin(), _uniforms.end(), key, less);
+            if(it == _uniforms.end() || it->name != key) return -1;
+            return (int32_t)(it - _uniforms.begin());
+        }
+
+        template <typename T>
+        void set_by_name(const std::string& name, const T& value) const{
+            int32_t k = find_uniform(name);
+            if(k >= 0 && accepts<T>(_uniforms[k].type)){
+                set_cached(_uniforms[k], value);
+                return;
+            }
+            if(k < 0 && name.find('[') == std::string::npos) return;
+            GLint location = k >= 0 ? _uniforms[k].location : glGetUniformLocation(ID, name.c_str());
+            if(k >= 0) _uniforms[k].known = false;
+            upload(location, value);
+        }
+        template <typename T>
+        void set_cached(const UniformInfo& info, const T& value) const{
+            unsigned char* last = _shadow.data() + info.offset;
+            if(info.known && std::memcmp(last, &value, sizeof(T)) == 0) return;
+            std::memcpy(last, &value, sizeof(T));
+            info.known = true;
+            upload(info.location, value);
+        }
+
+        static void upload(GLint location, int value){glUniform1i(location, value);}
+        static void upload(GLint location, float value){glUniform1f(location, value);}
+        static void upload(GLint location, const glm::vec2& value){glUniform2fv(location, 1, glm::value_ptr(value));}
+        static void upload(GLint location, const glm::vec3& value){glUniform3fv(location, 1, glm::value_ptr(value));}
+        static void upload(GLint location, const glm::vec4& value){glUniform4fv(location, 1, glm::value_ptr(value));}
+        static void upload(GLint location, const glm::mat3& value){
+            glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+        static void upload(GLint location, const glm::mat4& value){
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+
+        static bool is_integer(GLenum type){
+            switch(type){
+                case GL_INT: case GL_BOOL: case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D:
+                case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: return true;
+                default: return false;
+            }
+        }
+        template <typename T>
+        static bool accepts(GLenum type){
+            if constexpr (std::is_same<T, int>::value) return is_integer(type);
+            else if constexpr (std::is_same<T, float>::value) return type == GL_FLOAT;
+            else if constexpr (std::is_same<T, glm::vec2>::value) return type == GL_FLOAT_VEC2;
+            else if constexpr (std::is_same<T, glm::vec3>::value) return type == GL_FLOAT_VEC3;
+            else if constexpr (std::is_same<T, glm::vec4>::value) return type == GL_FLOAT_VEC4;
+            else if constexpr (std::is_same<T, glm::mat3>::value) return type == GL_FLOAT_MAT3;
+            else if constexpr (std::is_same<T, glm::mat4>::value) return type == GL_FLOAT_MAT4;
+            else return false;
+        }
+        static uint32_t type_bytes(GLenum type){
+            if(is_integer(type)) return sizeof(int);
+            switch(type){
+                case GL_FLOAT: return sizeof(float);
+                case GL_FLOAT_VEC2: return sizeof(glm::vec2);
+                case GL_FLOAT_VEC3: return sizeof(glm::vec3);
+                case GL_FLOAT_VEC4: return sizeof(glm::vec4);
+                case GL_FLOAT_MAT3: return sizeof(glm::mat3);
+                case GL_FLOAT_MAT4: return sizeof(glm::mat4);
+                default: return 0;
+            }
+        }
+
+        //#version must stay the first line of a GLSL source.
+        static void insert_defines(std::string& code, const std::string& defines){
+            std::size_t at = 0;
+            if(code.compare(0, 8, "#version") == 0){
+                if(code.find('\n') == std::string::npos) code += '\n';
+                at = code.find('\n') + 1;
+            }
+            code.insert(at, defines);
         }
 };
 
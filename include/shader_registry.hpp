@@ -0,0 +1,83 @@
+#ifndef SHADER_REGISTRY_HPP
+#define SHADER_REGISTRY_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "shader.h"
+
+//Programs shared by every object of the process : get() reads, compiles and links a (vertex, fragment, defines)
+//variant at its first request only, the later ones get a handle on the same program. The handles are counted, the
+//program is deleted with the last one (and compiled again if it is requested after that) : the driver keeps one
+//program per variant in use, whatever the number of objects drawn with it.
+//The registry only holds weak references : it never makes a GL call by itself, the programs are deleted by their
+//handles while the context is alive. Handles are requested and dropped on the thread of the GL context.
+class ShaderRegistry {
+    public:
+        ShaderRegistry() = default;
+        ShaderRegistry(const ShaderRegistry&) = delete;
+        ShaderRegistry& operator=(const ShaderRegistry&) = delete;
+
+        //Registry shared by every shader user of the process.
+        static ShaderRegistry& instance(){
+            static ShaderRegistry registry;
+            return registry;
+        }
+
+        //defines : one "NAME" or "NAME VALUE" per entry, in their order of definition. The paths are compared once
+        //normalized (../shaders/a/../b.vs is ../shaders/b.vs), not resolved on the disk.
+        std::shared_ptr<Shader> get(const std::string& vertexPath, const std::string& fragmentPath,
+                                    const std::vector<std::string>& defines = {}){
+            std::string preamble;
+            for (const std::string& define : defines){preamble += "#define " + define + "\n";}
+            Key key{normalize(vertexPath), normalize(fragmentPath), preamble};
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::weak_ptr<Shader>& entry = _programs[key];
+            std::shared_ptr<Shader> shader = entry.lock();
+            if (!shader){
+                shader = std::make_shared<Shader>(vertexPath.c_str(), fragmentPath.c_str(), preamble);
+                entry = shader;
+                _compile_count++;
+            }
+            return shader;
+        }
+
+        //Programs with at least one handle alive.
+        std::size_t get_program_count(){
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::size_t count = 0;
+            for (auto it = _programs.begin(); it != _programs.end();){
+                if (it->second.expired()){it = _programs.erase(it);}
+                else {
+                    count++;
+                    ++it;
+                }
+            }
+            return count;
+        }
+        //Programs compiled since the start of the process.
+        std::size_t get_compile_count(){
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _compile_count;
+        }
+
+    private:
+        using Key = std::tuple<std::string, std::string, std::string>; //Vertex path, fragment path, defines
+
+        std::mutex _mutex;
+        std::map<Key, std::weak_ptr<Shader>> _programs;
+        std::size_t _compile_count = 0;
+
+        static std::string normalize(const std::string& path){
+            return std::filesystem::path(path).lexically_normal().generic_string();
+        }
+};
+
+#endif
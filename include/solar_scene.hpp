@@ -0,0 +1,88 @@
+#ifndef SOLAR_SCENE_HPP
+#define SOLAR_SCENE_HPP
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "celestial_body.hpp"
+
+//Scene of the headless runs (orbital_sim, ensemble_sim) : the solar system of orbital_system, built without any GL
+//context, and an optional asteroid belt or belt of test particles.
+struct Scene {
+    OrbitalSystem system;
+    std::shared_ptr<OrbitalSystem> earth_system = std::make_shared<OrbitalSystem>();
+    std::vector<std::unique_ptr<CelestialBody>> bodies;
+    std::vector<std::string> names; //Of the bodies, empty for the asteroids
+
+    CelestialBody* add(const std::vector<float>& r0, const std::vector<float>& v0, float radius, float mass,
+                       OrbitalSystem* orbitalSystem = nullptr, const char* name = ""){
+        bodies.push_back(std::make_unique<CelestialBody>(r0, v0, radius, mass, orbitalSystem));
+        names.push_back(name);
+        return bodies.back().get();
+    }
+};
+
+inline void build_scene(Scene& scene, std::size_t asteroids){
+    //Same initial conditions as orbital_system : fixed sun, 8 planets, Earth-Moon subsystem.
+    OrbitalSystem* solar = &scene.system;
+    CelestialBody* sun = scene.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 696340e3f, 1.99e30f, nullptr, "Sun");
+    CelestialBody* mercury = scene.add({5.80e10f, 0.0f, 0.0f}, {0.0f, 47360.0f, 0.0f}, 2439.7e3f, 3.3e23f, solar, "Mercury");
+    CelestialBody* venus = scene.add({1.08e11f, 0.0f, 0.0f}, {0.0f, 35025.0f, 0.0f}, 6051.8e3f, 4.87e24f, solar, "Venus");
+    CelestialBody* earth = scene.add({1.50e11f, 0.0f, 0.0f}, {0.0f, 29780.0f, 0.0f}, 6371.0e3f, 5.97e24f, solar, "Earth");
+    CelestialBody* mars = scene.add({2.28e11f, 0.0f, 0.0f}, {0.0f, 24130.0f, 0.0f}, 3389.5e3f, 6.42e23f, solar, "Mars");
+    CelestialBody* jupiter = scene.add({7.79e11f, 0.0f, 0.0f}, {0.0f, 13058.0f, 0.0f}, 69911.0e3f, 1.90e27f, solar, "Jupiter");
+    CelestialBody* saturn = scene.add({1.43e12f, 0.0f, 0.0f}, {0.0f, 9680.0f, 0.0f}, 58232.0e3f, 5.68e26f, solar, "Saturn");
+    CelestialBody* uranus = scene.add({2.92e12f, 0.0f, 0.0f}, {0.0f, 6796.0f, 0.0f}, 25362.0e3f, 8.68e25f, solar, "Uranus");
+    CelestialBody* neptune = scene.add({4.47e12f, 0.0f, 0.0f}, {0.0f, 5432.0f, 0.0f}, 24622.0e3f, 1.02e26f, solar, "Neptune");
+    CelestialBody* moon = scene.add({1.50e11f + 3e8f, 0.0f, 0.0f}, {0.0f, 29780.0f + 1022.0f, 0.0f}, 1737.4e3f, 7.35e22f, nullptr, "Moon");
+
+    OrbitalSystem& system = scene.system;
+    system.reserve_bodies(10 + asteroids);
+    system.define_center(sun);
+    system.fix_center(true);
+    earth->set_orbitalCenter(sun); //Center of a subsystem : not added as orbiter of the sun
+    scene.earth_system->define_center(earth);
+    scene.earth_system->add_orbiters(moon);
+    system.add_subsystem(scene.earth_system);
+    for (CelestialBody* planet : {venus, mercury, mars, jupiter, saturn, neptune, uranus}){
+        system.add_orbiters(planet);
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> radius(2.0f * AU, 4.0f * AU);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+    std::uniform_real_distribution<float> log_mass(15.0f, 19.0f);
+    for (std::size_t k = 0; k < asteroids; k++){
+        float r = radius(gen);
+        float theta = angle(gen);
+        float v = std::sqrt(G * 1.99e30f / r);
+        CelestialBody* asteroid = scene.add({r * std::cos(theta), r * std::sin(theta), 0.0f},
+                                            {-v * std::sin(theta), v * std::cos(theta), 0.0f},
+                                            1e4f, std::pow(10.0f, log_mass(gen)), solar);
+        system.add_orbiters(asteroid);
+    }
+    system.initialize();
+}
+
+//Massless belt of test particles (2 to 4 AU, circular orbits around the center of the system), pulled by its bodies.
+inline void add_test_belt(OrbitalSystem& system, std::size_t particles){
+    const float mass = system.get_center()->get_mass();
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> radius(2.0f * AU, 4.0f * AU);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+    system.reserve_test_particles(particles);
+    for (std::size_t k = 0; k < particles; k++){
+        float r = radius(gen);
+        float theta = angle(gen);
+        float v = std::sqrt(G * mass / r);
+        system.add_test_particle({r * std::cos(theta), r * std::sin(theta), 0.0f},
+                                 {-v * std::sin(theta), v * std::cos(theta), 0.0f});
+    }
+}
+
+#endif
@@ -3,9 +3,10 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
-#include "shader.h"
+#include "shader_registry.hpp"
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <glad/glad.h>
 
@@ -23,7 +24,9 @@ class Sphere{
         Sphere(Sphere&& other) noexcept : //move constructeur
         _points(std::move(other._points)), _R(other._R), _color(other._color), 
         _center(other._center), _VBO(other._VBO), _VAO(other._VAO),
-        _model(other._model), _shader(std::move(other._shader)), _EBO(other._EBO){
+        _model(other._model), _shader(std::move(other._shader)), _EBO(other._EBO),
+        _indices(std::move(other._indices)), _scale(other._scale),
+        _uniforms(other._uniforms), _material(other._material){
             other._VBO = 0;
             other._VAO = 0;
             other._EBO = 0;
@@ -42,6 +45,10 @@ class Sphere{
             _EBO = other._EBO;
             _model = other._model;
             _shader = std::move(other._shader);
+            _indices = std::move(other._indices);
+            _scale = other._scale;
+            _uniforms = other._uniforms;
+            _material = other._material;
 
             other._VBO = 0;
             other._VAO = 0;
@@ -53,7 +60,7 @@ class Sphere{
         Sphere(float radius,int nb_points,
                const std::vector<float>& color, const glm::vec3 center) :
                _R(radius) , _color(color), _center(center),
-               _shader("shaders/sphere/sphere.vs", "shaders/sphere/sphere.fs"){
+               _shader(ShaderRegistry::instance().get("shaders/sphere/sphere.vs", "shaders/sphere/sphere.fs")){
             
             if(nb_points < 64){
                 throw std::invalid_argument("Not enought points to correctly render a Sphere");
@@ -93,65 +100,15 @@ class Sphere{
             glEnableVertexAttribArray(1);
 
             _model = glm::translate(_model, _center);
+            resolve_uniforms();
         }
 
         Sphere(float radius, const std::vector<float>& color, glm::vec3 center,
                const char* vertexShader = "../shaders/sphere/sphere.vs",
                const char* fragmentShader = "../shaders/sphere/sphere.fs") : 
                _R(radius), _color(color), _center(center),
-               _shader(vertexShader, fragmentShader){
-                //Part of code comes from https://www.songho.ca/opengl/gl_sphere.html#sphere
-                int subdivision = 80;
-                float dlat = M_PI / subdivision;
-                float dlong = 2 * M_PI / subdivision;
-                float inv = 1.0f / _R;
-                for (unsigned int i = 0; i < subdivision ; i++){
-                    float lat = M_PI *(-0.5f + (float)i / (subdivision - 1));  
-                    float y = _R * sin(lat);
-                    for (unsigned int j = 0 ; j < subdivision ; j++){
-                        float lon = 2 * M_PI * j / (subdivision - 1);
-                        float x = _R * cos(lat) * cos(lon);
-                        float z = _R * cos(lat) * sin(lon);
-
-                        float nx = x * inv;
-                        float ny = y * inv;
-                        float nz = z * inv;
-
-                        _points.push_back(x);
-                        _points.push_back(y);
-                        _points.push_back(z);
-                        _points.push_back(nx);
-                        _points.push_back(ny);
-                        _points.push_back(nz);
-                        _points.push_back(color[0]);
-                        _points.push_back(color[1]);
-                        _points.push_back(color[2]);
-                    }
-                }
-
-                int k1, k2;
-                for (int i = 0 ; i < subdivision ; ++i){
-                    k1 = i * subdivision;
-                    k2 = k1 + subdivision;
-                    for (int j = 0 ; j < subdivision; ++j, ++k1, ++k2){
-                        if(i !=0){
-                            _indices.push_back(k1);
-                            _indices.push_back(k2);
-                            _indices.push_back(k1 + 1);
-                        }
-                        if(i != (subdivision - 1)){
-                            _indices.push_back(k1 + 1);
-                            _indices.push_back(k2);
-                            _indices.push_back(k2 + 1);
-                        }
-                        _lineIndices.push_back(k1);
-                        _lineIndices.push_back(k2);
-                        if(i != 0){
-                            _lineIndices.push_back(k1);
-                            _lineIndices.push_back(k1 + 1);
-                        }
-                    }
-                }
+               _shader(ShaderRegistry::instance().get(vertexShader, fragmentShader)){
+                build_mesh(_R, color, 80, _points, _indices, _lineIndices);
 
                 glGenVertexArrays(1,&_VAO);
                 glGenBuffers(1,&_VBO);
@@ -170,19 +127,82 @@ class Sphere{
                 glEnableVertexAttribArray(2);
                 glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(int), _indices.data(), GL_STATIC_DRAW);
                 _model = glm::translate(_model, _center);
+                resolve_uniforms();
+            }
+
+        //Vertices (position, normal, color) and triangle / line indices of a UV sphere. No GL call : used by the
+        //constructor before the upload, by UnitSphereMesh (see sphere_instances.hpp) and by the benchmarks.
+        static void build_mesh(float radius, const std::vector<float>& color, int subdivision,
+                               std::vector<float>& points, std::vector<unsigned int>& indices,
+                               std::vector<int>& lineIndices){
+            //Part of code comes from https://www.songho.ca/opengl/gl_sphere.html#sphere
+            float dlat = M_PI / subdivision;
+            float dlong = 2 * M_PI / subdivision;
+            float inv = 1.0f / radius;
+            for (unsigned int i = 0; i < subdivision ; i++){
+                float lat = M_PI *(-0.5f + (float)i / (subdivision - 1));  
+                float y = radius * sin(lat);
+                for (unsigned int j = 0 ; j < subdivision ; j++){
+                    float lon = 2 * M_PI * j / (subdivision - 1);
+                    float x = radius * cos(lat) * cos(lon);
+                    float z = radius * cos(lat) * sin(lon);
+
+                    float nx = x * inv;
+                    float ny = y * inv;
+                    float nz = z * inv;
+
+                    points.push_back(x);
+                    points.push_back(y);
+                    points.push_back(z);
+                    points.push_back(nx);
+                    points.push_back(ny);
+                    points.push_back(nz);
+                    points.push_back(color[0]);
+                    points.push_back(color[1]);
+                    points.push_back(color[2]);
+                }
             }
 
+            //Band i joins the rows i and i + 1, the last column repeats the first one (lon = 2 pi) : no band after
+            //the last row, no quad after the last column.
+            int k1, k2;
+            for (int i = 0 ; i < subdivision - 1 ; ++i){
+                k1 = i * subdivision;
+                k2 = k1 + subdivision;
+                for (int j = 0 ; j < subdivision - 1; ++j, ++k1, ++k2){
+                    if(i !=0){
+                        indices.push_back(k1);
+                        indices.push_back(k2);
+                        indices.push_back(k1 + 1);
+                    }
+                    if(i != (subdivision - 2)){
+                        indices.push_back(k1 + 1);
+                        indices.push_back(k2);
+                        indices.push_back(k2 + 1);
+                    }
+                    lineIndices.push_back(k1);
+                    lineIndices.push_back(k2);
+                    if(i != 0){
+                        lineIndices.push_back(k1);
+                        lineIndices.push_back(k1 + 1);
+                    }
+                }
+            }
+        }
+
         ~Sphere(){
             glDeleteBuffers(1,&_VBO);
             glDeleteVertexArrays(1,&_VAO);
             glDeleteBuffers(1,&_EBO);
         }
 
-        void render(glm::mat4 view, glm::mat4 projection){
-            _shader.use();
-            _shader.setMat4("model", get_model());
-            _shader.setMat4("view",view);
-            _shader.setMat4("projection", projection);
+        //The view, projection and light come from the Camera and Light blocks (see uniform_buffer.hpp) : only the model
+        //and the material are set per sphere, and only uploaded when they differ from the last ones of the program.
+        void render(){
+            _shader->use();
+            _shader->set(_uniforms.model, get_model());
+            _shader->set(_uniforms.specularStrength, _material.specular_strength);
+            _shader->set(_uniforms.shininess, _material.shininess);
             glBindVertexArray(_VAO);
             glDrawElements(GL_TRIANGLES, _indices.size(), GL_UNSIGNED_INT, 0);
 
@@ -234,7 +254,11 @@ class Sphere{
             return _model;
         }
         Shader& get_shader(){
-            return _shader;
+            return *_shader;
+        }
+        //Specular lighting of the lit sphere shaders (sphere_directionnal.fs), ignored by the others.
+        void set_material(float specular_strength, float shininess){
+            _material = {specular_strength, shininess};
         }
 
     private:
@@ -244,10 +268,19 @@ class Sphere{
         glm::vec3 _center = glm::vec3 (0.0f);
         std::vector <unsigned int> _indices;
         std::vector <int> _lineIndices;
-        unsigned int _VBO;
-        unsigned int _VAO;
-        unsigned int _EBO;
-        Shader _shader;
+        unsigned int _VBO = 0;
+        unsigned int _VAO = 0;
+        unsigned int _EBO = 0;
+        std::shared_ptr<Shader> _shader;
+        //Handles in _shader, resolved once by the constructors.
+        struct Uniforms {
+            Uniform<glm::mat4> model;
+            Uniform<float> specularStrength, shininess;
+        } _uniforms;
+        struct Material {
+            float specular_strength = 0.0f;
+            float shininess = 1.0f;
+        } _material;
         glm::mat4 _model = glm::mat4 (1.0f);
         glm::vec3 _scale = glm::vec3 (1.0f);
         float _angle = 0.0f;
@@ -261,6 +294,11 @@ class Sphere{
             _model = glm::rotate(_model, glm::radians(_angle), _rotation_axis);
             _model = glm::scale(_model, _scale);
         }
+        void resolve_uniforms(){
+            _uniforms.model = _shader->uniform<glm::mat4>("model");
+            _uniforms.specularStrength = _shader->uniform<float>("specularStrenght");
+            _uniforms.shininess = _shader->uniform<float>("shininess");
+        }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#ifndef SPHERE_INSTANCES_HPP
+#define SPHERE_INSTANCES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "sphere.hpp"
+
+//Unit sphere of the instanced shaders : positions only (the normal of a unit sphere is its position, the color is per
+//instance), uploaded once per subdivision for the whole process. No VAO of its own : each SphereInstances binds its
+//buffers with its instance buffers.
+class UnitSphereMesh {
+    public:
+        UnitSphereMesh(const UnitSphereMesh&) = delete;
+        UnitSphereMesh& operator=(const UnitSphereMesh&) = delete;
+
+        explicit UnitSphereMesh(int subdivision){
+            std::vector<float> points;
+            std::vector<unsigned int> indices;
+            std::vector<int> lineIndices;
+            Sphere::build_mesh(1.0f, {1.0f, 1.0f, 1.0f}, subdivision, points, indices, lineIndices);
+            std::vector<float> positions(points.size() / 9 * 3);
+            for (std::size_t v = 0; v < positions.size() / 3; v++){
+                std::copy(points.begin() + 9 * v, points.begin() + 9 * v + 3, positions.begin() + 3 * v);
+            }
+            _count = indices.size();
+
+            //Copy targets : the element array binding belongs to a VAO, none is bound here.
+            glGenBuffers(1, &_VBO);
+            glGenBuffers(1, &_EBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _VBO);
+            glBufferData(GL_COPY_WRITE_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _EBO);
+            glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        }
+        ~UnitSphereMesh(){
+            glDeleteBuffers(1, &_VBO);
+            glDeleteBuffers(1, &_EBO);
+        }
+
+        //Mesh shared by the sets of the process, uploaded at the first request (with a GL context), deleted with the
+        //last set using it.
+        static std::shared_ptr<const UnitSphereMesh> get(int subdivision = 80){
+            static std::map<int, std::weak_ptr<const UnitSphereMesh>> meshes;
+            std::weak_ptr<const UnitSphereMesh>& entry = meshes[subdivision];
+            std::shared_ptr<const UnitSphereMesh> mesh = entry.lock();
+            if (!mesh){
+                mesh = std::make_shared<const UnitSphereMesh>(subdivision);
+                entry = mesh;
+            }
+            return mesh;
+        }
+
+        //Attributes 0 (position) and 1 (normal) of the sphere shaders, and the indices, into the bound VAO.
+        void bind() const {
+            glBindBuffer(GL_ARRAY_BUFFER, _VBO);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _EBO);
+        }
+        std::size_t get_count() const {
+            return _count;
+        }
+
+    private:
+        std::size_t _count;
+        unsigned int _VBO = 0;
+        unsigned int _EBO = 0;
+};
+
+//Spheres of one program drawn by a single glDrawElementsInstanced : the unit mesh is shared, each instance reads its
+//radius and color (8 bytes, uploaded once after add()) from an instance buffer, and its position (12 bytes) from the
+//buffer given to draw(), e.g. a range of a StreamBuffer written in the frame. The program is a sphere shader compiled
+//with INSTANCED, e.g.
+//ShaderRegistry::instance().get("../shaders/sphere/sphere.vs", "../shaders/sphere/sphere.fs", {"INSTANCED"}).
+//Camera and light come from their uniform blocks, like Sphere. Needs a GL context.
+class SphereInstances {
+    public:
+        SphereInstances(const SphereInstances&) = delete;
+        SphereInstances& operator=(const SphereInstances&) = delete;
+
+        explicit SphereInstances(std::shared_ptr<Shader> shader, int subdivision = 80) :
+        _shader(std::move(shader)), _mesh(UnitSphereMesh::get(subdivision)){
+            glGenVertexArrays(1, &_VAO);
+            glGenBuffers(1, &_styleVBO);
+
+            glBindVertexArray(_VAO);
+            _mesh->bind();
+            glEnableVertexAttribArray(3); //Pointed by draw()
+            glVertexAttribDivisor(3, 1);
+            glBindBuffer(GL_ARRAY_BUFFER, _styleVBO);
+            glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Style), (void*)0);
+            glEnableVertexAttribArray(4);
+            glVertexAttribDivisor(4, 1);
+            glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Style), (void*)offsetof(Style, color));
+            glEnableVertexAttribArray(5);
+            glVertexAttribDivisor(5, 1);
+            glBindVertexArray(0);
+
+            _uniforms.specularStrength = _shader->uniform<float>("specularStrenght");
+            _uniforms.shininess = _shader->uniform<float>("shininess");
+        }
+        ~SphereInstances(){
+            glDeleteBuffers(1, &_styleVBO);
+            glDeleteVertexArrays(1, &_VAO);
+        }
+
+        void reserve(std::size_t n){
+            _styles.reserve(n);
+        }
+        //Index of the new instance. color in [0, 1], stored on 8 bits per channel.
+        std::size_t add(float radius, glm::vec3 color){
+            Style style{radius, {}};
+            for (int c = 0; c < 3; c++){
+                style.color[c] = (uint8_t)(std::min(std::max(color[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+            style.color[3] = 255;
+            _styles.push_back(style);
+            _stylesDirty = true;
+            return _styles.size() - 1;
+        }
+        //Specular lighting of the lit sphere shaders, the same for every instance.
+        void set_material(float specular_strength, float shininess){
+            _specularStrength = specular_strength;
+            _shininess = shininess;
+        }
+
+        //One draw call for all the instances, instance k at the k-th glm::vec3 from offset in the buffer positions.
+        void draw(unsigned int positions, GLintptr offset){
+            if (_styles.empty()){return;}
+            _shader->use();
+            _shader->set(_uniforms.specularStrength, _specularStrength);
+            _shader->set(_uniforms.shininess, _shininess);
+            if (_stylesDirty){
+                glBindBuffer(GL_ARRAY_BUFFER, _styleVBO);
+                glBufferData(GL_ARRAY_BUFFER, _styles.size() * sizeof(Style), _styles.data(), GL_STATIC_DRAW);
+                _stylesDirty = false;
+            }
+            glBindVertexArray(_VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, positions);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)offset);
+            glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)_mesh->get_count(), GL_UNSIGNED_INT, 0,
+                                    (GLsizei)_styles.size());
+        }
+
+        std::size_t size() const {
+            return _styles.size();
+        }
+        Shader& get_shader(){
+            return *_shader;
+        }
+
+    private:
+        struct Style {
+            float radius;
+            uint8_t color[4];
+        };
+        static_assert(sizeof(Style) == 8, "instance attributes 4 and 5");
+
+        std::shared_ptr<Shader> _shader;
+        std::shared_ptr<const UnitSphereMesh> _mesh;
+        unsigned int _VAO = 0;
+        unsigned int _styleVBO = 0;
+
+        std::vector<Style> _styles;
+        bool _stylesDirty = false;
+
+        struct Uniforms {
+            Uniform<float> specularStrength, shininess;
+        } _uniforms;
+        float _specularStrength = 0.0f;
+        float _shininess = 1.0f;
+};
+
+#endif
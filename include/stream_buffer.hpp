@@ -0,0 +1,206 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//ARB_buffer_storage (core in 4.4) is not in the 3.3 loader of glad : its entry point and flags are declared here.
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+//Ring allocator of the per-frame data streamed to the GPU (instance positions, transforms...), one GL buffer cut in
+//FRAMES regions : a frame writes its region while the GPU still reads the two previous ones.
+// - With ARB_buffer_storage (after load_buffer_storage()), the buffer is mapped once, persistent and coherent :
+//   allocate() returns a pointer into GPU visible memory, the data is written there directly. A fence closes each
+//   frame, begin_frame() only waits if the GPU is still reading the region of three frames ago.
+// - Otherwise each allocation is mapped unsynchronized and unmapped by commit(), and the storage is orphaned each time
+//   the ring wraps around : the draws still reading the old storage never make the driver wait. A single range is
+//   mapped at a time : commit() it before the next allocate().
+//Use : begin_frame(), then allocate() / write / commit() / draw with get_buffer() and the offset, then end_frame()
+//after the draws. Needs a GL context, used on its thread.
+class StreamBuffer {
+    public:
+        static constexpr int FRAMES = 3;
+
+        struct Range {
+            void* data = nullptr;
+            GLintptr offset = 0;  //In get_buffer(), for glVertexAttribPointer, glBindBufferRange...
+            GLsizeiptr bytes = 0;
+        };
+
+        //Loads glBufferStorage if the context supports it (4.4 or GL_ARB_buffer_storage), after gladLoadGLLoader :
+        //StreamBuffer::load_buffer_storage((GLADloadproc)glfwGetProcAddress). Without it the buffers orphan.
+        static bool load_buffer_storage(GLADloadproc load){
+            bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count && !supported; i++){
+                const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+                supported = name != nullptr && std::strcmp(name, "GL_ARB_buffer_storage") == 0;
+            }
+            buffer_storage() = supported ? (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage") : nullptr;
+            return buffer_storage() != nullptr;
+        }
+        static bool is_persistent_supported(){
+            return buffer_storage() != nullptr;
+        }
+
+        //frame_bytes : first capacity of a region, grown by allocate() if a frame needs more.
+        explicit StreamBuffer(GLenum target = GL_ARRAY_BUFFER, std::size_t frame_bytes = 1 << 16) :
+        _target(target), _persistent(is_persistent_supported()){
+            create(align(frame_bytes == 0 ? 1 : frame_bytes, ALIGNMENT));
+        }
+        ~StreamBuffer(){
+            for (GLsync& fence : _fences){
+                if (fence){glDeleteSync(fence);}
+            }
+            destroy(_buffer);
+            for (unsigned int buffer : _retired){destroy(buffer);}
+        }
+        StreamBuffer(const StreamBuffer&) = delete;
+        StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+        //Moves to the next region, once the GPU is done with it.
+        void begin_frame(){
+            for (unsigned int buffer : _retired){destroy(buffer);}
+            _retired.clear();
+            _region = (_region + 1) % FRAMES;
+            _head = 0;
+            if (_persistent){wait(_fences[_region]);}
+            else if (_region == 0){
+                glBindBuffer(_target, _buffer);
+                glBufferData(_target, FRAMES * _frame_bytes, nullptr, GL_STREAM_DRAW);
+            }
+        }
+        //Writable range of bytes in the region of the frame, valid until end_frame(). alignment : a power of 2 (e.g.
+        //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for uniform blocks). A frame larger than the region grows the ring : the
+        //ranges already given keep their old buffer until the next frame, get_buffer() changes.
+        Range allocate(std::size_t bytes, std::size_t alignment = ALIGNMENT){
+            std::size_t start = align(_head, alignment);
+            if (start + bytes > _frame_bytes){
+                grow(align(2 * (start + bytes), ALIGNMENT));
+                start = 0;
+            }
+            _head = start + bytes;
+
+            Range range;
+            range.offset = (GLintptr)(_region * _frame_bytes + start);
+            range.bytes = (GLsizeiptr)bytes;
+            if (_persistent){range.data = _mapped + range.offset;}
+            else {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+                glBindBuffer(_target, _buffer);
+                range.data = glMapBufferRange(_target, range.offset, range.bytes, flags);
+            }
+            return range;
+        }
+        //The range is written : makes it readable by the next draws (nothing to do on a coherent mapping).
+        void commit(const Range& range){
+            if (_persistent || range.data == nullptr){return;}
+            glBindBuffer(_target, _buffer);
+            glUnmapBuffer(_target);
+        }
+        //Allocates, copies and commits bytes of data.
+        Range write(const void* data, std::size_t bytes, std::size_t alignment = ALIGNMENT){
+            Range range = allocate(bytes, alignment);
+            if (range.data != nullptr){std::memcpy(range.data, data, bytes);}
+            commit(range);
+            return range;
+        }
+        //After the last draw reading the frame.
+        void end_frame(){
+            if (!_persistent){return;}
+            if (_fences[_region]){glDeleteSync(_fences[_region]);}
+            _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        unsigned int get_buffer() const {
+            return _buffer;
+        }
+        bool is_persistent() const {
+            return _persistent;
+        }
+        std::size_t get_frame_bytes() const {
+            return _frame_bytes;
+        }
+        //Frames which had to wait for the GPU : more than zero in steady state means too few regions.
+        std::size_t get_stall_count() const {
+            return _stall_count;
+        }
+
+    private:
+        static constexpr std::size_t ALIGNMENT = 16;
+
+        GLenum _target;
+        bool _persistent;
+        unsigned int _buffer = 0;
+        uint8_t* _mapped = nullptr;
+        std::size_t _frame_bytes = 0;
+        int _region = FRAMES - 1; //The first begin_frame() starts at region 0
+        std::size_t _head = 0;
+        GLsync _fences[FRAMES] = {};
+        std::vector<unsigned int> _retired; //Buffers replaced by grow() during the frame
+        std::size_t _stall_count = 0;
+
+        static PFNGLBUFFERSTORAGEPROC& buffer_storage(){
+            static PFNGLBUFFERSTORAGEPROC proc = nullptr;
+            return proc;
+        }
+        static std::size_t align(std::size_t n, std::size_t alignment){
+            return (n + alignment - 1) & ~(alignment - 1);
+        }
+
+        void create(std::size_t frame_bytes){
+            _frame_bytes = frame_bytes;
+            glGenBuffers(1, &_buffer);
+            glBindBuffer(_target, _buffer);
+            if (_persistent){
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                buffer_storage()(_target, FRAMES * _frame_bytes, nullptr, flags);
+                _mapped = (uint8_t*)glMapBufferRange(_target, 0, FRAMES * _frame_bytes, flags);
+                if (_mapped == nullptr){ //Storage refused by the driver : orphaning from now on
+                    glDeleteBuffers(1, &_buffer);
+                    _persistent = false;
+                    create(frame_bytes);
+                }
+            }
+            else {glBufferData(_target, FRAMES * _frame_bytes, nullptr, GL_STREAM_DRAW);}
+        }
+        //A new buffer starting at this region : the fences were those of the old one.
+        void grow(std::size_t frame_bytes){
+            _retired.push_back(_buffer);
+            _buffer = 0;
+            _mapped = nullptr;
+            for (GLsync& fence : _fences){
+                if (fence){glDeleteSync(fence);}
+                fence = nullptr;
+            }
+            create(frame_bytes);
+        }
+        //Deleting a mapped buffer unmaps it, GL keeps its storage until the draws reading it are done.
+        static void destroy(unsigned int buffer){
+            if (buffer != 0){glDeleteBuffers(1, &buffer);}
+        }
+        void wait(GLsync& fence){
+            if (!fence){return;}
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED){
+                _stall_count++;
+                do {status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);}
+                while (status == GL_TIMEOUT_EXPIRED);
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+};
+
+#endif
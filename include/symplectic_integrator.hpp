@@ -0,0 +1,312 @@
+#ifndef SYMPLECTIC_INTEGRATOR_HPP
+#define SYMPLECTIC_INTEGRATOR_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+
+//Integration schemes of an OrbitalSystem.
+//Verlet : second order, one force evaluation per step (the historical scheme).
+//Yoshida4, Yoshida6 : compositions of 3 and 7 Verlet steps with the coefficients of Yoshida (1990), 4th and 6th order,
+//3 and 7 force evaluations per step.
+//WisdomHolman : every body follows the exact Kepler orbit around its primary (the sun for a planet, the center of its
+//subsystem for a satellite) and only the other forces are applied as kicks, one force evaluation per step.
+//The error is the one of Verlet scaled by the ratio perturbation / central force (~1e-3 in the solar system).
+enum class IntegratorScheme {Verlet, Yoshida4, Yoshida6, WisdomHolman};
+
+//Body moved by the integrator. primary : body it orbits in the Kepler drift of WisdomHolman, NO_PRIMARY for a body
+//moving in a straight line. mu : G times the mass of the two body problem (G * (M + m) when the primary feels the body,
+//G * M when it does not).
+struct IntegratedBody {
+    static constexpr uint32_t NO_PRIMARY = UINT32_MAX;
+
+    uint32_t id;
+    uint32_t primary;
+    double mu;
+    bool pulls_primary; //The primary feels this body (a satellite of a subsystem whose center is not fixed)
+};
+
+//Position and velocity after a time h on the Kepler orbit of parameter mu, in place.
+//Universal variable formulation (Danby, Fundamentals of Celestial Mechanics) : works for any eccentricity.
+inline void kepler_drift(double r[3], double v[3], double mu, double h){
+    double r0 = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    double eta = r[0] * v[0] + r[1] * v[1] + r[2] * v[2];
+    double beta = 2.0 * mu / r0 - (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    //Stumpff functions c0 ... c3 of z = beta s^2, by series after reducing z, then doubling back.
+    auto stumpff = [](double z, double c[4]){
+        int halvings = 0;
+        while (std::fabs(z) > 0.1){z *= 0.25; halvings++;}
+        c[2] = (1.0 - z * (1.0 - z * (1.0 - z * (1.0 - z * (1.0 - z / 132.0) / 90.0) / 56.0) / 30.0) / 12.0) / 2.0;
+        c[3] = (1.0 - z * (1.0 - z * (1.0 - z * (1.0 - z * (1.0 - z / 156.0) / 110.0) / 72.0) / 42.0) / 20.0) / 6.0;
+        c[1] = 1.0 - z * c[3];
+        c[0] = 1.0 - z * c[2];
+        for (; halvings > 0; halvings--){
+            c[3] = (c[2] + c[0] * c[3]) * 0.25;
+            c[2] = c[1] * c[1] * 0.5;
+            c[1] = c[0] * c[1];
+            c[0] = 2.0 * c[0] * c[0] - 1.0;
+        }
+    };
+
+    //Newton iterations on the universal Kepler equation r0 G1 + eta G2 + mu G3 = h, with Gk = s^k ck(beta s^2).
+    double s = h / r0;
+    double c[4], g1 = 0.0, g2 = 0.0, g3 = 0.0, radius = r0;
+    for (int iteration = 0; iteration < 30; iteration++){
+        stumpff(beta * s * s, c);
+        g1 = s * c[1];
+        g2 = s * s * c[2];
+        g3 = s * s * s * c[3];
+        radius = r0 * c[0] + eta * g1 + mu * g2;
+        double ds = (r0 * g1 + eta * g2 + mu * g3 - h) / radius;
+        s -= ds;
+        if (std::fabs(ds) <= 1e-15 * std::fabs(s)){break;}
+    }
+    stumpff(beta * s * s, c);
+    g1 = s * c[1];
+    g2 = s * s * c[2];
+    g3 = s * s * s * c[3];
+    radius = r0 * c[0] + eta * g1 + mu * g2;
+
+    //f and g functions
+    double f = 1.0 - mu * g2 / r0;
+    double g = h - mu * g3;
+    double fdot = -mu * g1 / (radius * r0);
+    double gdot = 1.0 - mu * g2 / radius;
+    for (int k = 0; k < 3; k++){
+        double rk = r[k];
+        r[k] = f * rk + g * v[k];
+        v[k] = fdot * rk + gdot * v[k];
+    }
+}
+
+//Steps a set of bodies of a store with one of the schemes above. The forces are computed by the caller, which fills the
+//accelerations of the store for every body of the list. The accelerations of the end of a step are reused by the next
+//one, reset() must be called when the bodies are moved by something else.
+template <typename Store>
+class BasicSymplecticIntegrator {
+    public:
+        using real = typename Store::position_type;
+
+        explicit BasicSymplecticIntegrator(IntegratorScheme scheme = IntegratorScheme::Verlet) : _scheme(scheme){}
+
+        void set_scheme(IntegratorScheme scheme){
+            _scheme = scheme;
+        }
+        IntegratorScheme get_scheme() const {
+            return _scheme;
+        }
+        int get_evaluations_per_step() const {
+            switch (_scheme){
+                case IntegratorScheme::Yoshida4: return 3;
+                case IntegratorScheme::Yoshida6: return 7;
+                default: return 1;
+            }
+        }
+        //Number of calls to the force callback since the creation of the integrator.
+        uint64_t get_force_evaluations() const {
+            return _evaluations;
+        }
+        void reset(){
+            _ready = false;
+        }
+
+        //Bodies must come after their primary in the list. A primary outside of the list does not move.
+        template <typename Forces>
+        void step(Store& store, const std::vector<IntegratedBody>& bodies, double h, Forces&& compute_forces){
+            if (!_ready){
+                compute_forces();
+                _evaluations++;
+                _ready = true;
+            }
+            switch (_scheme){
+                case IntegratorScheme::Yoshida4:
+                    for (double w : YOSHIDA4){verlet(store, bodies, w * h, compute_forces);}
+                    break;
+                case IntegratorScheme::Yoshida6:
+                    for (double w : YOSHIDA6){verlet(store, bodies, w * h, compute_forces);}
+                    break;
+                case IntegratorScheme::WisdomHolman:
+                    wisdom_holman(store, bodies, h, compute_forces);
+                    break;
+                default:
+                    verlet(store, bodies, h, compute_forces);
+                    break;
+            }
+        }
+
+    private:
+        //w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 w1
+        static constexpr double YOSHIDA4[3] = {1.3512071919596578, -1.7024143839193153, 1.3512071919596578};
+        //Solution A of Yoshida (1990)
+        static constexpr double YOSHIDA6[7] = {0.78451361047755726, 0.23557321335935813, -1.1776799841788710,
+                                               1.3151863206839112,
+                                               -1.1776799841788710, 0.23557321335935813, 0.78451361047755726};
+
+        IntegratorScheme _scheme;
+        bool _ready = false;
+        uint64_t _evaluations = 0;
+        std::vector<uint32_t> _index; //Position in the list by store id (WisdomHolman)
+
+        template <typename Forces>
+        void verlet(Store& store, const std::vector<IntegratedBody>& bodies, double h, Forces& compute_forces){
+            kick(store, bodies, 0.5 * h);
+            for (const IntegratedBody& body : bodies){
+                uint32_t i = body.id;
+                store.x[i] += (real)h * store.vx[i];
+                store.y[i] += (real)h * store.vy[i];
+                store.z[i] += (real)h * store.vz[i];
+            }
+            compute_forces();
+            _evaluations++;
+            kick(store, bodies, 0.5 * h);
+        }
+        void kick(Store& store, const std::vector<IntegratedBody>& bodies, double h){
+            for (const IntegratedBody& body : bodies){
+                uint32_t i = body.id;
+                store.vx[i] += (real)(h * store.ax[i]);
+                store.vy[i] += (real)(h * store.ay[i]);
+                store.vz[i] += (real)(h * store.az[i]);
+            }
+        }
+
+        template <typename Forces>
+        void wisdom_holman(Store& store, const std::vector<IntegratedBody>& bodies, double h, Forces& compute_forces){
+            //Kick with the perturbation (total acceleration minus the one of the Kepler drift), drift, kick.
+            perturbation_kick(store, bodies, 0.5 * h);
+            kepler_drifts(store, bodies, h);
+            compute_forces();
+            _evaluations++;
+            perturbation_kick(store, bodies, 0.5 * h);
+        }
+
+        //Coordinates of the Kepler drift. A body moves on a Kepler orbit relative to its primary. When it pulls its
+        //primary back, the barycenter of the primary and of those satellites takes the orbit of the primary, and the
+        //primary is placed back from the satellites (Jacobi coordinates for one satellite) : the pull of the Moon on
+        //the Earth, fast and 1% of the pull of the Sun, is then not a perturbation.
+        void relative_states(const Store& store, const std::vector<IntegratedBody>& bodies){
+            std::size_t n = bodies.size();
+            _index.assign(store.size(), IntegratedBody::NO_PRIMARY);
+            for (std::size_t k = 0; k < n; k++){_index[bodies[k].id] = (uint32_t)k;}
+            _states.assign(n, KeplerState{});
+            for (std::size_t k = 0; k < n; k++){
+                KeplerState& state = _states[k];
+                uint32_t i = bodies[k].id, p = bodies[k].primary;
+                state.primary = p == IntegratedBody::NO_PRIMARY ? p : _index[p];
+                state.mass = store.m[i];
+                state.r[0] = store.x[i];  state.r[1] = store.y[i];  state.r[2] = store.z[i];
+                state.v[0] = store.vx[i]; state.v[1] = store.vy[i]; state.v[2] = store.vz[i];
+                if (p == IntegratedBody::NO_PRIMARY){continue;}
+                state.r[0] -= store.x[p];  state.r[1] -= store.y[p];  state.r[2] -= store.z[p];
+                state.v[0] -= store.vx[p]; state.v[1] -= store.vy[p]; state.v[2] -= store.vz[p];
+            }
+            //Satellites come after their primary : walking the list backwards, the group of a body is complete when it
+            //is reached.
+            for (std::size_t k = n; k-- > 0;){
+                uint32_t q = _states[k].primary;
+                if (bodies[k].pulls_primary && q != IntegratedBody::NO_PRIMARY){_states[q].mass += _states[k].mass;}
+            }
+            barycenter_offsets(bodies, true);
+        }
+        //Barycenter of each body and of its pulling satellites, relative to the body, from the barycentric states of
+        //the satellites. shift turns the states of the bodies into the ones of their barycenters on the way. A group
+        //without mass (massless body, massless satellites) has its barycenter on the body : zero offset.
+        void barycenter_offsets(const std::vector<IntegratedBody>& bodies, bool shift){
+            for (KeplerState& state : _states){
+                for (int c = 0; c < 3; c++){state.offset[c] = 0.0; state.offset_v[c] = 0.0;}
+            }
+            for (std::size_t k = bodies.size(); k-- > 0;){
+                KeplerState& state = _states[k];
+                for (int c = 0; c < 3; c++){
+                    if (state.mass > 0.0){
+                        state.offset[c] /= state.mass;
+                        state.offset_v[c] /= state.mass;
+                    }
+                    if (shift){state.r[c] += state.offset[c]; state.v[c] += state.offset_v[c];}
+                }
+                if (!bodies[k].pulls_primary || state.primary == IntegratedBody::NO_PRIMARY){continue;}
+                KeplerState& primary = _states[state.primary];
+                for (int c = 0; c < 3; c++){
+                    primary.offset[c] += state.mass * state.r[c];
+                    primary.offset_v[c] += state.mass * state.v[c];
+                }
+            }
+        }
+
+        void perturbation_kick(Store& store, const std::vector<IntegratedBody>& bodies, double h){
+            relative_states(store, bodies);
+            std::size_t n = bodies.size();
+            //Kepler acceleration of every state, then the acceleration of each body along the drift : the one of its
+            //primary, plus the one of its state, minus the share of its pulling satellites.
+            for (std::size_t k = 0; k < n; k++){
+                if (bodies[k].primary == IntegratedBody::NO_PRIMARY){continue;}
+                KeplerState& state = _states[k];
+                double r2 = state.r[0] * state.r[0] + state.r[1] * state.r[1] + state.r[2] * state.r[2];
+                double k_r3 = -bodies[k].mu / (r2 * std::sqrt(r2));
+                for (int c = 0; c < 3; c++){state.kepler[c] = k_r3 * state.r[c];}
+            }
+            for (std::size_t k = 0; k < n; k++){
+                KeplerState& state = _states[k];
+                if (!bodies[k].pulls_primary || state.primary == IntegratedBody::NO_PRIMARY){continue;}
+                KeplerState& primary = _states[state.primary];
+                if (primary.mass <= 0.0){continue;} //Massless group : no share to remove
+                for (int c = 0; c < 3; c++){primary.drift[c] -= state.mass / primary.mass * state.kepler[c];}
+            }
+            for (std::size_t k = 0; k < n; k++){
+                KeplerState& state = _states[k];
+                for (int c = 0; c < 3; c++){state.drift[c] += state.kepler[c];}
+                if (state.primary != IntegratedBody::NO_PRIMARY){
+                    for (int c = 0; c < 3; c++){state.drift[c] += _states[state.primary].drift[c];}
+                }
+                uint32_t i = bodies[k].id;
+                store.vx[i] += (real)(h * (store.ax[i] - state.drift[0]));
+                store.vy[i] += (real)(h * (store.ay[i] - state.drift[1]));
+                store.vz[i] += (real)(h * (store.az[i] - state.drift[2]));
+            }
+        }
+
+        void kepler_drifts(Store& store, const std::vector<IntegratedBody>& bodies, double h){
+            relative_states(store, bodies);
+            std::size_t n = bodies.size();
+            for (std::size_t k = 0; k < n; k++){
+                KeplerState& state = _states[k];
+                if (bodies[k].primary == IntegratedBody::NO_PRIMARY){
+                    for (int c = 0; c < 3; c++){state.r[c] += h * state.v[c];}
+                }
+                else {
+                    kepler_drift(state.r, state.v, bodies[k].mu, h);
+                }
+            }
+            //Every body is placed relative to the new position of its primary, back from its new barycenter.
+            barycenter_offsets(bodies, false);
+            for (std::size_t k = 0; k < n; k++){
+                const KeplerState& state = _states[k];
+                uint32_t i = bodies[k].id, p = bodies[k].primary;
+                double r[3] = {state.r[0] - state.offset[0], state.r[1] - state.offset[1], state.r[2] - state.offset[2]};
+                double v[3] = {state.v[0] - state.offset_v[0], state.v[1] - state.offset_v[1],
+                               state.v[2] - state.offset_v[2]};
+                if (p != IntegratedBody::NO_PRIMARY){
+                    r[0] += store.x[p];  r[1] += store.y[p];  r[2] += store.z[p];
+                    v[0] += store.vx[p]; v[1] += store.vy[p]; v[2] += store.vz[p];
+                }
+                store.x[i] = (real)r[0];  store.y[i] = (real)r[1];  store.z[i] = (real)r[2];
+                store.vx[i] = (real)v[0]; store.vy[i] = (real)v[1]; store.vz[i] = (real)v[2];
+            }
+        }
+
+        struct KeplerState {
+            uint32_t primary;   //Position of the primary in the list, NO_PRIMARY when it is not moved
+            double mass;        //Mass of the body and of its pulling satellites
+            double r[3], v[3];  //Relative to the primary (barycenter of the body and its pulling satellites)
+            double offset[3], offset_v[3];
+            double kepler[3], drift[3];
+        };
+        std::vector<KeplerState> _states;
+};
+
+using SymplecticIntegrator = BasicSymplecticIntegrator<BodyStore>;
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef TEST_PARTICLES_HPP
+#define TEST_PARTICLES_HPP
+
+#include "body_store.hpp"
+#include "gravity_kernel.hpp"
+#include "gravity_lanes.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+//Massive bodies pulling the test particles, gathered at the start of a step (positions in the precision of the store).
+struct ParticleSources {
+    aligned_vector<BodyStore::position_type> x, y, z;
+    std::vector<float> mu; //G * mass
+    std::size_t n = 0;
+
+    void resize(std::size_t count){
+        n = count;
+        x.resize(count); y.resize(count); z.resize(count);
+        mu.resize(count);
+    }
+};
+
+//Verlet step of the particles [begin, end) : a = sum of mu_j d / |d|^3 over the sources, with the lane arithmetic of
+//gravity_lanes.hpp so that every instruction set gives the scalar result. The acceleration is used at once and never
+//stored. h2 is dt * dt.
+namespace particle_kernel_detail {
+    using namespace gravity_lanes;
+
+    template <typename real>
+    inline void particles_scalar(real* x, real* y, real* z, real* xp, real* yp, real* zp, std::size_t begin,
+                                 std::size_t end, const ParticleSources& sources, real h2){
+        for (std::size_t p = begin; p < end; p++){
+            real ax = 0, ay = 0, az = 0;
+            for (std::size_t j = 0; j < sources.n; j++){
+                real dx = sources.x[j] - x[p];
+                real dy = sources.y[j] - y[p];
+                real dz = sources.z[j] - z[p];
+                real magnitude = sources.mu[j] * inverse_cube(dx, dy, dz);
+                ax += magnitude * dx;
+                ay += magnitude * dy;
+                az += magnitude * dz;
+            }
+            real rx = 2 * x[p] - xp[p] + h2 * ax;
+            real ry = 2 * y[p] - yp[p] + h2 * ay;
+            real rz = 2 * z[p] - zp[p] + h2 * az;
+            xp[p] = x[p]; yp[p] = y[p]; zp[p] = z[p];
+            x[p] = rx; y[p] = ry; z[p] = rz;
+        }
+    }
+
+#ifdef GRAVITY_KERNEL_X86
+    //Double precision positions only, begin aligned on the width. The last particles (less than the width) are left
+    //to the scalar version.
+    __attribute__((target("sse2")))
+    inline std::size_t particles_sse(double* x, double* y, double* z, double* xp, double* yp, double* zp,
+                                     std::size_t begin, std::size_t end, const ParticleSources& sources, double h2){
+        const __m128d two = _mm_set1_pd(2.0), step2 = _mm_set1_pd(h2);
+        std::size_t p = begin;
+        for (; p + 2 <= end; p += 2){
+            __m128d px = _mm_load_pd(x + p), py = _mm_load_pd(y + p), pz = _mm_load_pd(z + p);
+            __m128d ax = _mm_setzero_pd(), ay = _mm_setzero_pd(), az = _mm_setzero_pd();
+            for (std::size_t j = 0; j < sources.n; j++){
+                __m128d dx = _mm_sub_pd(_mm_set1_pd(sources.x[j]), px);
+                __m128d dy = _mm_sub_pd(_mm_set1_pd(sources.y[j]), py);
+                __m128d dz = _mm_sub_pd(_mm_set1_pd(sources.z[j]), pz);
+                __m128d a = _mm_mul_pd(_mm_set1_pd(sources.mu[j]), inverse_cube(dx, dy, dz));
+                ax = add_product(ax, a, dx);
+                ay = add_product(ay, a, dy);
+                az = add_product(az, a, dz);
+            }
+            __m128d rx = add_product(_mm_sub_pd(_mm_mul_pd(two, px), _mm_load_pd(xp + p)), step2, ax);
+            __m128d ry = add_product(_mm_sub_pd(_mm_mul_pd(two, py), _mm_load_pd(yp + p)), step2, ay);
+            __m128d rz = add_product(_mm_sub_pd(_mm_mul_pd(two, pz), _mm_load_pd(zp + p)), step2, az);
+            _mm_store_pd(xp + p, px); _mm_store_pd(yp + p, py); _mm_store_pd(zp + p, pz);
+            _mm_store_pd(x + p, rx); _mm_store_pd(y + p, ry); _mm_store_pd(z + p, rz);
+        }
+        return p;
+    }
+
+    __attribute__((target("avx2")))
+    inline std::size_t particles_avx2(double* x, double* y, double* z, double* xp, double* yp, double* zp,
+                                      std::size_t begin, std::size_t end, const ParticleSources& sources, double h2){
+        const __m256d two = _mm256_set1_pd(2.0), step2 = _mm256_set1_pd(h2);
+        std::size_t p = begin;
+        for (; p + 4 <= end; p += 4){
+            __m256d px = _mm256_load_pd(x + p), py = _mm256_load_pd(y + p), pz = _mm256_load_pd(z + p);
+            __m256d ax = _mm256_setzero_pd(), ay = _mm256_setzero_pd(), az = _mm256_setzero_pd();
+            for (std::size_t j = 0; j < sources.n; j++){
+                __m256d dx = _mm256_sub_pd(_mm256_set1_pd(sources.x[j]), px);
+                __m256d dy = _mm256_sub_pd(_mm256_set1_pd(sources.y[j]), py);
+                __m256d dz = _mm256_sub_pd(_mm256_set1_pd(sources.z[j]), pz);
+                __m256d a = _mm256_mul_pd(_mm256_set1_pd(sources.mu[j]), inverse_cube(dx, dy, dz));
+                ax = add_product(ax, a, dx);
+                ay = add_product(ay, a, dy);
+                az = add_product(az, a, dz);
+            }
+            __m256d rx = add_product(_mm256_sub_pd(_mm256_mul_pd(two, px), _mm256_load_pd(xp + p)), step2, ax);
+            __m256d ry = add_product(_mm256_sub_pd(_mm256_mul_pd(two, py), _mm256_load_pd(yp + p)), step2, ay);
+            __m256d rz = add_product(_mm256_sub_pd(_mm256_mul_pd(two, pz), _mm256_load_pd(zp + p)), step2, az);
+            _mm256_store_pd(xp + p, px); _mm256_store_pd(yp + p, py); _mm256_store_pd(zp + p, pz);
+            _mm256_store_pd(x + p, rx); _mm256_store_pd(y + p, ry); _mm256_store_pd(z + p, rz);
+        }
+        return p;
+    }
+
+    __attribute__((target("avx512f")))
+    inline std::size_t particles_avx512(double* x, double* y, double* z, double* xp, double* yp, double* zp,
+                                        std::size_t begin, std::size_t end, const ParticleSources& sources, double h2){
+        const __m512d two = _mm512_set1_pd(2.0), step2 = _mm512_set1_pd(h2);
+        std::size_t p = begin;
+        for (; p + 8 <= end; p += 8){
+            __m512d px = _mm512_load_pd(x + p), py = _mm512_load_pd(y + p), pz = _mm512_load_pd(z + p);
+            __m512d ax = _mm512_setzero_pd(), ay = _mm512_setzero_pd(), az = _mm512_setzero_pd();
+            for (std::size_t j = 0; j < sources.n; j++){
+                __m512d dx = _mm512_sub_pd(_mm512_set1_pd(sources.x[j]), px);
+                __m512d dy = _mm512_sub_pd(_mm512_set1_pd(sources.y[j]), py);
+                __m512d dz = _mm512_sub_pd(_mm512_set1_pd(sources.z[j]), pz);
+                __m512d a = _mm512_mul_pd(_mm512_set1_pd(sources.mu[j]), inverse_cube(dx, dy, dz));
+                ax = add_product(ax, a, dx);
+                ay = add_product(ay, a, dy);
+                az = add_product(az, a, dz);
+            }
+            __m512d rx = add_product(sub_rounded(_mm512_mul_pd(two, px), _mm512_load_pd(xp + p)), step2, ax);
+            __m512d ry = add_product(sub_rounded(_mm512_mul_pd(two, py), _mm512_load_pd(yp + p)), step2, ay);
+            __m512d rz = add_product(sub_rounded(_mm512_mul_pd(two, pz), _mm512_load_pd(zp + p)), step2, az);
+            _mm512_store_pd(xp + p, px); _mm512_store_pd(yp + p, py); _mm512_store_pd(zp + p, pz);
+            _mm512_store_pd(x + p, rx); _mm512_store_pd(y + p, ry); _mm512_store_pd(z + p, rz);
+        }
+        return p;
+    }
+#endif
+
+}
+
+//Verlet step of the particles [begin, end) with the instruction set level, begin aligned on the widest register.
+template <typename real>
+inline void step_particles(real* x, real* y, real* z, real* xp, real* yp, real* zp, std::size_t begin,
+                           std::size_t end, const ParticleSources& sources, real h2, SimdLevel level){
+    using namespace particle_kernel_detail;
+#ifdef GRAVITY_KERNEL_X86
+    if constexpr (std::is_same<real, double>::value){
+        switch (level){
+            case SimdLevel::AVX512: begin = particles_avx512(x, y, z, xp, yp, zp, begin, end, sources, h2); break;
+            case SimdLevel::AVX2:   begin = particles_avx2(x, y, z, xp, yp, zp, begin, end, sources, h2); break;
+            case SimdLevel::SSE:    begin = particles_sse(x, y, z, xp, yp, zp, begin, end, sources, h2); break;
+            default: break;
+        }
+    }
+#endif
+    particles_scalar(x, y, z, xp, yp, zp, begin, end, sources, h2);
+}
+
+//Massless bodies : they feel the massive bodies of an OrbitalSystem but pull nothing, a step costs
+//O(N_massive x N_particles) instead of the O(N^2) of bodies of the tree (spacecraft, debris, dust).
+//The particles have their own structure of arrays with the state of the position Verlet (position, previous position),
+//and are moved with the sources at their positions of the start of the step.
+//A step walks the particles in chunks of CHUNK, one task of the thread pool each, and for a register of particles sums
+//the pull of every source then moves them : 48 bytes per particle are read and written, nothing else.
+//The result depends neither on the thread count nor on the instruction set.
+class TestParticles {
+    public:
+        using real = BodyStore::position_type;
+        using vec_type = BodyStore::vec_type;
+        static constexpr std::size_t CHUNK = 16384; //Multiple of the widest register, aligned loads
+
+        aligned_vector<real> x, y, z;
+        aligned_vector<real> x_prev, y_prev, z_prev;
+
+        std::size_t size() const {
+            return x.size();
+        }
+        bool empty() const {
+            return x.empty();
+        }
+        void reserve(std::size_t n){
+            for (auto* array : {&x, &y, &z, &x_prev, &y_prev, &z_prev}){array->reserve(n);}
+        }
+        //Particle at r with the velocity v, its previous position set up for the step h with its acceleration from
+        //the sources (as CelestialBody::setup_verlet()). Returns its index.
+        std::size_t add(const vec_type& r, const vec_type& v, const ParticleSources& sources, float h){
+            vec_type a = acceleration_at(r, sources);
+            x.push_back(r.x);
+            y.push_back(r.y);
+            z.push_back(r.z);
+            x_prev.push_back(r.x - v.x * h + (real)0.5f * h * h * a.x);
+            y_prev.push_back(r.y - v.y * h + (real)0.5f * h * h * a.y);
+            z_prev.push_back(r.z - v.z * h + (real)0.5f * h * h * a.z);
+            return x.size() - 1;
+        }
+        vec_type get_pos(std::size_t p) const {
+            return {x[p], y[p], z[p]};
+        }
+        //Mean velocity over the last step h.
+        vec_type get_velocity(std::size_t p, float h) const {
+            return (get_pos(p) - vec_type(x_prev[p], y_prev[p], z_prev[p])) / (real)h;
+        }
+
+        void step(const ParticleSources& sources, float h, SimdLevel level, ThreadPool& pool = ThreadPool::instance()){
+            std::size_t n = size();
+            real h2 = (real)h * h;
+            pool.run((n + CHUNK - 1) / CHUNK, [&](std::size_t chunk){
+                std::size_t begin = chunk * CHUNK;
+                step_particles(x.data(), y.data(), z.data(), x_prev.data(), y_prev.data(), z_prev.data(), begin,
+                               std::min(n, begin + CHUNK), sources, h2, level);
+            });
+        }
+
+        static vec_type acceleration_at(const vec_type& r, const ParticleSources& sources){
+            vec_type a(0);
+            for (std::size_t j = 0; j < sources.n; j++){
+                vec_type d = vec_type(sources.x[j], sources.y[j], sources.z[j]) - r;
+                real norm = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+                if (norm > 0){a += (real)(sources.mu[j] / ((double)norm * norm * norm)) * d;}
+            }
+            return a;
+        }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Persistent worker threads, started once and reused by every step (spawning threads at each force evaluation
+//costs more than the evaluation itself for small systems).
+//run(count, task) calls task(0) ... task(count - 1), the calling thread takes tasks too. Tasks are handed out
+//dynamically : which thread runs a task is not fixed, so determinism must come from how the work is split into
+//tasks, never from the thread count. run() must not be called from inside a task.
+class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int threads = std::thread::hardware_concurrency()){
+            start(threads);
+        }
+        ~ThreadPool(){
+            stop();
+        }
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        //Pool shared by every OrbitalSystem of the process.
+        static ThreadPool& instance(){
+            static ThreadPool pool;
+            return pool;
+        }
+
+        //Number of threads running the tasks, the calling thread included. 1 runs everything on the caller.
+        void set_thread_count(unsigned int threads){
+            if (std::max(1u, threads) == get_thread_count()){return;}
+            stop();
+            start(threads);
+        }
+        unsigned int get_thread_count() const {
+            return (unsigned int)_workers.size() + 1;
+        }
+
+        template <typename F>
+        void run(std::size_t count, F&& task){
+            if (_workers.empty() || count <= 1){
+                for (std::size_t k = 0; k < count; k++){task(k);}
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                using Task = std::remove_reference_t<F>;
+                _context = (void*)&task;
+                _invoke = [](void* context, std::size_t k){(*static_cast<Task*>(context))(k);};
+                _count = count;
+                _next.store(0);
+                _active = _workers.size();
+                _generation++;
+            }
+            _wake.notify_all();
+            work();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [this](){return _active == 0;});
+        }
+
+    private:
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wake, _done;
+        void* _context = nullptr;
+        void (*_invoke)(void*, std::size_t) = nullptr;
+        std::size_t _count = 0;
+        std::atomic<std::size_t> _next{0};
+        std::size_t _active = 0;     //Workers still busy with the current run
+        uint64_t _generation = 0;    //Incremented by each run, wakes the workers
+        bool _stopping = false;
+
+        void start(unsigned int threads){
+            _stopping = false;
+            //The generation is read here and not by the worker, which could otherwise miss a run started before it.
+            uint64_t generation = _generation;
+            for (unsigned int t = 1; t < std::max(1u, threads); t++){
+                _workers.emplace_back([this, generation](){worker(generation);});
+            }
+        }
+        void stop(){
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+            for (auto& worker : _workers){worker.join();}
+            _workers.clear();
+        }
+
+        void work(){
+            for (std::size_t k = _next.fetch_add(1); k < _count; k = _next.fetch_add(1)){
+                _invoke(_context, k);
+            }
+        }
+
+        void worker(uint64_t seen){
+            while (true){
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _wake.wait(lock, [&](){return _stopping || _generation != seen;});
+                    if (_stopping){return;}
+                    seen = _generation;
+                }
+                work();
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_active == 0){_done.notify_one();}
+            }
+        }
+};
+
+#endif
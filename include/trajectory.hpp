@@ -0,0 +1,11 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <vector>
+#include "force.hpp"
+
+std::vector<double> position_t(const double t, const double v0, const double g, const double alpha, const double beta, const std::vector<double> init_pos);
+
+std::vector<std::vector<double>> compute_traj_frictionless (const double v0,  int nb_points,const std::vector<double> init_angle, const std::vector<double> init_pos, Force Poids);
+
+#endif
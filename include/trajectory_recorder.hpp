@@ -0,0 +1,457 @@
+#ifndef TRAJECTORY_RECORDER_HPP
+#define TRAJECTORY_RECORDER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "body_store.hpp"
+#include "mapped_file.hpp"
+
+//Time history of every body of a store, recorded every K steps without slowing the simulation down.
+//record() quantizes the positions into a preallocated chunk (the only work done by the stepping thread), a full chunk
+//is handed to a writer thread which compresses it and appends it to the file. The stepping thread never waits for the
+//disk : if the writer falls behind, a new chunk is allocated instead of waiting for a free one.
+//
+//Compression of a chunk, body by body and coordinate by coordinate (each chunk decodes alone) :
+//  - positions quantized to a grid of quantum meters (1 km by default, finer than a float at 1 AU : ~16 km)
+//  - residual against the quadratic extrapolation of the 3 previous samples (orbits are smooth : the residual is the
+//    jerk of the motion over the interval, a few quanta for the planets)
+//  - zigzag then bit packing of groups of GROUP residuals at the width of their largest one
+//The first 3 samples of a sequence are varints. With K = 1, a sample of a body takes 1 to 1.5 bytes instead of the 12
+//of 3 floats (8 to 12 times smaller for the solar system and a belt), 7 times smaller with K = 4 : the residuals grow
+//as K^3.
+//
+//File : TrajectoryFileHeader, chunks (TrajectoryChunkHeader + data) one after the other, then the chunk index and a
+//TrajectoryFileFooter written by close(). The chunk headers alone allow to read a file whose recording was interrupted.
+
+struct TrajectoryFileHeader {
+    char magic[8];           //"ORBTRAJ"
+    uint32_t version;
+    uint32_t interval;       //Steps between two samples
+    uint64_t body_count;
+    double quantum;          //m
+    double dt;               //s, step of the simulation
+    uint32_t chunk_samples;  //Samples of a full chunk
+    uint32_t reserved;
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;          //CHUNK_MAGIC
+    uint32_t samples;
+    uint64_t first_step;
+    double first_time;       //s
+    uint64_t bytes;          //Compressed data following the header
+};
+
+//Entry of the chunk index.
+struct TrajectoryChunkInfo {
+    uint64_t offset;         //Of the chunk header, from the start of the file
+    uint64_t first_step;
+    double first_time;
+    uint32_t samples;
+    uint32_t reserved;
+    uint64_t bytes;
+};
+
+struct TrajectoryFileFooter {
+    uint64_t index_offset;
+    uint64_t chunk_count;
+    char magic[8];           //"ORBTRIX"
+};
+
+//Encoding shared by the recorder and the reader.
+namespace trajectory_codec {
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t CHUNK_MAGIC = 0x4B4E4843; //"CHNK"
+    static constexpr int GROUP = 16; //Residuals sharing a bit width
+
+    inline uint64_t zigzag(int64_t v){
+        return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    }
+    inline int64_t unzigzag(uint64_t u){
+        return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    }
+    inline void put_varint(std::vector<uint8_t>& out, uint64_t u){
+        while (u >= 0x80){
+            out.push_back((uint8_t)(u | 0x80));
+            u >>= 7;
+        }
+        out.push_back((uint8_t)u);
+    }
+    inline uint64_t get_varint(const uint8_t*& in, const uint8_t* end){
+        uint64_t u = 0;
+        for (int shift = 0; in < end && shift < 64; shift += 7){
+            uint8_t byte = *in++;
+            u |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)){return u;}
+        }
+        throw std::invalid_argument("ERROR::TRAJECTORY::CORRUPTED_CHUNK");
+    }
+    //Quadratic extrapolation from the previous samples (fewer at the start of the sequence).
+    inline int64_t predict(const int64_t* v, std::size_t s){
+        if (s == 0){return 0;}
+        if (s == 1){return v[0];}
+        if (s == 2){return 2 * v[1] - v[0];}
+        return 3 * v[s - 1] - 3 * v[s - 2] + v[s - 3];
+    }
+
+    //Appends the encoding of the sequence v[0 .. n - 1].
+    inline void encode(const int64_t* v, std::size_t n, std::vector<uint8_t>& out){
+        std::size_t head = n < 3 ? n : 3;
+        for (std::size_t s = 0; s < head; s++){put_varint(out, zigzag(v[s] - predict(v, s)));}
+        uint64_t residuals[GROUP];
+        for (std::size_t start = head; start < n; start += GROUP){
+            std::size_t count = std::min<std::size_t>(GROUP, n - start);
+            uint64_t all = 0;
+            for (std::size_t k = 0; k < count; k++){
+                residuals[k] = zigzag(v[start + k] - predict(v, start + k));
+                all |= residuals[k];
+            }
+            int width = 0;
+            while (width < 64 && (all >> width) != 0){width++;}
+            out.push_back((uint8_t)width);
+            //Packed little endian, count * width bits rounded up to a byte.
+            uint64_t buffer = 0;
+            int filled = 0;
+            for (std::size_t k = 0; k < count; k++){
+                uint64_t r = residuals[k];
+                int left = width;
+                while (left > 0){
+                    int take = std::min(left, 64 - filled);
+                    uint64_t part = take == 64 ? r : r & ((1ull << take) - 1);
+                    buffer |= part << filled;
+                    filled += take;
+                    r = take == 64 ? 0 : r >> take;
+                    left -= take;
+                    while (filled >= 8){
+                        out.push_back((uint8_t)buffer);
+                        buffer >>= 8;
+                        filled -= 8;
+                    }
+                }
+            }
+            if (filled > 0){out.push_back((uint8_t)buffer);}
+        }
+    }
+    //Decodes n values written by encode(), returns the position after them.
+    inline const uint8_t* decode(const uint8_t* in, const uint8_t* end, std::size_t n, int64_t* v){
+        std::size_t head = n < 3 ? n : 3;
+        for (std::size_t s = 0; s < head; s++){v[s] = predict(v, s) + unzigzag(get_varint(in, end));}
+        for (std::size_t start = head; start < n; start += GROUP){
+            std::size_t count = std::min<std::size_t>(GROUP, n - start);
+            if (in >= end){throw std::invalid_argument("ERROR::TRAJECTORY::CORRUPTED_CHUNK");}
+            int width = *in++;
+            std::size_t bytes = (count * width + 7) / 8;
+            if (width > 64 || (std::size_t)(end - in) < bytes){throw std::invalid_argument("ERROR::TRAJECTORY::CORRUPTED_CHUNK");}
+            std::size_t bit = 0;
+            for (std::size_t k = 0; k < count; k++){
+                uint64_t r = 0;
+                for (int got = 0; got < width;){
+                    std::size_t byte = bit >> 3;
+                    int offset = (int)(bit & 7);
+                    int take = std::min(width - got, 8 - offset);
+                    r |= (uint64_t)((in[byte] >> offset) & ((1u << take) - 1)) << got;
+                    got += take;
+                    bit += take;
+                }
+                v[start + k] = predict(v, start + k) + unzigzag(r);
+            }
+            in += bytes;
+        }
+        return in;
+    }
+}
+
+class TrajectoryRecorder {
+    public:
+        static constexpr uint32_t DEFAULT_CHUNK_SAMPLES = 256;
+        static constexpr double DEFAULT_QUANTUM = 1000.0; //m
+
+        //Records the first bodies rows of the store every interval steps of step seconds into path (replaced).
+        //Throws std::invalid_argument for empty recordings, std::runtime_error if the file can't be created.
+        TrajectoryRecorder(const std::string& path, std::size_t bodies, double step, uint32_t interval = 1,
+                           uint32_t chunk_samples = DEFAULT_CHUNK_SAMPLES, double quantum = DEFAULT_QUANTUM) :
+        _bodies(bodies), _interval(interval), _chunk_samples(chunk_samples), _quantum(quantum), _inverse_quantum(1.0 / quantum){
+            if (bodies == 0 || !(step > 0.0) || interval == 0 || chunk_samples == 0 || !(quantum > 0.0)){
+                throw std::invalid_argument("ERROR::TRAJECTORY::INVALID_RECORDING");
+            }
+            _file = std::fopen(path.c_str(), "wb");
+            if (!_file){throw std::runtime_error("ERROR::TRAJECTORY::FILE_NOT_OPENED " + path);}
+            TrajectoryFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, "ORBTRAJ", 8);
+            header.version = trajectory_codec::VERSION;
+            header.interval = interval;
+            header.body_count = bodies;
+            header.quantum = quantum;
+            header.dt = step;
+            header.chunk_samples = chunk_samples;
+            std::fwrite(&header, sizeof(header), 1, _file);
+            _offset = sizeof(header);
+            //Two chunks : one filled by the simulation while the other is written.
+            for (int k = 0; k < 2; k++){_free.push_back(new_chunk());}
+            _thread = std::thread([this](){run();});
+        }
+        ~TrajectoryRecorder(){
+            close();
+        }
+        TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+        TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+        //To be called after each step by the thread stepping the store, step being the number of steps done : takes a
+        //sample every interval steps. Never waits for the writer.
+        void record(const BodyStore& store, double time, uint64_t step){
+            if (step % _interval != 0 || _closed){return;}
+            if (!_current){
+                _current = take_chunk();
+                _current->samples = 0;
+                _current->first_step = step;
+                _current->first_time = time;
+            }
+            std::size_t n = std::min(_bodies, store.size());
+            int64_t* q = _current->positions.data() + (std::size_t)_current->samples * _bodies * 3;
+            for (std::size_t i = 0; i < n; i++){
+                q[3 * i]     = (int64_t)std::llround(store.x[i] * _inverse_quantum);
+                q[3 * i + 1] = (int64_t)std::llround(store.y[i] * _inverse_quantum);
+                q[3 * i + 2] = (int64_t)std::llround(store.z[i] * _inverse_quantum);
+            }
+            //Rows missing from the store keep their last position.
+            for (std::size_t i = 3 * n; i < 3 * _bodies; i++){
+                q[i] = _current->samples > 0 ? *(q - 3 * _bodies + i) : 0;
+            }
+            _samples++;
+            if (++_current->samples == _chunk_samples){submit();}
+        }
+
+        //Writes the last partial chunk and the index, waits for the writer. Called by the destructor.
+        void close(){
+            if (_closed){return;}
+            _closed = true;
+            if (_current){submit();}
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+            if (_thread.joinable()){_thread.join();}
+            TrajectoryFileFooter footer;
+            std::memset(&footer, 0, sizeof(footer));
+            footer.index_offset = _offset;
+            footer.chunk_count = _index.size();
+            std::memcpy(footer.magic, "ORBTRIX", 8);
+            if (!_index.empty()){std::fwrite(_index.data(), sizeof(TrajectoryChunkInfo), _index.size(), _file);}
+            std::fwrite(&footer, sizeof(footer), 1, _file);
+            std::fclose(_file);
+            _file = nullptr;
+        }
+
+        uint64_t get_samples() const {
+            return _samples;
+        }
+        //Size of the samples as 3 floats a body, against the bytes written so far.
+        uint64_t get_raw_bytes() const {
+            return _samples * _bodies * 3 * sizeof(float);
+        }
+        uint64_t get_written_bytes() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _offset;
+        }
+        //Chunks allocated because the writer was behind (0 if the disk keeps up).
+        std::size_t get_extra_chunks() const {
+            return _extra_chunks;
+        }
+
+    private:
+        struct Chunk {
+            std::vector<int64_t> positions; //[sample][body][3], quantized
+            uint32_t samples = 0;
+            uint64_t first_step = 0;
+            double first_time = 0.0;
+        };
+
+        std::size_t _bodies;
+        uint32_t _interval;
+        uint32_t _chunk_samples;
+        double _quantum;
+        double _inverse_quantum;
+        std::FILE* _file = nullptr;
+        bool _closed = false;
+        uint64_t _samples = 0;
+        std::size_t _extra_chunks = 0;
+        std::unique_ptr<Chunk> _current; //Being filled by record()
+
+        mutable std::mutex _mutex;
+        std::condition_variable _wake;
+        std::deque<std::unique_ptr<Chunk>> _free, _full;
+        bool _stopping = false;
+        uint64_t _offset = 0; //End of the file
+        std::vector<TrajectoryChunkInfo> _index;
+        std::thread _thread;
+
+        std::unique_ptr<Chunk> new_chunk() const {
+            auto chunk = std::make_unique<Chunk>();
+            chunk->positions.resize((std::size_t)_chunk_samples * _bodies * 3);
+            return chunk;
+        }
+        std::unique_ptr<Chunk> take_chunk(){
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_free.empty()){
+                    std::unique_ptr<Chunk> chunk = std::move(_free.front());
+                    _free.pop_front();
+                    return chunk;
+                }
+            }
+            _extra_chunks++;
+            return new_chunk();
+        }
+        void submit(){
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _full.push_back(std::move(_current));
+            }
+            _wake.notify_all();
+        }
+
+        void run(){
+            std::vector<uint8_t> data;
+            std::vector<int64_t> sequence;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true){
+                _wake.wait(lock, [this](){return _stopping || !_full.empty();});
+                if (_full.empty()){return;} //Stopping once every chunk is written
+                std::unique_ptr<Chunk> chunk = std::move(_full.front());
+                _full.pop_front();
+                lock.unlock();
+
+                compress(*chunk, data, sequence);
+                TrajectoryChunkHeader header = {trajectory_codec::CHUNK_MAGIC, chunk->samples, chunk->first_step,
+                                                chunk->first_time, data.size()};
+                bool written = std::fwrite(&header, sizeof(header), 1, _file) == 1
+                            && std::fwrite(data.data(), 1, data.size(), _file) == data.size();
+                if (!written){std::cout << "ERROR::TRAJECTORY::WRITE_FAILED" << std::endl;}
+
+                lock.lock();
+                if (written){
+                    _index.push_back({_offset, chunk->first_step, chunk->first_time, chunk->samples, 0, data.size()});
+                    _offset += sizeof(header) + data.size();
+                }
+                _free.push_back(std::move(chunk));
+            }
+        }
+        void compress(const Chunk& chunk, std::vector<uint8_t>& data, std::vector<int64_t>& sequence) const {
+            data.clear();
+            sequence.resize(chunk.samples);
+            for (std::size_t i = 0; i < 3 * _bodies; i++){
+                for (uint32_t s = 0; s < chunk.samples; s++){sequence[s] = chunk.positions[s * _bodies * 3 + i];}
+                trajectory_codec::encode(sequence.data(), chunk.samples, data);
+            }
+        }
+};
+
+//Reads back a recorded file, mapped (see mapped_file.hpp) : only the chunks read are loaded from the disk, any chunk
+//alone, in any order.
+class TrajectoryReader {
+    public:
+        //Throws std::runtime_error if the file can't be mapped, std::invalid_argument if it is not a trajectory.
+        explicit TrajectoryReader(const std::string& path){
+            _data = map_file(path, _size);
+            if (_size < sizeof(_header)){throw std::invalid_argument("ERROR::TRAJECTORY::NOT_A_TRAJECTORY");}
+            std::memcpy(&_header, _data.get(), sizeof(_header));
+            if (std::memcmp(_header.magic, "ORBTRAJ", 8) != 0){
+                throw std::invalid_argument("ERROR::TRAJECTORY::NOT_A_TRAJECTORY");
+            }
+            if (_header.version != trajectory_codec::VERSION){
+                throw std::invalid_argument("ERROR::TRAJECTORY::UNSUPPORTED_VERSION");
+            }
+            if (!read_index()){scan_chunks();}
+            for (const TrajectoryChunkInfo& chunk : _index){_samples += chunk.samples;}
+        }
+
+        const TrajectoryFileHeader& get_header() const {
+            return _header;
+        }
+        std::size_t get_body_count() const {
+            return (std::size_t)_header.body_count;
+        }
+        std::size_t get_chunk_count() const {
+            return _index.size();
+        }
+        const TrajectoryChunkInfo& get_chunk(std::size_t k) const {
+            return _index[k];
+        }
+        uint64_t get_sample_count() const {
+            return _samples;
+        }
+
+        //Positions of the samples of chunk k, in m : positions[(sample * bodies + body) * 3 + coordinate].
+        void read_chunk(std::size_t k, std::vector<double>& positions){
+            const TrajectoryChunkInfo& chunk = _index.at(k);
+            const uint8_t* in = _data.get() + chunk.offset + sizeof(TrajectoryChunkHeader);
+            const uint8_t* end = in + chunk.bytes;
+            std::size_t bodies = get_body_count();
+            positions.resize((std::size_t)chunk.samples * bodies * 3);
+            _sequence.resize(chunk.samples);
+            for (std::size_t i = 0; i < 3 * bodies; i++){
+                in = trajectory_codec::decode(in, end, chunk.samples, _sequence.data());
+                for (uint32_t s = 0; s < chunk.samples; s++){
+                    positions[s * bodies * 3 + i] = (double)_sequence[s] * _header.quantum;
+                }
+            }
+        }
+
+    private:
+        std::shared_ptr<const unsigned char> _data;
+        std::size_t _size = 0;
+        TrajectoryFileHeader _header;
+        std::vector<TrajectoryChunkInfo> _index;
+        uint64_t _samples = 0;
+        std::vector<int64_t> _sequence;
+
+        bool read_index(){
+            TrajectoryFileFooter footer;
+            if (_size < sizeof(_header) + sizeof(footer)){return false;}
+            std::memcpy(&footer, _data.get() + _size - sizeof(footer), sizeof(footer));
+            if (std::memcmp(footer.magic, "ORBTRIX", 8) != 0 || footer.index_offset > _size - sizeof(footer)
+                || footer.chunk_count > (_size - sizeof(footer) - footer.index_offset) / sizeof(TrajectoryChunkInfo)){
+                return false;
+            }
+            _index.resize(footer.chunk_count);
+            if (!_index.empty()){
+                std::memcpy(_index.data(), _data.get() + footer.index_offset, _index.size() * sizeof(TrajectoryChunkInfo));
+            }
+            for (const TrajectoryChunkInfo& chunk : _index){
+                if (chunk.offset + sizeof(TrajectoryChunkHeader) + chunk.bytes > footer.index_offset){return false;}
+            }
+            return true;
+        }
+        //Without index (interrupted recording) : every complete chunk from the start of the file.
+        void scan_chunks(){
+            _index.clear();
+            uint64_t offset = sizeof(TrajectoryFileHeader);
+            TrajectoryChunkHeader header;
+            while (offset + sizeof(header) <= _size){
+                std::memcpy(&header, _data.get() + offset, sizeof(header));
+                if (header.magic != trajectory_codec::CHUNK_MAGIC || header.bytes > _size - offset - sizeof(header)){
+                    break; //End of the chunks or truncated chunk
+                }
+                _index.push_back({offset, header.first_step, header.first_time, header.samples, 0, header.bytes});
+                offset += sizeof(header) + header.bytes;
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef TRAJECTORY_REPLAY_HPP
+#define TRAJECTORY_REPLAY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "position_snapshot.hpp"
+#include "trajectory_recorder.hpp"
+
+//Replay of a recorded trajectory (see trajectory_recorder.hpp) at any time, forwards or backwards, without physics.
+//The file is mapped and only the chunks around the requested time are decoded, the last CACHED_CHUNKS of them are
+//kept (bodies * chunk samples * 24 bytes each) : playing or scrubbing back and forth decodes a chunk every chunk
+//samples, jumping anywhere in the file costs one or two chunks.
+//Between two samples the positions follow a cubic Hermite curve. The recorder keeps no velocities (the Verlet state
+//has none), the tangents are the central differences of the neighbouring samples : exact for a cubic motion, the
+//error is the jerk term of the motion over a sample interval, far below the quantum of the recording at K = 1.
+class TrajectoryReplay {
+    public:
+        static constexpr std::size_t CACHED_CHUNKS = 4;
+
+        //Throws like TrajectoryReader, and std::invalid_argument for a recording without samples.
+        explicit TrajectoryReplay(const std::string& path) : _reader(path){
+            if (_reader.get_sample_count() == 0){throw std::invalid_argument("ERROR::TRAJECTORY::EMPTY_RECORDING");}
+            uint64_t first = 0;
+            for (std::size_t k = 0; k < _reader.get_chunk_count(); k++){
+                _first_sample.push_back(first);
+                first += _reader.get_chunk(k).samples;
+            }
+            _cache.resize(CACHED_CHUNKS);
+        }
+
+        std::size_t get_body_count() const {
+            return _reader.get_body_count();
+        }
+        uint64_t get_sample_count() const {
+            return _reader.get_sample_count();
+        }
+        //Simulated time of the first and last samples, s.
+        double get_start_time() const {
+            return get_sample_time(0);
+        }
+        double get_end_time() const {
+            return get_sample_time(get_sample_count() - 1);
+        }
+        double get_sample_time(uint64_t sample) const {
+            std::size_t k = chunk_of(sample);
+            const TrajectoryChunkInfo& chunk = _reader.get_chunk(k);
+            return chunk.first_time + (double)(sample - _first_sample[k]) * sample_interval();
+        }
+
+        //Positions at time (clamped to the recording) into snapshot, by store id like PositionSnapshot::capture() :
+        //render_system() draws them as a state of the physics thread.
+        void sample(double time, PositionSnapshot& snapshot){
+            time = std::min(std::max(time, get_start_time()), get_end_time());
+            uint64_t last = get_sample_count() - 1;
+            uint64_t s0 = sample_before(time);
+            uint64_t s1 = std::min(s0 + 1, last);
+            double t0 = get_sample_time(s0);
+            double t1 = get_sample_time(s1);
+            double h = t1 - t0;
+            double u = h > 0.0 ? (time - t0) / h : 0.0;
+
+            //Neighbours for the tangents, the ends of the recording fall back to one sided differences.
+            uint64_t sp = s0 > 0 ? s0 - 1 : s0;
+            uint64_t sn = std::min(s1 + 1, last);
+            double tp = get_sample_time(sp), tn = get_sample_time(sn);
+            const double* p0 = sample_positions(s0);
+            const double* p1 = sample_positions(s1);
+            const double* pp = sample_positions(sp);
+            const double* pn = sample_positions(sn);
+
+            double u2 = u * u, u3 = u2 * u;
+            double h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u, h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+            //Tangents scaled to the interval : h * velocity
+            double m0 = tp < t1 ? h / (t1 - tp) : 0.0;
+            double m1 = t0 < tn ? h / (tn - t0) : 0.0;
+            std::size_t bodies = get_body_count();
+            snapshot.positions.resize(bodies);
+            for (std::size_t i = 0; i < bodies; i++){
+                glm::dvec3 a(p0[3 * i], p0[3 * i + 1], p0[3 * i + 2]);
+                glm::dvec3 b(p1[3 * i], p1[3 * i + 1], p1[3 * i + 2]);
+                glm::dvec3 before(pp[3 * i], pp[3 * i + 1], pp[3 * i + 2]);
+                glm::dvec3 after(pn[3 * i], pn[3 * i + 1], pn[3 * i + 2]);
+                glm::dvec3 v0 = (b - before) * m0;
+                glm::dvec3 v1 = (after - a) * m1;
+                snapshot.positions[i] = glm::vec3(h00 * a + h10 * v0 + h01 * b + h11 * v1);
+            }
+            const TrajectoryFileHeader& header = _reader.get_header();
+            snapshot.time = time;
+            snapshot.steps = _reader.get_chunk(chunk_of(s0)).first_step + (s0 - _first_sample[chunk_of(s0)]) * header.interval;
+            snapshot.steps_per_second = 0.0;
+        }
+
+    private:
+        struct CachedChunk {
+            std::size_t chunk = SIZE_MAX;
+            uint64_t last_use = 0;
+            std::vector<double> positions;
+        };
+
+        TrajectoryReader _reader;
+        std::vector<uint64_t> _first_sample; //Of each chunk, in the samples of the whole recording
+        std::vector<CachedChunk> _cache;
+        uint64_t _uses = 0;
+
+        double sample_interval() const {
+            const TrajectoryFileHeader& header = _reader.get_header();
+            return header.interval * header.dt;
+        }
+        std::size_t chunk_of(uint64_t sample) const {
+            auto next = std::upper_bound(_first_sample.begin(), _first_sample.end(), sample);
+            return (std::size_t)(next - _first_sample.begin()) - 1;
+        }
+        //Last sample at or before time (first sample before the recording).
+        uint64_t sample_before(double time) const {
+            std::size_t lo = 0, hi = _reader.get_chunk_count();
+            while (hi - lo > 1){
+                std::size_t mid = (lo + hi) / 2;
+                if (_reader.get_chunk(mid).first_time <= time){lo = mid;}
+                else {hi = mid;}
+            }
+            const TrajectoryChunkInfo& chunk = _reader.get_chunk(lo);
+            double local = sample_interval() > 0.0 ? (time - chunk.first_time) / sample_interval() : 0.0;
+            uint64_t offset = (uint64_t)std::max(0.0, std::floor(local));
+            return _first_sample[lo] + std::min<uint64_t>(offset, chunk.samples - 1);
+        }
+        //Positions of one sample (3 per body). Valid until CACHED_CHUNKS - 1 other chunks are decoded.
+        const double* sample_positions(uint64_t sample){
+            std::size_t k = chunk_of(sample);
+            CachedChunk* slot = &_cache[0];
+            for (CachedChunk& cached : _cache){
+                if (cached.chunk == k){
+                    slot = &cached;
+                    break;
+                }
+                if (cached.last_use < slot->last_use){slot = &cached;}
+            }
+            if (slot->chunk != k){
+                _reader.read_chunk(k, slot->positions);
+                slot->chunk = k;
+            }
+            slot->last_use = ++_uses;
+            return slot->positions.data() + (std::size_t)(sample - _first_sample[k]) * get_body_count() * 3;
+        }
+};
+
+#endif
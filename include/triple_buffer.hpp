@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+//Lock-free single producer / single consumer exchange of the latest value.
+//Three slots : the writer fills its own slot then publish() swaps it with the middle one, the reader takes the middle
+//slot with update() if it holds a newer value. Neither side ever waits for the other : the writer may publish many
+//times between two reads (the intermediate values are skipped), the reader keeps its slot as long as it wants.
+//The slots are preallocated T : reusing their memory (e.g. resize() of the same size) makes publishing allocation free.
+template <typename T>
+class TripleBuffer {
+    public:
+        //Slot of the writer, only touched by the writing thread.
+        T& write_buffer(){
+            return _slots[_write];
+        }
+        //Makes the write buffer the latest value and gets the old middle slot to write the next one.
+        void publish(){
+            uint8_t previous = _middle.exchange(_write | FRESH, std::memory_order_acq_rel);
+            _write = previous & INDEX;
+        }
+
+        //Takes the latest published value if there is a new one. Returns false if read_buffer() did not change.
+        bool update(){
+            if (!(_middle.load(std::memory_order_relaxed) & FRESH)){return false;}
+            uint8_t previous = _middle.exchange(_read, std::memory_order_acq_rel);
+            _read = previous & INDEX;
+            return true;
+        }
+        //Slot of the reader, only touched by the reading thread.
+        const T& read_buffer() const {
+            return _slots[_read];
+        }
+
+    private:
+        static constexpr uint8_t INDEX = 3;
+        static constexpr uint8_t FRESH = 4; //The middle slot was published and not read yet
+
+        T _slots[3];
+        alignas(64) uint8_t _write = 0;
+        alignas(64) uint8_t _read = 1;
+        alignas(64) std::atomic<uint8_t> _middle{2};
+};
+
+#endif
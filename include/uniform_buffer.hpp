@@ -0,0 +1,91 @@
+#ifndef UNIFORM_BUFFER_HPP
+#define UNIFORM_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+//Binding points of the std140 blocks shared by the shaders : a program binds the blocks it declares to them at its
+//link (see Shader), the UniformBuffer bound there feeds all the programs at once.
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint LIGHT_BLOCK_BINDING = 1;
+
+//layout (std140) uniform Camera {mat4 view; mat4 projection; vec3 viewPos;};
+struct CameraBlock {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float padding = 0.0f;
+};
+static_assert(offsetof(CameraBlock, projection) == 64 && offsetof(CameraBlock, viewPos) == 128 &&
+              sizeof(CameraBlock) == 144, "std140 layout of the Camera block");
+
+//layout (std140) uniform Light {vec3 position; float constant; ...} light; : in std140 a vec3 followed by a float
+//fills 16 bytes, the fields are paired so. Each shader reads the fields of its kind of light.
+struct LightBlock {
+    glm::vec3 position = glm::vec3(0.0f);
+    float constant = 1.0f;
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); //Directional and spot lights
+    float linear = 0.0f;
+    glm::vec3 ambient = glm::vec3(0.2f);
+    float quadratic = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.5f);
+    float cutOff = 0.0f;                                //Cosines of the angles of a spot light
+    glm::vec3 specular = glm::vec3(1.0f);
+    float outerCutOff = 0.0f;
+};
+static_assert(offsetof(LightBlock, direction) == 16 && offsetof(LightBlock, ambient) == 32 &&
+              offsetof(LightBlock, diffuse) == 48 && offsetof(LightBlock, specular) == 64 &&
+              sizeof(LightBlock) == 80, "std140 layout of the Light block");
+
+//Binding point of a block declared by a shader, GL_INVALID_INDEX for a block of its own.
+inline GLuint uniform_block_binding(const char* name){
+    if (std::strcmp(name, "Camera") == 0){return CAMERA_BLOCK_BINDING;}
+    if (std::strcmp(name, "Light") == 0){return LIGHT_BLOCK_BINDING;}
+    return GL_INVALID_INDEX;
+}
+
+//Uniform buffer of one std140 block, bound to its binding point for its whole life : update() it once per frame
+//before the draws, the programs read it from there instead of a copy of the values each.
+template <typename Block>
+class UniformBuffer {
+    public:
+        explicit UniformBuffer(GLuint binding, const Block& block = Block()) : _block(block), _binding(binding){
+            glGenBuffers(1, &_UBO);
+            glBindBuffer(GL_UNIFORM_BUFFER, _UBO);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &_block, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, _binding, _UBO);
+        }
+        ~UniformBuffer(){
+            if (_UBO != 0){glDeleteBuffers(1, &_UBO);}
+        }
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+        //Uploads block, unless it is the one already in the buffer (a still camera costs nothing).
+        void update(const Block& block){
+            if (std::memcmp(&block, &_block, sizeof(Block)) == 0){return;}
+            _block = block;
+            glBindBuffer(GL_UNIFORM_BUFFER, _UBO);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &_block);
+        }
+        const Block& get() const {
+            return _block;
+        }
+        GLuint get_binding() const {
+            return _binding;
+        }
+        unsigned int get_UBO() const {
+            return _UBO;
+        }
+
+    private:
+        Block _block;
+        GLuint _binding;
+        unsigned int _UBO = 0;
+};
+
+#endif
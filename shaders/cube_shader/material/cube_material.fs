@@ -8,20 +8,27 @@ struct Material {
     float shininess;
 }; 
 
-struct Light {
-    vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 in vec3 FragPos;  
 in vec3 Normal;  
   
-uniform vec3 viewPos;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 uniform Material material;
-uniform Light light;
+layout (std140) uniform Light {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+} light;
 
 void main()
 {
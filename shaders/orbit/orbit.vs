@@ -2,8 +2,11 @@
 layout (location = 0) in vec3 Pos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main(){
     gl_Position = projection * view * model * vec4(Pos, 1.0f);
@@ -1,19 +1,35 @@
 #version 330 core
 layout (location = 0) in vec3 Pos;
 layout (location = 1) in vec3 Normal;
+#ifdef INSTANCED
+//Unit sphere shared by the instances (see sphere_instances.hpp), placed, scaled and colored per instance.
+layout (location = 3) in vec3 InstancePos;
+layout (location = 4) in float InstanceRadius;
+layout (location = 5) in vec4 InstanceColor;
+#else
 layout (location = 2) in vec3 Color;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 out vec4 vertexColor;
 out vec3 FragPos;
 out vec3 FragNormal;
 
 void main(){
+#ifdef INSTANCED
+    FragPos = InstancePos + InstanceRadius * Pos;
+    gl_Position = projection * view * vec4(FragPos, 1.0f);
+    vertexColor = vec4(InstanceColor.rgb, 1.0f);
+#else
     gl_Position = projection * view * model * vec4(Pos, 1.0f);
     vertexColor = vec4(Color,1.0f);
     FragPos = vec3(model * vec4(Pos, 1.0f));
+#endif
     FragNormal = Normal;
-};
\ No newline at end of file
+};
@@ -5,19 +5,23 @@ in vec3 FragPos;
 
 out vec4 FragColor;
 
-struct Light {
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+layout (std140) uniform Light {
     vec3 position;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
     float constant;
+    vec3 direction;
     float linear;
+    vec3 ambient;
     float quadratic;
-};
-  
-uniform vec3 viewPos;
-uniform Light light;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+} light;
 uniform float shininess;
 uniform float specularStrenght;
 
@@ -0,0 +1,294 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "ensemble.hpp"
+#include "scene_file.hpp"
+#include "solar_scene.hpp"
+#include "sphere.hpp"
+#include "trajectory.hpp"
+
+#ifdef BENCHMARK_MODEL
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#endif
+
+//Micro-benchmarks of the hot paths, written as JSON to track the regressions between versions :
+//  compute_acceleration_from  one pair, N bodies in the store (rows of the all-pairs sum)
+//  step                       OrbitalSystem::step of a sun and N - 1 orbiters, Exact and BarnesHut backends
+//  integrate                  Verlet update of the N bodies
+//  collision_detect           CollisionDetector::detect (broad and narrow phase) over one step of the N bodies
+//  ensemble_step              Ensemble::step of the solar system of orbital_sim, per member
+//  test_particles_step        OrbitalSystem::step of the solar system of orbital_sim with N test particles, per particle
+//  scene_load                 SceneFile::parse and build of a scene of N bodies, one line each (no GL), per body
+//  sphere_mesh                Sphere::build_mesh (no GL upload) by subdivision
+//  compute_traj_frictionless  by number of points
+//  model_import               Assimp import of obj/backpack/backpack.obj, with -DBENCHMARK_MODEL (links assimp)
+//Every measure repeats the operation for at least MIN_TIME, ns_per_op is the median of the repetitions divided by the
+//operations of one repetition, ns_per_op_min the fastest one.
+//Usage : benchmarks [output.json] [max N]   (JSON on the standard output without file)
+
+const double MIN_TIME = 0.2;   //s per measure
+const int MIN_REPETITIONS = 3;
+
+struct Measure {
+    std::string name;
+    std::string params;        //JSON object
+    uint64_t repetitions = 0;
+    double ops = 0.0;          //Operations per repetition
+    double ns_per_op = 0.0;
+    double ns_per_op_min = 0.0;
+    std::string skipped;       //Reason, when the measure could not run
+};
+
+template <typename F>
+Measure measure(const std::string& name, const std::string& params, double ops, F&& run){
+    using clock = std::chrono::steady_clock;
+    std::vector<double> times;
+    double total = 0.0;
+    run(); //Warm up
+    while (total < MIN_TIME || (int)times.size() < MIN_REPETITIONS){
+        auto start = clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        times.push_back(seconds);
+        total += seconds;
+        if (total > 20 * MIN_TIME && !times.empty()){break;} //The largest N : a single long repetition is enough
+    }
+    std::sort(times.begin(), times.end());
+    Measure m;
+    m.name = name;
+    m.params = params;
+    m.repetitions = times.size();
+    m.ops = ops;
+    m.ns_per_op = 1e9 * times[times.size() / 2] / ops;
+    m.ns_per_op_min = 1e9 * times.front() / ops;
+    std::cerr << name << " " << params << " : " << m.ns_per_op << " ns/op" << std::endl;
+    return m;
+}
+
+Measure skip(const std::string& name, const std::string& params, const std::string& reason){
+    Measure m;
+    m.name = name;
+    m.params = params;
+    m.skipped = reason;
+    std::cerr << name << " " << params << " : skipped, " << reason << std::endl;
+    return m;
+}
+
+std::string param(const char* key, long long value){
+    return std::string("{\"") + key + "\": " + std::to_string(value) + "}";
+}
+std::string param(const char* key, long long value, const char* key2, const char* value2){
+    return std::string("{\"") + key + "\": " + std::to_string(value) + ", \"" + key2 + "\": \"" + value2 + "\"}";
+}
+
+//Sun at the origin and n - 1 bodies of an asteroid belt (2 to 4 AU) on circular orbits, as in orbital_sim.
+struct Belt {
+    OrbitalSystem system;
+    std::vector<std::unique_ptr<CelestialBody>> bodies;
+
+    explicit Belt(std::size_t n){
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> radius(2.0f * AU, 4.0f * AU);
+        std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+        std::uniform_real_distribution<float> log_mass(15.0f, 21.0f);
+        system.reserve_bodies(n);
+        bodies.push_back(std::make_unique<CelestialBody>(std::vector<float>{0.0f, 0.0f, 0.0f},
+                                                         std::vector<float>{0.0f, 0.0f, 0.0f}, 696340e3f, 1.99e30f));
+        system.define_center(bodies.back().get());
+        system.fix_center(true);
+        for (std::size_t k = 1; k < n; k++){
+            float r = radius(gen);
+            float theta = angle(gen);
+            float v = std::sqrt(G * 1.99e30f / r);
+            bodies.push_back(std::make_unique<CelestialBody>(
+                std::vector<float>{r * std::cos(theta), r * std::sin(theta), 0.0f},
+                std::vector<float>{-v * std::sin(theta), v * std::cos(theta), 0.0f},
+                1e4f, std::pow(10.0f, log_mass(gen)), &system));
+            system.add_orbiters(bodies.back().get());
+        }
+        system.initialize();
+    }
+};
+
+void write_json(std::ostream& out, const std::vector<Measure>& measures){
+    out << "{\n";
+    out << "  \"context\": {\"precision\": \"" << (std::is_same<BodyStore::position_type, float>::value ? "single" : "mixed")
+        << "\", \"simd\": \"" << simd_level_name(detect_simd_level())
+        << "\", \"threads\": " << ThreadPool::instance().get_thread_count()
+        << ", \"compiler\": \"" << __VERSION__ << "\"},\n";
+    out << "  \"benchmarks\": [\n";
+    for (std::size_t k = 0; k < measures.size(); k++){
+        const Measure& m = measures[k];
+        out << "    {\"name\": \"" << m.name << "\", \"params\": " << m.params;
+        if (!m.skipped.empty()){
+            out << ", \"skipped\": \"" << m.skipped << "\"}";
+        }
+        else {
+            std::ostringstream values;
+            values.precision(6);
+            values << ", \"repetitions\": " << m.repetitions << ", \"ops_per_repetition\": " << m.ops
+                   << ", \"ns_per_op\": " << m.ns_per_op << ", \"ns_per_op_min\": " << m.ns_per_op_min
+                   << ", \"ops_per_second\": " << 1e9 / m.ns_per_op << "}";
+            out << values.str();
+        }
+        out << (k + 1 < measures.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv){
+    const char* output = argc > 1 ? argv[1] : nullptr;
+    std::size_t max_n = argc > 2 ? (std::size_t)std::atoll(argv[2]) : 100000;
+    std::vector<std::size_t> sizes;
+    for (std::size_t n : {10, 100, 1000, 10000, 100000}){
+        if (n <= max_n){sizes.push_back(n);}
+    }
+    std::vector<Measure> measures;
+
+    for (std::size_t n : sizes){
+        Belt belt(n);
+        std::vector<CelestialBody*> bodies;
+        for (auto& body : belt.bodies){bodies.push_back(body.get());}
+
+        //Whole rows of the all-pairs sum, a sample of them for the large N (~1e7 pairs per repetition at most).
+        std::size_t rows = std::max<std::size_t>(1, std::min(n, (std::size_t)1e7 / n));
+        std::size_t stride = n / rows;
+        measures.push_back(measure("compute_acceleration_from", param("n", n), (double)rows * n, [&](){
+            BodyStore::vec_type sum(0);
+            for (std::size_t r = 0; r < rows; r++){
+                CelestialBody* target = bodies[r * stride];
+                for (CelestialBody* source : bodies){
+                    if (source != target){sum += target->compute_acceleration_from(source);}
+                }
+            }
+            if (sum.x == 12345.0f){std::cerr << "";} //Keeps the loop alive
+        }));
+
+        measures.push_back(measure("integrate", param("n", n), (double)n, [&](){
+            for (CelestialBody* body : bodies){body->integrate();}
+        }));
+
+        {
+            //Swept spheres of one step of the belt, the radii of the bodies grown to 1000 km to get some contacts.
+            std::vector<uint32_t> ids;
+            std::vector<float> radius;
+            for (CelestialBody* body : bodies){
+                ids.push_back((uint32_t)body->get_id());
+                radius.push_back(std::max(body->get_radius(), 1e6f));
+            }
+            CollisionDetector detector;
+            detector.start(belt.system.get_store(), ids);
+            belt.system.step();
+            measures.push_back(measure("collision_detect", param("n", n), (double)n, [&](){
+                detector.detect(belt.system.get_store(), ids, radius);
+            }));
+        }
+
+        for (ForceBackend backend : {ForceBackend::Exact, ForceBackend::BarnesHut}){
+            const char* name = backend == ForceBackend::Exact ? "exact" : "barnes_hut";
+            belt.system.set_force_backend(backend);
+            measures.push_back(measure("step", param("n", n, "backend", name), 1.0, [&](){belt.system.step();}));
+        }
+    }
+
+    {
+        Scene scene;
+        build_scene(scene, 0);
+        for (std::size_t members : {8, 64, 1024}){
+            Ensemble ensemble(scene.system, members, 1000.0, 0.001);
+            measures.push_back(measure("ensemble_step", param("members", members), (double)members,
+                                       [&](){ensemble.step();}));
+        }
+    }
+
+    for (std::size_t n : {10000, 100000, 1000000}){
+        Scene scene;
+        build_scene(scene, 0);
+        add_test_belt(scene.system, n);
+        measures.push_back(measure("test_particles_step", param("n", n), (double)n, [&](){scene.system.step();}));
+    }
+
+    for (std::size_t n : {1000, 100000}){
+        //The sun and n - 1 bodies on circular orbits, written as a scene file.
+        std::ostringstream text;
+        text << "material rock sphere.vs sphere.fs 0.05 8\n";
+        text << "body Sun - 0 0 0 0 0 0 1.99e30 696340e3 0.25 1 0.647 0 rock\n";
+        text.precision(9);
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> radius(2.0f * AU, 4.0f * AU);
+        std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+        for (std::size_t k = 1; k < n; k++){
+            float r = radius(gen), theta = angle(gen), v = std::sqrt(G * 1.99e30f / r);
+            text << "body a" << k << " Sun " << r * std::cos(theta) << " " << r * std::sin(theta) << " 0 "
+                 << -v * std::sin(theta) << " " << v * std::cos(theta) << " 0 1e17 1e4 0.005 0.6 0.6 0.6 rock\n";
+        }
+        std::string scene_text = text.str();
+        measures.push_back(measure("scene_load", param("n", n), (double)n, [&](){
+            SceneFile file = SceneFile::parse(scene_text.data(), scene_text.size());
+            OrbitalSystem system;
+            std::vector<std::unique_ptr<CelestialBody>> objects;
+            std::vector<std::shared_ptr<OrbitalSystem>> subsystems;
+            file.build(system, objects, subsystems, [](const SceneBody& body){
+                return std::make_unique<CelestialBody>(std::vector<float>{body.position.x, body.position.y, body.position.z},
+                                                       std::vector<float>{body.velocity.x, body.velocity.y, body.velocity.z},
+                                                       body.radius, body.mass);
+            });
+        }));
+    }
+
+    for (int subdivision : {16, 40, 80, 160, 320}){
+        std::vector<float> color = {1.0f, 1.0f, 1.0f};
+        measures.push_back(measure("sphere_mesh", param("subdivision", subdivision), 1.0, [&](){
+            std::vector<float> points;
+            std::vector<unsigned int> indices;
+            std::vector<int> lineIndices;
+            Sphere::build_mesh(1.0f, color, subdivision, points, indices, lineIndices);
+        }));
+    }
+
+    Force weight(0.0, 0.0, -9.81); //Same throw as compute_traj
+    for (int points : {100, 1000, 10000, 100000}){
+        measures.push_back(measure("compute_traj_frictionless", param("points", points), 1.0, [&](){
+            compute_traj_frictionless(20.0, points, {30.0, 45.0}, {0.0, 0.0, 0.0}, weight);
+        }));
+    }
+
+    const char* model_path = "../obj/backpack/backpack.obj";
+#ifdef BENCHMARK_MODEL
+    if (std::ifstream(model_path).good()){
+        measures.push_back(measure("model_import", "{\"model\": \"backpack\"}", 1.0, [&](){
+            //Same import as Model::loadModel, without the GL upload of the meshes and textures.
+            Assimp::Importer importer;
+            importer.ReadFile(model_path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        }));
+    }
+    else {
+        measures.push_back(skip("model_import", "{\"model\": \"backpack\"}", std::string(model_path) + " not found"));
+    }
+#else
+    measures.push_back(skip("model_import", "{\"model\": \"backpack\"}", "built without BENCHMARK_MODEL (assimp)"));
+    (void)model_path;
+#endif
+
+    if (output){
+        std::ofstream file(output);
+        write_json(file, measures);
+    }
+    else {
+        write_json(std::cout, measures);
+    }
+    return 0;
+}
@@ -150,14 +150,22 @@ int main(){
                                           "../shaders/cube_shader/texture_specular/cube_texture_specular.vs",
                                           "../shaders/cube_shader/texture_specular/cube_texture_specular_flashlight.fs");
         cube.set_rotation(20.0f * i, glm::vec3(1.0f, 0.3f, 0.5f));
-        cube.set_light_attenuation(1.0f,0.09f,0.032f);
-        cube.get_shader().setVec3("light.position", cameraPos);
-        cube.get_shader().setVec3("light.direction", cameraFront);
-        cube.get_shader().setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
-        cube.get_shader().setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
-        
         cubeContainer.push_back(std::move(cube));
     };
+
+    //Camera and flashlight of every cube shader, uploaded once per frame.
+    UniformBuffer<CameraBlock> camera(CAMERA_BLOCK_BINDING);
+    LightBlock flashlight;
+    flashlight.position = lightPos;
+    flashlight.ambient = glm::vec3(0.1f);
+    flashlight.diffuse = glm::vec3(1.0f);
+    flashlight.specular = glm::vec3(1.0f);
+    flashlight.constant = 1.0f;
+    flashlight.linear = 0.09f;
+    flashlight.quadratic = 0.032f;
+    flashlight.cutOff = glm::cos(glm::radians(12.5f));
+    flashlight.outerCutOff = glm::cos(glm::radians(17.5f));
+    UniformBuffer<LightBlock> light(LIGHT_BLOCK_BINDING, flashlight);
     
     while(!glfwWindowShouldClose(window)){
 
@@ -173,6 +181,9 @@ int main(){
 
         glm::mat4 projection = glm::perspective(glm::radians(fov) , (float)WIDTH / (float)HEIGHT,0.1f,100.0f);
         glm::mat4 view = glm::lookAt(cameraPos , cameraPos + cameraFront, cameraUp);
+        camera.update({view, projection, cameraPos});
+        flashlight.direction = cameraFront;
+        light.update(flashlight);
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -189,7 +200,7 @@ int main(){
         //WoodCube.render(view, projection, lightPos, cameraPos);
         //lightCube.render(view, projection, lightPos, cameraPos);
         for (auto& c : cubeContainer){
-            c.render(view, projection, lightPos, cameraPos, cameraFront);
+            c.render();
         }
         //lightPos.x = 1.0f + sin(glfwGetTime()) * 2.0f;
         //lightPos.y = sin(glfwGetTime() / 2.0f) * 1.0f;
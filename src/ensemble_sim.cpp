@@ -0,0 +1,79 @@
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "ensemble.hpp"
+#include "solar_scene.hpp"
+
+//Ensemble run of the scene of orbital_system : members copies of the solar system whose initial positions and
+//velocities are perturbed by gaussian offsets (position sigma in m, velocity sigma in m/s, per axis and per body),
+//stepped together in one store (see ensemble.hpp) for the simulated duration.
+//Reports the simulation rate, the distribution of the divergence of the members from the unperturbed one (member 0)
+//and the spread of every body. divergence.csv gets the divergence of every member.
+//Usage : ensemble_sim [members] [years] [position sigma] [velocity sigma] [divergence.csv]
+
+const double YEAR = 365.25 * 24 * 3600.0;
+
+int main(int argc, char** argv){
+    std::size_t members = argc > 1 ? (std::size_t)std::atol(argv[1]) : 1024;
+    double years = argc > 2 ? std::atof(argv[2]) : 10.0;
+    double position_sigma = argc > 3 ? std::atof(argv[3]) : 1000.0;
+    double velocity_sigma = argc > 4 ? std::atof(argv[4]) : 0.001;
+    const char* csv_path = argc > 5 ? argv[5] : nullptr;
+    if (members < 2){
+        std::cout << "ERROR::ENSEMBLE_SIM::AT_LEAST_2_MEMBERS" << std::endl;
+        return 1;
+    }
+
+    Scene scene;
+    build_scene(scene, 0);
+    Ensemble ensemble(scene.system, members, position_sigma, velocity_sigma);
+
+    uint64_t steps = (uint64_t)std::ceil(years * YEAR / dt);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t k = 0; k < steps; k++){ensemble.step();}
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<MemberDivergence> divergences = ensemble.get_divergences();
+    std::vector<double> rms;
+    for (const MemberDivergence& divergence : divergences){rms.push_back(divergence.rms);}
+    std::sort(rms.begin(), rms.end());
+    auto quantile = [&](double q){return rms[(std::size_t)std::round(q * (rms.size() - 1))];};
+    auto worst = std::max_element(divergences.begin(), divergences.end(),
+                                  [](const MemberDivergence& a, const MemberDivergence& b){return a.rms < b.rms;});
+
+    std::cout << "Members         : " << members << " (" << simd_level_name(ensemble.get_simd_level()) << ", "
+              << ThreadPool::instance().get_thread_count() << " threads)" << std::endl;
+    std::cout << "Simulated       : " << years << " years, " << steps << " steps of " << dt / 3600.0 << " h" << std::endl;
+    std::cout << "Wall time       : " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "Member steps/s  : " << std::setprecision(0) << members * steps / seconds << std::endl;
+    std::cout << "Divergence (km) : RMS over the bodies of each member, to member 0" << std::endl;
+    std::cout << std::setprecision(3)
+              << "  median " << quantile(0.5) / 1e3 << ", 90% " << quantile(0.9) / 1e3 << ", max " << rms.back() / 1e3
+              << " (member " << (worst - divergences.begin()) + 1 << ")" << std::endl;
+    std::cout << "Spread (km)     : RMS distance of the members to their mean position" << std::endl;
+    for (std::size_t k = 0; k < scene.bodies.size(); k++){
+        if (scene.names[k].empty()){continue;}
+        std::cout << "  " << std::left << std::setw(8) << scene.names[k] << std::right << " "
+                  << ensemble.get_spread(scene.bodies[k]->get_id()) / 1e3 << std::endl;
+    }
+
+    if (csv_path){
+        std::ofstream csv(csv_path);
+        csv << "member,rms_m,max_m,max_body" << std::endl;
+        csv << std::setprecision(6);
+        for (std::size_t m = 0; m < divergences.size(); m++){
+            const MemberDivergence& divergence = divergences[m];
+            csv << m + 1 << "," << divergence.rms << "," << divergence.max << "," << divergence.max_body << std::endl;
+        }
+        std::cout << "Divergences     : " << csv_path << std::endl;
+    }
+    return 0;
+}
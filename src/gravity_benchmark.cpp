@@ -0,0 +1,219 @@
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <string>
+
+#include "gravity_kernel.hpp"
+#include "barnes_hut.hpp"
+#include "fast_multipole.hpp"
+#include "parallel_gravity.hpp"
+
+//Benchmark of the all-pairs gravity kernel : interactions per second for every instruction set supported by the CPU,
+//and error against a double precision evaluation, next to the error of the current path
+//(per-direction evaluation of CelestialObject::compute_acceleration_from).
+//Errors are relative to the sum of the magnitudes of the pair contributions of a body.
+//The multithreaded evaluation is run with 1 thread up to every hardware thread (at least 4), and must give the same
+//bits each time.
+//The Barnes-Hut and FMM backends are listed after the kernels, their interactions/s is the number of pairs of the
+//exact sum divided by their time. The cost per body of the FMM, its scaling and its crossover with the exact sum are
+//printed at the end.
+//Usage : gravity_benchmark [N]
+
+const float G = 6.674e-11f;
+const float AU = 1.496e11f;
+
+void fill_bodies(GravityTile& tile, std::size_t n){
+    //Asteroid belt like distribution : 2 to 4 AU, thin disk, masses from 1e15 to 1e21 kg.
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> radius(2.0f * AU, 4.0f * AU);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * M_PI);
+    std::uniform_real_distribution<float> height(-0.05f * AU, 0.05f * AU);
+    std::uniform_real_distribution<float> log_mass(15.0f, 21.0f);
+    tile.resize(n);
+    for (std::size_t i = 0; i < n; i++){
+        float r = radius(gen);
+        float theta = angle(gen);
+        tile.x[i] = r * cos(theta);
+        tile.y[i] = r * sin(theta);
+        tile.z[i] = height(gen);
+        tile.mu[i] = G * pow(10.0f, log_mass(gen));
+    }
+}
+
+void reset(GravityTile& tile){
+    for (std::size_t i = 0; i < tile.n; i++){
+        tile.ax[i] = 0.0f;
+        tile.ay[i] = 0.0f;
+        tile.az[i] = 0.0f;
+    }
+}
+
+void current_path_accelerations(GravityTile& tile){
+    //Same computation as CelestialObject::compute_acceleration_from, each direction of a pair evaluated separately.
+    reset(tile);
+    for (std::size_t i = 0; i < tile.n; i++){
+        for (std::size_t j = 0; j < tile.n; j++){
+            if (i == j) continue;
+            float dx = tile.x[j] - tile.x[i];
+            float dy = tile.y[j] - tile.y[i];
+            float dz = tile.z[j] - tile.z[i];
+            float norm = sqrt(dx * dx + dy * dy + dz * dz);
+            double inv = 1.0f / (norm * norm * norm);
+            float acceleration_magnitude = tile.mu[j] * inv;
+            tile.ax[i] += acceleration_magnitude * dx;
+            tile.ay[i] += acceleration_magnitude * dy;
+            tile.az[i] += acceleration_magnitude * dz;
+        }
+    }
+}
+
+//Returns the time of an evaluation in ms.
+template <typename F>
+double report_backend(GravityTile& tile, const std::vector<double>& exact, const char* name, F&& accumulate){
+    int repetitions = 0;
+    double seconds = 0.0;
+    while (seconds < 0.2){
+        reset(tile);
+        auto start = std::chrono::steady_clock::now();
+        accumulate(tile);
+        auto stop = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(stop - start).count();
+        repetitions++;
+    }
+    double pairs = 0.5 * (double)tile.n * (double)(tile.n - 1);
+    std::cout << std::setw(8) << tile.n << std::setw(10) << name
+              << std::setw(16) << std::scientific << std::setprecision(3) << pairs * repetitions / seconds
+              << std::setw(14) << std::fixed << 1e3 * seconds / repetitions
+              << std::setw(14) << std::scientific << max_relative_error(tile, exact) << std::fixed << std::endl;
+    return 1e3 * seconds / repetitions;
+}
+
+//Cost per body of the FMM for every N, exponent k of its time (t ~ N^k) between two consecutive N, and N from which
+//it is faster than the exact sum (fastest of the multithreaded runs) : interpolated between the measured N, or
+//extrapolated from the last two when it is still slower.
+void report_fmm_scaling(const std::vector<std::size_t>& sizes, const std::vector<double>& exact_ms,
+                        const std::vector<double>& fmm_ms, int order){
+    std::cout << "FMM p=" << order << " ns/body :";
+    for (std::size_t k = 0; k < sizes.size(); k++){
+        std::cout << " " << (std::size_t)(1e6 * fmm_ms[k] / sizes[k]) << " (N=" << sizes[k] << ")";
+    }
+    std::cout << std::endl;
+    if (sizes.size() < 2){return;}
+    auto exponent = [&](const std::vector<double>& ms, std::size_t k){
+        return std::log(ms[k] / ms[k - 1]) / std::log((double)sizes[k] / sizes[k - 1]);
+    };
+    std::cout << "FMM p=" << order << " scaling : N^" << std::setprecision(2) << exponent(fmm_ms, sizes.size() - 1)
+              << " (exact : N^" << exponent(exact_ms, sizes.size() - 1) << ") between " << sizes[sizes.size() - 2]
+              << " and " << sizes.back() << ", crossover : ";
+    if (fmm_ms[0] < exact_ms[0]){
+        std::cout << "N <= " << sizes[0] << std::endl;
+        return;
+    }
+    for (std::size_t k = 1; k < sizes.size(); k++){
+        if (fmm_ms[k] < exact_ms[k]){
+            //log(fmm / exact) is linear in log(N) between the two sizes.
+            double before = std::log(fmm_ms[k - 1] / exact_ms[k - 1]), after = std::log(fmm_ms[k] / exact_ms[k]);
+            double n = sizes[k - 1] * std::pow((double)sizes[k] / sizes[k - 1], before / (before - after));
+            std::cout << "N ~ " << std::setprecision(0) << n << std::endl;
+            return;
+        }
+    }
+    std::size_t last = sizes.size() - 1;
+    double slope = exponent(exact_ms, last) - exponent(fmm_ms, last);
+    if (slope <= 0.0){
+        std::cout << "none" << std::endl;
+        return;
+    }
+    double n = sizes[last] * std::pow(fmm_ms[last] / exact_ms[last], 1.0 / slope);
+    std::cout << "N ~ " << std::setprecision(0) << n << " (extrapolated)" << std::endl;
+}
+
+int main(int argc, char** argv){
+    std::vector<std::size_t> sizes = {256, 1024, 4096, 16384};
+    if (argc > 1){sizes = {(std::size_t)std::atoll(argv[1])};}
+
+    SimdLevel best = detect_simd_level();
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (best >= SimdLevel::SSE) levels.push_back(SimdLevel::SSE);
+    if (best >= SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+    if (best >= SimdLevel::AVX512) levels.push_back(SimdLevel::AVX512);
+
+    std::cout << "Detected instruction set : " << simd_level_name(best) << std::endl;
+    std::cout << "Tolerance : " << GRAVITY_KERNEL_TOLERANCE << std::endl;
+    std::cout << std::setw(8) << "N" << std::setw(10) << "kernel" << std::setw(16) << "interactions/s"
+              << std::setw(14) << "ms/eval" << std::setw(14) << "max rel err" << std::endl;
+
+    bool within_tolerance = true;
+    bool deterministic = true;
+    unsigned int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<int> orders = {2, 4, 6};
+    std::vector<double> exact_ms;
+    std::vector<std::vector<double>> fmm_ms(orders.size());
+    for (std::size_t n : sizes){
+        GravityTile tile;
+        fill_bodies(tile, n);
+        std::vector<double> exact = reference_accelerations(tile);
+        double pairs = 0.5 * (double)n * (double)(n - 1);
+
+        current_path_accelerations(tile);
+        double current_error = max_relative_error(tile, exact);
+        std::cout << std::setw(8) << n << std::setw(10) << "current" << std::setw(16) << "-" << std::setw(14) << "-"
+                  << std::setw(14) << std::scientific << std::setprecision(3) << current_error << std::fixed << std::endl;
+
+        for (SimdLevel level : levels){
+            //Repeat until at least 0.2 second has been measured.
+            int repetitions = 0;
+            double seconds = 0.0;
+            while (seconds < 0.2){
+                reset(tile);
+                auto start = std::chrono::steady_clock::now();
+                accumulate_pairs(tile, level);
+                auto stop = std::chrono::steady_clock::now();
+                seconds += std::chrono::duration<double>(stop - start).count();
+                repetitions++;
+            }
+            double error = max_relative_error(tile, exact);
+            within_tolerance = within_tolerance && error <= current_error + GRAVITY_KERNEL_TOLERANCE;
+            std::cout << std::setw(8) << n << std::setw(10) << simd_level_name(level)
+                      << std::setw(16) << std::scientific << std::setprecision(3) << pairs * repetitions / seconds
+                      << std::setw(14) << std::fixed << 1e3 * seconds / repetitions
+                      << std::setw(14) << std::scientific << error << std::fixed << std::endl;
+        }
+
+        ParallelGravity parallel;
+        std::vector<float> single_thread;
+        exact_ms.push_back(INFINITY);
+        for (unsigned int threads = 1; threads <= std::max(4u, hardware_threads); threads *= 2){
+            ThreadPool::instance().set_thread_count(threads);
+            std::string name = "par x" + std::to_string(threads);
+            double ms = report_backend(tile, exact, name.c_str(), [&](GravityTile& t){parallel.accumulate(t, best);});
+            exact_ms.back() = std::min(exact_ms.back(), ms);
+            std::vector<float> result(tile.ax.begin(), tile.ax.begin() + n);
+            result.insert(result.end(), tile.ay.begin(), tile.ay.begin() + n);
+            result.insert(result.end(), tile.az.begin(), tile.az.begin() + n);
+            if (single_thread.empty()){single_thread = result;}
+            else if (std::memcmp(result.data(), single_thread.data(), result.size() * sizeof(float)) != 0){
+                std::cout << "Multithreaded result depends on the thread count" << std::endl;
+                deterministic = false;
+            }
+        }
+
+        BarnesHutTree tree(0.5f);
+        report_backend(tile, exact, "BH", [&](GravityTile& t){tree.accumulate(t);});
+        for (std::size_t k = 0; k < orders.size(); k++){
+            FastMultipole fmm(orders[k], 0.5f);
+            std::string name = "FMM p=" + std::to_string(orders[k]);
+            double ms = report_backend(tile, exact, name.c_str(), [&](GravityTile& t){fmm.accumulate(t, best);});
+            fmm_ms[k].push_back(ms);
+        }
+    }
+    for (std::size_t k = 0; k < orders.size(); k++){report_fmm_scaling(sizes, exact_ms, fmm_ms[k], orders[k]);}
+    return within_tolerance && deterministic ? 0 : 1;
+}
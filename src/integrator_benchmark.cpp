@@ -0,0 +1,166 @@
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#include "symplectic_integrator.hpp"
+
+//Benchmark of the integration schemes : force evaluations needed to simulate a century with a relative energy error
+//below a target, on the solar system of orbital_system (fixed Sun, 8 planets, Earth-Moon subsystem).
+//For every scheme the step is divided by sqrt(2) from 64 days until the largest energy error of the century is below the
+//target. The interactions and their precision are the ones of OrbitalSystem : the pull of the Sun and the Earth-Moon pair
+//in the precision of the BodyStore, the planets attracting each other in float like the gravity kernels. The Moon only
+//feels the Earth and the Sun.
+//Below ~2e-8 over a century the target is out of reach of any step : the float offsets of the outer planets (4e12 m
+//from the Sun, ~3e5 m resolution) make the mutual forces slightly non conservative.
+//Usage : integrator_benchmark [target] [years]
+
+const double G = 6.674e-11;
+const double DAY = 24 * 3600.0;
+const double YEAR = 365.25 * DAY;
+
+struct Scene {
+    BodyStore store;
+    std::vector<IntegratedBody> bodies; //Planets then the Moon, the Sun (id 0) is fixed
+    uint32_t earth = 0, moon = 0;
+};
+
+Scene make_scene(){
+    //Same initial conditions as orbital_system.
+    const double masses[] = {1.99e30, 3.3e23, 4.87e24, 5.97e24, 6.42e23, 1.90e27, 5.68e26, 8.68e25, 1.02e26};
+    const double radii[] = {0.0, 5.80e10, 1.08e11, 1.50e11, 2.28e11, 7.79e11, 1.43e12, 2.92e12, 4.47e12};
+    const double speeds[] = {0.0, 47360.0, 35025.0, 29780.0, 24130.0, 13058.0, 9680.0, 6796.0, 5432.0};
+    Scene scene;
+    for (int k = 0; k < 9; k++){
+        BodyStore::vec_type r(radii[k], 0.0, 0.0), v(0.0, speeds[k], 0.0);
+        scene.store.add_body(r, r, v, (float)masses[k]);
+        if (k > 0){scene.bodies.push_back({(uint32_t)k, 0, G * masses[0], false});}
+    }
+    scene.earth = 3;
+    BodyStore::vec_type r(1.50e11 + 3e8, 0.0, 0.0), v(0.0, 29780.0 + 1022.0, 0.0);
+    scene.moon = (uint32_t)scene.store.add_body(r, r, v, 7.35e22f);
+    scene.bodies.push_back({scene.moon, scene.earth,
+                            G * ((double)scene.store.m[scene.earth] + scene.store.m[scene.moon]), true});
+    return scene;
+}
+
+//Pull of j on i, added to a and removed from the energy.
+double pair(const BodyStore& s, uint32_t i, uint32_t j, double a[3]){
+    double d[3] = {(double)s.x[j] - s.x[i], (double)s.y[j] - s.y[i], (double)s.z[j] - s.z[i]};
+    double r = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    double k = G * s.m[j] / (r * r * r);
+    for (int c = 0; c < 3; c++){a[c] += k * d[c];}
+    return r;
+}
+
+//Same, in float on the offset, as the all-pairs kernel.
+void mutual_pair(const BodyStore& s, uint32_t i, uint32_t j, double a[3]){
+    float d[3] = {(float)(s.x[j] - s.x[i]), (float)(s.y[j] - s.y[i]), (float)(s.z[j] - s.z[i])};
+    float r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    float k = (float)G * s.m[j] / (r2 * std::sqrt(r2));
+    for (int c = 0; c < 3; c++){a[c] += k * d[c];}
+}
+
+void compute_forces(Scene& scene){
+    BodyStore& s = scene.store;
+    std::size_t n = s.size();
+    std::vector<double> a(3 * n, 0.0);
+    for (uint32_t i = 1; i < n; i++){pair(s, i, 0, &a[3 * i]);}
+    for (uint32_t i = 1; i < scene.moon; i++){
+        for (uint32_t j = 1; j < scene.moon; j++){
+            if (i != j){mutual_pair(s, i, j, &a[3 * i]);}
+        }
+    }
+    pair(s, scene.moon, scene.earth, &a[3 * scene.moon]);
+    pair(s, scene.earth, scene.moon, &a[3 * scene.earth]);
+    for (uint32_t i = 1; i < n; i++){
+        s.ax[i] = a[3 * i]; s.ay[i] = a[3 * i + 1]; s.az[i] = a[3 * i + 2];
+    }
+}
+
+double energy(const Scene& scene){
+    //Every interaction of compute_forces() is reciprocal or comes from the fixed Sun : this energy is conserved.
+    const BodyStore& s = scene.store;
+    double e = 0.0, unused[3];
+    for (uint32_t i = 1; i < s.size(); i++){
+        e += 0.5 * s.m[i] * (s.vx[i] * s.vx[i] + s.vy[i] * s.vy[i] + s.vz[i] * s.vz[i]);
+        e -= G * s.m[0] * s.m[i] / pair(s, i, 0, unused);
+    }
+    for (uint32_t i = 1; i < scene.moon; i++){
+        for (uint32_t j = i + 1; j < scene.moon; j++){e -= G * s.m[i] * s.m[j] / pair(s, i, j, unused);}
+    }
+    e -= G * s.m[scene.earth] * s.m[scene.moon] / pair(s, scene.moon, scene.earth, unused);
+    return e;
+}
+
+//Largest relative energy error over the run, checked about once a day.
+double run(IntegratorScheme scheme, double h, double years, uint64_t& evaluations){
+    Scene scene = make_scene();
+    SymplecticIntegrator integrator(scheme);
+    double e0 = energy(scene);
+    double worst = 0.0;
+    uint64_t steps = (uint64_t)std::ceil(years * YEAR / h);
+    uint64_t check = std::max<uint64_t>(1, (uint64_t)(DAY / h));
+    for (uint64_t k = 1; k <= steps; k++){
+        integrator.step(scene.store, scene.bodies, h, [&](){compute_forces(scene);});
+        if (k % check == 0 || k == steps){worst = std::max(worst, std::fabs(energy(scene) / e0 - 1.0));}
+        if (!(worst < 1.0)){break;} //Unstable step
+    }
+    evaluations = integrator.get_force_evaluations();
+    return worst;
+}
+
+const char* scheme_name(IntegratorScheme scheme){
+    switch (scheme){
+        case IntegratorScheme::Yoshida4: return "Yoshida4";
+        case IntegratorScheme::Yoshida6: return "Yoshida6";
+        case IntegratorScheme::WisdomHolman: return "WisdomHolman";
+        default: return "Verlet";
+    }
+}
+
+int main(int argc, char** argv){
+    double target = argc > 1 ? std::atof(argv[1]) : 1e-7;
+    double years = argc > 2 ? std::atof(argv[2]) : 100.0;
+
+    std::cout << "Energy error target : " << std::scientific << std::setprecision(1) << target
+              << " over " << std::fixed << years << " years" << std::endl;
+    std::cout << std::setw(14) << "scheme" << std::setw(12) << "step (h)" << std::setw(14) << "energy err"
+              << std::setw(16) << "evals/century" << std::setw(12) << "seconds"
+              << std::setw(12) << "step gain" << std::setw(12) << "evals gain" << std::endl;
+
+    //Gains are relative to Verlet.
+    double verlet_step = 0.0, verlet_evaluations = 0.0;
+    for (IntegratorScheme scheme : {IntegratorScheme::Verlet, IntegratorScheme::Yoshida4, IntegratorScheme::Yoshida6,
+                                    IntegratorScheme::WisdomHolman}){
+        bool found = false;
+        for (double h = 64 * DAY; h >= 900.0; h /= std::sqrt(2.0)){
+            uint64_t evaluations = 0;
+            auto start = std::chrono::steady_clock::now();
+            double error = run(scheme, h, years, evaluations);
+            auto stop = std::chrono::steady_clock::now();
+            if (error > target){continue;}
+            double per_century = evaluations * 100.0 / years;
+            if (scheme == IntegratorScheme::Verlet){
+                verlet_step = h;
+                verlet_evaluations = per_century;
+            }
+            std::cout << std::setw(14) << scheme_name(scheme) << std::setw(12) << std::setprecision(2) << h / 3600.0
+                      << std::setw(14) << std::scientific << error << std::fixed
+                      << std::setw(16) << (uint64_t)per_century
+                      << std::setw(12) << std::chrono::duration<double>(stop - start).count();
+            if (verlet_step > 0.0){
+                std::cout << std::setprecision(1) << std::setw(12) << h / verlet_step
+                          << std::setw(12) << verlet_evaluations / per_century;
+            }
+            std::cout << std::endl;
+            found = true;
+            break;
+        }
+        if (!found){std::cout << std::setw(14) << scheme_name(scheme) << "   target not reached" << std::endl;}
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "checkpoint.hpp"
+#include "solar_scene.hpp"
+#include "trajectory_recorder.hpp"
+
+//Headless simulation : the scene of orbital_system without any window nor GL context, stepped as fast as possible for
+//the simulated duration, then the simulation rate is reported. For batch runs on machines without display.
+//asteroids adds a belt of small bodies (2 to 4 AU) orbiting the sun, attracting each other and the planets.
+//integrator : verlet (default), yoshida4, yoshida6, wisdom_holman or block (block timesteps).
+//checkpoint : the run resumes from this file if it exists (its scene replaces asteroids), and saves its state there
+//every CHECKPOINT_INTERVAL of wall time and at the end, without waiting for the disk. - for none.
+//trajectory : positions of every body recorded to this file every interval steps (see trajectory_recorder.hpp). - for
+//none.
+//collisions : none (default), merge or bounce (see collision.hpp).
+//particles : belt of massless test particles (2 to 4 AU) pulled by the bodies (see test_particles.hpp). They are not
+//part of the checkpoint nor of the trajectory : a resumed run starts a new belt.
+//Usage : orbital_sim [years] [asteroids] [integrator] [checkpoint] [trajectory] [interval] [collisions] [particles]
+
+const double YEAR = 365.25 * 24 * 3600.0;
+const double CHECKPOINT_INTERVAL = 60.0; //s
+
+int main(int argc, char** argv){
+    double years = argc > 1 ? std::atof(argv[1]) : 100.0;
+    std::size_t asteroids = argc > 2 ? (std::size_t)std::atol(argv[2]) : 0;
+    const char* integrator = argc > 3 ? argv[3] : "verlet";
+    const char* checkpoint_path = argc > 4 && std::strcmp(argv[4], "-") != 0 ? argv[4] : nullptr;
+    const char* trajectory_path = argc > 5 && std::strcmp(argv[5], "-") != 0 ? argv[5] : nullptr;
+    uint32_t interval = argc > 6 ? (uint32_t)std::atol(argv[6]) : 1;
+    const char* collisions = argc > 7 ? argv[7] : "none";
+    std::size_t particles = argc > 8 ? (std::size_t)std::atol(argv[8]) : 0;
+
+    Scene scene;
+    RestoredSystem restored;
+    OrbitalSystem* root = &scene.system;
+    double start_time = 0.0;
+    uint64_t start_steps = 0;
+    if (checkpoint_path && std::ifstream(checkpoint_path).good()){
+        auto start = std::chrono::steady_clock::now();
+        Checkpoint checkpoint = Checkpoint::open(checkpoint_path);
+        restored = checkpoint.restore();
+        root = restored.system.get();
+        start_time = checkpoint.get_time();
+        start_steps = checkpoint.get_steps();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Restored        : " << checkpoint_path << " at " << start_time / YEAR << " years, "
+                  << checkpoint.size() << " bodies in " << ms << " ms" << std::endl;
+    }
+    else {
+        build_scene(scene, asteroids);
+    }
+    OrbitalSystem& system = *root;
+    if (std::strcmp(integrator, "block") == 0){system.set_block_timesteps(true);}
+    else if (std::strcmp(integrator, "verlet") == 0){system.set_integrator(IntegratorScheme::Verlet);}
+    else if (std::strcmp(integrator, "yoshida4") == 0){system.set_integrator(IntegratorScheme::Yoshida4);}
+    else if (std::strcmp(integrator, "yoshida6") == 0){system.set_integrator(IntegratorScheme::Yoshida6);}
+    else if (std::strcmp(integrator, "wisdom_holman") == 0){system.set_integrator(IntegratorScheme::WisdomHolman);}
+    else {
+        std::cout << "Unknown integrator " << integrator << std::endl;
+        return 1;
+    }
+    if (std::strcmp(integrator, "block") != 0){system.set_block_timesteps(false);}
+    if (std::strcmp(collisions, "merge") == 0){system.set_collision_response(CollisionResponse::Merge);}
+    else if (std::strcmp(collisions, "bounce") == 0){system.set_collision_response(CollisionResponse::Bounce);}
+    else if (std::strcmp(collisions, "none") != 0){
+        std::cout << "Unknown collision response " << collisions << std::endl;
+        return 1;
+    }
+    if (particles > 0){add_test_belt(system, particles);}
+
+    CheckpointWriter writer;
+    std::unique_ptr<TrajectoryRecorder> recorder;
+    if (trajectory_path){
+        recorder = std::make_unique<TrajectoryRecorder>(trajectory_path, system.get_store().size(), dt, interval);
+        recorder->record(system.get_store(), start_time, start_steps);
+    }
+    uint64_t steps = (uint64_t)std::ceil(years * YEAR / dt);
+    auto start = std::chrono::steady_clock::now();
+    auto last_checkpoint = start;
+    for (uint64_t k = 0; k < steps; k++){
+        system.step();
+        if (recorder){recorder->record(system.get_store(), start_time + (k + 1) * (double)dt, start_steps + k + 1);}
+        if (checkpoint_path && (k & 1023) == 1023){
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - last_checkpoint).count() >= CHECKPOINT_INTERVAL){
+                writer.write(Checkpoint::capture(system, start_time + (k + 1) * (double)dt, start_steps + k + 1),
+                             checkpoint_path);
+                last_checkpoint = now;
+            }
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    if (recorder){recorder->close();}
+    if (checkpoint_path){
+        writer.write(Checkpoint::capture(system, start_time + steps * (double)dt, start_steps + steps), checkpoint_path);
+        writer.wait();
+    }
+
+    BodyStore& store = system.get_store();
+    std::size_t earth = system.get_subsystems().front()->get_center()->get_id();
+    std::cout << "Bodies          : " << store.size() << std::endl;
+    std::cout << "Integrator      : " << integrator << std::endl;
+    std::cout << "Simulated       : " << years << " years, " << steps << " steps of " << dt / 3600.0 << " h" << std::endl;
+    std::cout << "Wall time       : " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "Steps/s         : " << std::setprecision(0) << steps / seconds << std::endl;
+    std::cout << "Years/s         : " << std::setprecision(2) << years / seconds << std::endl;
+    std::cout << "Earth distance  : " << std::setprecision(6) << glm::length(glm::dvec3(store.get_pos(earth))) / AU
+              << " AU" << std::endl;
+    if (system.get_collision_response() != CollisionResponse::None){
+        std::cout << "Collisions      : " << collisions << ", " << system.get_collision_count() << std::endl;
+    }
+    if (particles > 0){
+        std::cout << "Test particles  : " << particles << ", " << std::setprecision(1)
+                  << seconds * 1e9 / ((double)steps * particles) << " ns per particle step" << std::endl;
+    }
+    if (recorder){
+        std::cout << "Trajectory      : " << trajectory_path << ", " << recorder->get_samples() << " samples, "
+                  << recorder->get_written_bytes() << " bytes (" << std::setprecision(1)
+                  << (double)recorder->get_raw_bytes() / recorder->get_written_bytes() << "x smaller than floats)"
+                  << std::endl;
+    }
+    if (checkpoint_path){
+        std::cout << "Checkpoint      : " << checkpoint_path << " at " << std::setprecision(2)
+                  << (start_time + steps * (double)dt) / YEAR << " years" << std::endl;
+    }
+    return 0;
+}
@@ -92,7 +92,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset){
 
 //const float PHYSICS_DT =  dt;
 const float TIME_MULTIPLIER = 500000.0f;
-float physicsAccumulator = 0.0f;
+double simulationTime = 0.0; //s
 float timeAccumulator = 0.0f;
 
 int main(){
@@ -146,60 +146,30 @@ int main(){
     //            {0.5f, 0.5f, 0.5f}, true, 24 * 3600.0f , 
     //            "../shaders/sphere/sphere.vs", "../shaders/sphere/sphere_directionnal.fs");
 
-    Earth.get_sphere().get_shader().use();
-    Earth.get_sphere().get_shader().setVec3("light.position",center_S);
-    Earth.get_sphere().get_shader().setVec3("light.ambient",glm::vec3(0.2f));
-    Earth.get_sphere().get_shader().setVec3("light.diffuse", glm::vec3(1.0f,1.0f,0.95f));
-    Earth.get_sphere().get_shader().setVec3("light.specular",glm::vec3(1.0f, 1.0f, 1.0f));
-    Earth.get_sphere().get_shader().setFloat("light.constant",1.0f);
-    Earth.get_sphere().get_shader().setFloat("light.linear",0.5f);
-    Earth.get_sphere().get_shader().setFloat("light.quadratic",0.25f);
-    Earth.get_sphere().get_shader().setFloat("specularStrenght", 0.2);
-    Earth.get_sphere().get_shader().setFloat("shininess",32.0f);
-
-    Mars.get_sphere().get_shader().use();
-    Mars.get_sphere().get_shader().setVec3("light.position",center_S);
-    Mars.get_sphere().get_shader().setVec3("light.ambient",glm::vec3(0.2f));
-    Mars.get_sphere().get_shader().setVec3("light.diffuse", glm::vec3(1.0f,1.0f,0.95f));
-    Mars.get_sphere().get_shader().setVec3("light.specular",glm::vec3(1.0f, 1.0f, 1.0f));
-    Mars.get_sphere().get_shader().setFloat("light.constant",1.0f);
-    Mars.get_sphere().get_shader().setFloat("light.linear",0.5f);
-    Mars.get_sphere().get_shader().setFloat("light.quadratic",0.25f);
-    Mars.get_sphere().get_shader().setFloat("specularStrenght", 0.05);
-    Mars.get_sphere().get_shader().setFloat("shininess",8.0f);
-
-    Venus.get_sphere().get_shader().use();
-    Venus.get_sphere().get_shader().setVec3("light.position",center_S);
-    Venus.get_sphere().get_shader().setVec3("light.ambient",glm::vec3(0.2f));
-    Venus.get_sphere().get_shader().setVec3("light.diffuse", glm::vec3(1.0f,1.0f,0.95f));
-    Venus.get_sphere().get_shader().setVec3("light.specular",glm::vec3(1.0f, 1.0f, 1.0f));
-    Venus.get_sphere().get_shader().setFloat("light.constant",1.0f);
-    Venus.get_sphere().get_shader().setFloat("light.linear",0.5f);
-    Venus.get_sphere().get_shader().setFloat("light.quadratic",0.25f);
-    Venus.get_sphere().get_shader().setFloat("specularStrenght", 0.05);
-    Venus.get_sphere().get_shader().setFloat("shininess",8.0f);
-
-    Mercury.get_sphere().get_shader().use();
-    Mercury.get_sphere().get_shader().setVec3("light.position",center_S);
-    Mercury.get_sphere().get_shader().setVec3("light.ambient",glm::vec3(0.2f));
-    Mercury.get_sphere().get_shader().setVec3("light.diffuse", glm::vec3(1.0f,1.0f,0.95f));
-    Mercury.get_sphere().get_shader().setVec3("light.specular",glm::vec3(1.0f, 1.0f, 1.0f));
-    Mercury.get_sphere().get_shader().setFloat("light.constant",1.0f);
-    Mercury.get_sphere().get_shader().setFloat("light.linear",0.5f);
-    Mercury.get_sphere().get_shader().setFloat("light.quadratic",0.25f);
-    Mercury.get_sphere().get_shader().setFloat("specularStrenght", 0.05);
-    Mercury.get_sphere().get_shader().setFloat("shininess",1.0f);
-
-    //Moon.get_sphere().get_shader().use();
-    //Moon.get_sphere().get_shader().setVec3("light.position",center_S);
-    //Moon.get_sphere().get_shader().setVec3("light.ambient",glm::vec3(0.2f));
-    //Moon.get_sphere().get_shader().setVec3("light.diffuse", glm::vec3(1.0f,1.0f,0.95f));
-    //Moon.get_sphere().get_shader().setVec3("light.specular",glm::vec3(1.0f, 1.0f, 1.0f));
-    //Moon.get_sphere().get_shader().setFloat("light.constant",1.0f);
-    //Moon.get_sphere().get_shader().setFloat("light.linear",0.5f);
-    //Moon.get_sphere().get_shader().setFloat("light.quadratic",0.25f);
-    //Moon.get_sphere().get_shader().setFloat("specularStrenght", 0.05);
-    //Moon.get_sphere().get_shader().setFloat("shininess",1.0f);
+    //The planets only feel the sun : their orbits are computed in closed form, all at once each frame.
+    KeplerOrbits orbits;
+    Earth.use_kepler(orbits);
+    Mars.use_kepler(orbits);
+    Venus.use_kepler(orbits);
+    Mercury.use_kepler(orbits);
+
+    //Camera and light of every shader, uploaded once per frame. The material is each planet's.
+    UniformBuffer<CameraBlock> camera(CAMERA_BLOCK_BINDING);
+    LightBlock sunlight;
+    sunlight.position = center_S;
+    sunlight.ambient = glm::vec3(0.2f);
+    sunlight.diffuse = glm::vec3(1.0f, 1.0f, 0.95f);
+    sunlight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    sunlight.constant = 1.0f;
+    sunlight.linear = 0.5f;
+    sunlight.quadratic = 0.25f;
+    UniformBuffer<LightBlock> light(LIGHT_BLOCK_BINDING, sunlight);
+
+    Earth.get_sphere().set_material(0.2f, 32.0f);
+    Mars.get_sphere().set_material(0.05f, 8.0f);
+    Venus.get_sphere().set_material(0.05f, 8.0f);
+    Mercury.get_sphere().set_material(0.05f, 1.0f);
+    //Moon.get_sphere().set_material(0.05f, 1.0f);
 
 
     while(!glfwWindowShouldClose(window)){
@@ -217,56 +187,46 @@ int main(){
         glm::vec3 pos_Mercury;
         glm::vec3 pos_Moon;
 
-        physicsAccumulator += deltaTime * TIME_MULTIPLIER;
-        while(physicsAccumulator >= dt){
-            Earth.compute_step();
-            Mars.compute_step();
-            Venus.compute_step();
-            Mercury.compute_step();
-            //Moon.compute_step();
-            pos_Earth = glm::make_vec3(Earth.get_pos().data());
-            pos_Mars = glm::make_vec3(Mars.get_pos().data());
-            pos_Venus = glm::make_vec3(Venus.get_pos().data());
-            pos_Mercury = glm::make_vec3(Mercury.get_pos().data());
-            //pos_Moon = glm::make_vec3(Moon.get_pos().data());
-            pos_Earth = {SCALE * (pos_Earth[0] / AU), SCALE * (pos_Earth[1] / AU), 0.0f};
-            pos_Mars = {SCALE * (pos_Mars[0] / AU), SCALE * (pos_Mars[1] / AU), 0.0f};
-            pos_Venus = {SCALE * (pos_Venus[0] / AU), SCALE * (pos_Venus[1] / AU), 0.0f};
-            pos_Mercury = {SCALE * (pos_Mercury[0] / AU), SCALE * (pos_Mercury[1] / AU), 0.0f};
-            //pos_Moon = {SCALE * (pos_Moon[0] / AU), SCALE * (pos_Moon[1] / AU), 0.0f};
-            physicsAccumulator -= dt;
-        }
+        //Closed form orbits : any time is evaluated directly, whatever the time multiplier.
+        simulationTime += (double)deltaTime * TIME_MULTIPLIER;
+        orbits.evaluate(simulationTime);
+        //Moon.compute_step();
+        pos_Earth = glm::make_vec3(Earth.get_pos().data());
+        pos_Mars = glm::make_vec3(Mars.get_pos().data());
+        pos_Venus = glm::make_vec3(Venus.get_pos().data());
+        pos_Mercury = glm::make_vec3(Mercury.get_pos().data());
+        //pos_Moon = glm::make_vec3(Moon.get_pos().data());
+        pos_Earth = {SCALE * (pos_Earth[0] / AU), SCALE * (pos_Earth[1] / AU), 0.0f};
+        pos_Mars = {SCALE * (pos_Mars[0] / AU), SCALE * (pos_Mars[1] / AU), 0.0f};
+        pos_Venus = {SCALE * (pos_Venus[0] / AU), SCALE * (pos_Venus[1] / AU), 0.0f};
+        pos_Mercury = {SCALE * (pos_Mercury[0] / AU), SCALE * (pos_Mercury[1] / AU), 0.0f};
+        //pos_Moon = {SCALE * (pos_Moon[0] / AU), SCALE * (pos_Moon[1] / AU), 0.0f};
         
-        Earth.get_sphere().get_shader().setVec3("light.position", center_S);
-        Mars.get_sphere().get_shader().setVec3("light.position",center_S);
-        Venus.get_sphere().get_shader().setVec3("light.position", center_S);
-        Mercury.get_sphere().get_shader().setVec3("light.position", center_S);
-        //Moon.get_sphere().get_shader().setVec3("light.position", center_S);
-
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glEnable(GL_DEPTH_TEST);
 
         glm::mat4 projection = glm::perspective(glm::radians(fov) , (float)WIDTH / (float)HEIGHT,0.1f,100.0f);
         glm::mat4 view = glm::lookAt(cameraPos , cameraPos + cameraFront, cameraUp);
+        camera.update({view, projection, cameraPos});
 
         Earth.get_sphere().set_position(pos_Earth);
         Mars.get_sphere().set_position(pos_Mars);
         Venus.get_sphere().set_position(pos_Venus);
         Mercury.get_sphere().set_position(pos_Mercury);
-        Sun.get_sphere().render(view, projection);
-        Earth.get_sphere().render(view, projection);
-        Mars.get_sphere().render(view, projection);
-        Venus.get_sphere().render(view, projection);
-        Mercury.get_sphere().render(view, projection);
+        Sun.get_sphere().render();
+        Earth.get_sphere().render();
+        Mars.get_sphere().render();
+        Venus.get_sphere().render();
+        Mercury.get_sphere().render();
         glPointSize(1.0f);
-        Earth.render_orbit(view, projection);
-        Mars.render_orbit(view, projection);
-        Venus.render_orbit(view, projection);
-        Mercury.render_orbit(view, projection);
-        Sun.render(view, projection, center_S);
-        Earth.render(view, projection, pos_Earth);
-        //Moon.render(view, projection, pos_Moon);
+        Earth.render_orbit();
+        Mars.render_orbit();
+        Venus.render_orbit();
+        Mercury.render_orbit();
+        Sun.render(center_S);
+        Earth.render(pos_Earth);
+        //Moon.render(pos_Moon);
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -170,6 +170,7 @@ int main(){
     //}
 
     Sphere S(0.5f, white, glm::vec3(0.0f));
+    UniformBuffer<CameraBlock> camera(CAMERA_BLOCK_BINDING);
 
     while(!glfwWindowShouldClose(window)){
         float currentFrame = glfwGetTime();
@@ -194,6 +195,7 @@ int main(){
         unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
         glm::mat4 view = glm::lookAt(cameraPos , cameraPos + cameraFront, cameraUp);
         glUniformMatrix4fv(viewLoc, 1,GL_FALSE,glm::value_ptr(view));
+        camera.update({view, projection, cameraPos});
 
         unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
         //glm::mat4 model = glm::mat4(1.0f);
@@ -216,7 +218,7 @@ int main(){
         //    glDrawArrays(GL_POINTS,0,nb_points);
         //}
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        S.render(view, projection);
+        S.render();
         //unsigned int VAO_S1 = S1.get_VAO();
         //glm::mat4 model_S1 = S1.get_model();
         //glUniformMatrix4fv(modelLoc,1,GL_FALSE,glm::value_ptr(model_S1));
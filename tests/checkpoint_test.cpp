@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+#include "checkpoint.hpp"
+#include "test_harness.hpp"
+
+//Regression tests of the checkpoints.
+
+//A run with block timesteps, captured between two syncs of its planets then restored : the restored run follows the
+//original one. The image used to hold the velocities of the last sync of each body, up to 64 steps old.
+void block_timesteps_round_trip(){
+    TestBodies bodies;
+    CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f);
+    CelestialBody* earth = bodies.add({1.5e11f, 0.0f, 0.0f}, {0.0f, 29780.0f, 0.0f}, 5.97e24f);
+    CelestialBody* mars = bodies.add({0.0f, 2.28e11f, 0.0f}, {-24130.0f, 0.0f, 0.0f}, 6.42e23f);
+    CelestialBody* jupiter = bodies.add({-7.79e11f, 0.0f, 0.0f}, {0.0f, -13058.0f, 0.0f}, 1.90e27f);
+
+    OrbitalSystem system;
+    system.define_center(sun);
+    system.fix_center(true);
+    for (CelestialBody* planet : {earth, mars, jupiter}){system.add_orbiters(planet);}
+    system.set_block_timesteps(true);
+    system.initialize();
+    for (int k = 0; k < 101; k++){system.step();}
+
+    Checkpoint checkpoint = Checkpoint::capture(system);
+    RestoredSystem restored = checkpoint.restore();
+    for (int k = 0; k < 200; k++){
+        system.step();
+        restored.system->step();
+    }
+
+    double worst = 0.0;
+    for (CelestialBody* planet : {earth, mars, jupiter}){
+        BodyStore::vec_type original = system.get_store().get_pos(planet->get_id());
+        const CelestialBody* copy = restored.bodies[planet->get_id()].get();
+        BodyStore::vec_type branch = restored.system->get_store().get_pos(copy->get_id());
+        worst = std::max(worst, (double)glm::length(branch - original) / glm::length(original));
+    }
+    std::cout << "block timesteps : restored run " << worst << " of the orbit radius away after 200 steps"
+              << std::endl;
+    check(worst < 1e-4, "a run restored from a block timestep checkpoint follows the original run");
+}
+
+//Test particles saved then restored with their Verlet state : the restored run steps them like the original one.
+void test_particles_round_trip(){
+    TestBodies bodies;
+    CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f);
+    CelestialBody* jupiter = bodies.add({7.79e11f, 0.0f, 0.0f}, {0.0f, 13058.0f, 0.0f}, 1.90e27f);
+
+    OrbitalSystem system;
+    system.define_center(sun);
+    system.fix_center(true);
+    system.add_orbiters(jupiter);
+    system.initialize();
+    for (int k = 0; k < 100; k++){
+        float r = (2.0f + 0.02f * k) * AU;
+        system.add_test_particle({0.0f, r, 0.0f}, {-std::sqrt(G * 1.99e30f / r), 0.0f, 0.0f});
+    }
+    for (int k = 0; k < 10; k++){system.step();}
+
+    const char* path = "checkpoint_test.ckpt";
+    Checkpoint::capture(system).save(path);
+    RestoredSystem restored = Checkpoint::open(path).restore();
+    std::remove(path);
+    for (int k = 0; k < 10; k++){
+        system.step();
+        restored.system->step();
+    }
+
+    const TestParticles& original = system.get_test_particles();
+    const TestParticles& branch = restored.system->get_test_particles();
+    bool same = branch.size() == original.size();
+    for (std::size_t p = 0; same && p < original.size(); p++){
+        same = branch.get_pos(p) == original.get_pos(p) && branch.x_prev[p] == original.x_prev[p]
+            && branch.y_prev[p] == original.y_prev[p] && branch.z_prev[p] == original.z_prev[p];
+    }
+    std::cout << "test particles : " << branch.size() << " of " << original.size() << " restored" << std::endl;
+    check(same, "restored test particles follow the original ones");
+}
+
+int main(){
+    block_timesteps_round_trip();
+    test_particles_round_trip();
+    return exit_code();
+}
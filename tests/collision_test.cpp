@@ -0,0 +1,48 @@
+#include <iostream>
+#include <cmath>
+#include <memory>
+
+#include "test_harness.hpp"
+
+//Regression tests of the collision responses.
+
+//An asteroid of the sun hits the Earth, fixed center of the Earth-Moon subsystem (fix_center(true) on the subsystem, or
+//the fixed directive of a scene file) : the Earth must not move, whatever the response.
+void fixed_subsystem_center(CollisionResponse response, const char* name){
+    TestBodies bodies;
+    CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f, 696340e3f);
+    CelestialBody* earth = bodies.add({1.5e11f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 5.97e24f, 6371.0e3f);
+    CelestialBody* moon = bodies.add({1.5e11f, 3e8f, 0.0f}, {-1022.0f, 0.0f, 0.0f}, 7.35e22f, 1737.4e3f);
+    CelestialBody* asteroid = bodies.add({1.5e11f - 5e7f, 0.0f, 0.0f}, {2e4f, 0.0f, 0.0f}, 1e20f, 1e5f);
+
+    OrbitalSystem system;
+    auto earth_system = std::make_shared<OrbitalSystem>();
+    system.define_center(sun);
+    system.fix_center(true);
+    earth->set_orbitalCenter(sun);
+    earth_system->define_center(earth);
+    earth_system->fix_center(true);
+    earth_system->add_orbiters(moon);
+    system.add_subsystem(earth_system);
+    system.add_orbiters(asteroid);
+    system.set_collision_response(response);
+    system.initialize();
+
+    const BodyStore& store = system.get_store();
+    std::size_t e = earth->get_id();
+    BodyStore::vec_type before = store.get_pos(e), velocity = store.get_velocity(e);
+    for (int k = 0; k < 4; k++){system.step();}
+    BodyStore::vec_type after = store.get_pos(e);
+
+    std::cout << name << " : " << system.get_collision_count() << " collision(s), Earth moved by "
+              << glm::length(after - before) << " m" << std::endl;
+    check(system.get_collision_count() > 0, "the asteroid hits the Earth");
+    check(after == before, "a fixed subsystem center keeps its position");
+    check(store.get_velocity(e) == velocity, "a fixed subsystem center keeps its velocity");
+}
+
+int main(){
+    fixed_subsystem_center(CollisionResponse::Bounce, "Bounce");
+    fixed_subsystem_center(CollisionResponse::Merge, "Merge");
+    return exit_code();
+}
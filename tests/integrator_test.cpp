@@ -0,0 +1,79 @@
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <cmath>
+#include <memory>
+
+#include "test_harness.hpp"
+
+//Regression tests of the integration schemes.
+
+bool is_finite(const BodyStore& store, std::size_t i){
+    return std::isfinite(store.x[i]) && std::isfinite(store.y[i]) && std::isfinite(store.z[i]) &&
+           std::isfinite(store.vx[i]) && std::isfinite(store.vy[i]) && std::isfinite(store.vz[i]);
+}
+
+//A body of mass 0 (accepted by the scene files) orbiting the sun next to a planet : every scheme keeps it finite and on
+//its orbit. WisdomHolman used to divide the barycenter offset of the body by its mass.
+void massless_orbiter(IntegratorScheme scheme, const char* name){
+    TestBodies bodies;
+    CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f);
+    float v = std::sqrt(G * 1.99e30f / 1.0e11f);
+    CelestialBody* orbiter = bodies.add({1.0e11f, 0.0f, 0.0f}, {0.0f, v, 0.0f}, 0.0f);
+    CelestialBody* planet = bodies.add({1.5e11f, 0.0f, 0.0f}, {0.0f, 29780.0f, 0.0f}, 5.97e24f);
+
+    OrbitalSystem system;
+    system.define_center(sun);
+    system.add_orbiters(orbiter);
+    system.add_orbiters(planet);
+    system.set_integrator(scheme);
+    system.initialize();
+    for (int k = 0; k < 100; k++){system.step();}
+
+    const BodyStore& store = system.get_store();
+    std::size_t i = orbiter->get_id();
+    double distance = std::sqrt((double)store.x[i] * store.x[i] + (double)store.y[i] * store.y[i] +
+                                (double)store.z[i] * store.z[i]);
+    bool finite = is_finite(store, i) && is_finite(store, sun->get_id()) && is_finite(store, planet->get_id());
+    std::cout << name << " : massless orbiter at " << distance << " m" << std::endl;
+    check(finite, "massless orbiter stays finite");
+    check(std::fabs(distance / 1.0e11 - 1.0) < 1e-3, "massless orbiter stays on its circular orbit");
+}
+
+//Same with a massless satellite of a subsystem whose center moves : it is a pulling satellite of no mass.
+void massless_satellite(IntegratorScheme scheme, const char* name){
+    TestBodies bodies;
+    CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f);
+    CelestialBody* earth = bodies.add({1.5e11f, 0.0f, 0.0f}, {0.0f, 29780.0f, 0.0f}, 5.97e24f);
+    CelestialBody* moon = bodies.add({1.5e11f + 3e8f, 0.0f, 0.0f}, {0.0f, 29780.0f + 1152.0f, 0.0f}, 0.0f);
+
+    OrbitalSystem system;
+    auto earth_system = std::make_shared<OrbitalSystem>();
+    system.define_center(sun);
+    system.fix_center(true);
+    earth->set_orbitalCenter(sun);
+    earth_system->define_center(earth);
+    earth_system->add_orbiters(moon);
+    system.add_subsystem(earth_system);
+    system.set_integrator(scheme);
+    system.initialize();
+    for (int k = 0; k < 100; k++){system.step();}
+
+    const BodyStore& store = system.get_store();
+    std::size_t i = moon->get_id(), e = earth->get_id();
+    double dx = (double)store.x[i] - store.x[e];
+    double dy = (double)store.y[i] - store.y[e];
+    double dz = (double)store.z[i] - store.z[e];
+    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    std::cout << name << " : massless satellite at " << distance << " m of its center" << std::endl;
+    check(is_finite(store, i) && is_finite(store, e), "massless satellite stays finite");
+    check(std::fabs(distance / 3e8 - 1.0) < 0.1, "massless satellite stays near its center");
+}
+
+int main(){
+    massless_orbiter(IntegratorScheme::Verlet, "Verlet");
+    massless_orbiter(IntegratorScheme::Yoshida4, "Yoshida4");
+    massless_orbiter(IntegratorScheme::WisdomHolman, "WisdomHolman");
+    massless_satellite(IntegratorScheme::Verlet, "Verlet");
+    massless_satellite(IntegratorScheme::WisdomHolman, "WisdomHolman");
+    return exit_code();
+}
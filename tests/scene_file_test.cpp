@@ -0,0 +1,59 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "scene_file.hpp"
+#include "test_harness.hpp"
+
+//Regression tests of the scene file parser.
+
+//A belt larger than the lines of its file : the bodies vector grows while the belt is written, its orbits must still
+//be those of its center (moving, away from the origin). The belt used to read its center after the reallocation.
+void belt_outgrowing_the_file(){
+    const char* text =
+        "material dull ../shaders/sphere/sphere.vs ../shaders/sphere/sphere.fs 0.1 8\n"
+        "body Sun - 1e11 0 0 0 5000 0 1.99e30 696340e3 0.5 1 1 0 dull\n"
+        "belt 1000 Sun 2 4 15 19 1e4 0.005 0.6 0.6 0.6 dull 42\n";
+    SceneFile scene = SceneFile::parse(text, std::strlen(text));
+    check(scene.bodies.size() == 1001, "the belt adds its bodies");
+
+    const SceneBody& sun = scene.bodies[scene.get_center()];
+    bool on_orbit = true;
+    for (std::size_t k = 1; k < scene.bodies.size(); k++){
+        const SceneBody& body = scene.bodies[k];
+        glm::vec3 r = body.position - sun.position;
+        glm::vec3 v = body.velocity - sun.velocity;
+        float distance = glm::length(r);
+        float circular = std::sqrt(G * sun.mass / distance);
+        on_orbit = on_orbit && body.parent == (int32_t)scene.get_center() && distance >= 2.0f * AU * 0.999f &&
+                   distance <= 4.0f * AU * 1.001f && std::fabs(glm::length(v) / circular - 1.0f) < 1e-3f &&
+                   std::fabs(glm::dot(r, v)) <= 1e-3f * distance * glm::length(v);
+    }
+    check(on_orbit, "every belt body is on a circular orbit around the sun");
+
+    OrbitalSystem system;
+    std::vector<std::unique_ptr<CelestialBody>> objects;
+    std::vector<std::shared_ptr<OrbitalSystem>> subsystems;
+    scene.build(system, objects, subsystems, [](const SceneBody& body){
+        return std::make_unique<CelestialBody>(std::vector<float>{body.position.x, body.position.y, body.position.z},
+                                               std::vector<float>{body.velocity.x, body.velocity.y, body.velocity.z},
+                                               body.radius, body.mass);
+    });
+    for (int k = 0; k < 10; k++){system.step();}
+    const BodyStore& store = system.get_store();
+    bool finite = true;
+    for (const std::unique_ptr<CelestialBody>& object : objects){
+        BodyStore::vec_type r = store.get_pos(object->get_id());
+        finite = finite && std::isfinite(r.x) && std::isfinite(r.y) && std::isfinite(r.z);
+    }
+    std::cout << "belt : " << scene.bodies.size() - 1 << " bodies around the sun, " << system.get_collision_count()
+              << " collision(s) in 10 steps" << std::endl;
+    check(finite, "the belt steps with finite positions");
+}
+
+int main(){
+    belt_outgrowing_the_file();
+    return exit_code();
+}
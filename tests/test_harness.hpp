@@ -0,0 +1,36 @@
+#ifndef TEST_HARNESS_HPP
+#define TEST_HARNESS_HPP
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "celestial_body.hpp"
+
+//Checks of the regression tests, run by ctest : main returns exit_code(), 0 when every check passes.
+
+inline int failures = 0;
+
+inline void check(bool condition, const char* what){
+    if (!condition){
+        std::cout << "FAILED : " << what << std::endl;
+        failures++;
+    }
+}
+
+inline int exit_code(){
+    if (failures > 0){std::cout << failures << " check(s) failed" << std::endl;}
+    return failures > 0 ? 1 : 0;
+}
+
+//Bodies of a test, alive as long as the systems built on them.
+struct TestBodies {
+    std::vector<std::unique_ptr<CelestialBody>> bodies;
+
+    CelestialBody* add(const std::vector<float>& r0, const std::vector<float>& v0, float mass, float radius = 1e6f){
+        bodies.push_back(std::make_unique<CelestialBody>(r0, v0, radius, mass));
+        return bodies.back().get();
+    }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include <iostream>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "celestial_body.hpp"
+#include "test_harness.hpp"
+
+//Regression tests of the test particles.
+
+//Particles spawned on a planet (a spacecraft at launch) among others : the pull of a source at zero distance is zero,
+//the particles stay finite and every instruction set gives the same positions. They used to get 1 / 0 and NaN.
+void particle_on_a_source(){
+    std::vector<TestParticles> results;
+    for (int level = 0; level <= (int)detect_simd_level(); level++){
+        TestBodies bodies;
+        CelestialBody* sun = bodies.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.99e30f);
+        CelestialBody* jupiter = bodies.add({7.79e11f, 0.0f, 0.0f}, {0.0f, 13058.0f, 0.0f}, 1.90e27f);
+        OrbitalSystem system;
+        system.define_center(sun);
+        system.fix_center(true);
+        system.add_orbiters(jupiter);
+        system.set_simd_level((SimdLevel)level);
+        system.initialize();
+        //19 particles, two of them on the sources : every register width gets full lanes and a scalar remainder.
+        for (int k = 0; k < 17; k++){
+            float r = (2.0f + 0.1f * k) * AU;
+            system.add_test_particle({r, 0.0f, 0.0f}, {0.0f, std::sqrt(G * 1.99e30f / r), 0.0f});
+        }
+        system.add_test_particle({7.79e11f, 0.0f, 0.0f}, {0.0f, 13058.0f + 2000.0f, 0.0f});
+        system.add_test_particle({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f});
+        for (int k = 0; k < 10; k++){system.step();}
+        results.push_back(system.get_test_particles());
+
+        bool finite = true;
+        for (std::size_t p = 0; p < results.back().size(); p++){
+            BodyStore::vec_type r = results.back().get_pos(p);
+            finite = finite && std::isfinite(r.x) && std::isfinite(r.y) && std::isfinite(r.z);
+        }
+        std::cout << simd_level_name((SimdLevel)level) << " : " << results.back().size() << " particles, "
+                  << (finite ? "finite" : "not finite") << std::endl;
+        check(finite, "particles on a source stay finite");
+    }
+    bool same = true;
+    for (const TestParticles& result : results){
+        for (std::size_t p = 0; p < result.size(); p++){
+            same = same && result.get_pos(p) == results[0].get_pos(p);
+        }
+    }
+    check(same, "every instruction set gives the scalar positions");
+}
+
+int main(){
+    particle_on_a_source();
+    return exit_code();
+}